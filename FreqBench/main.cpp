@@ -0,0 +1,457 @@
+//////////////////////////////////////////////////////////////////////
+// FreqBench
+// Headless benchmarks of the FreqWatch engine. They need no window,no
+// sound card and no database,only the portable sources,so they run on
+// Linux as well as Windows. On Linux build from the sources
+// FreqBench.vcxproj lists:
+//   g++ -O2 -std=c++11 -pthread main.cpp <those .cpp files> -o freqbench
+//
+// Usage: freqbench command args..; without a command the list is printed.
+//////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../FreqWatch/AnchorMemIndex.h"
+#include "../FreqWatch/CaptureRing.h"
+#include "../FreqWatch/FreqAnalysis.h"
+#include "../FreqWatch/IngestPipeline.h"
+#include "../FreqWatch/LiveRecognizer.h"
+#include "../FreqWatch/QueryBench.h"
+#include "../FreqWatch/WavFileSource.h"
+#include "../WavSink/StftEngine.h"
+
+//transform length of the FreqWatch window (SampleCount),and its capture
+//buffers of a quarter of it
+static const size_t FrameSize=8192;
+static const size_t CaptureBufferSamples=FrameSize/4;
+//window score at which CMainFrame reports a live match (liveMinScore)
+static const int LiveMinScore=8;
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+//the value a share p of values is at or below,0 for none
+static double Percentile(std::vector<double> values,double p)
+{
+	if(values.empty())
+		return 0;
+	std::sort(values.begin(),values.end());
+	size_t at=(size_t)(p*(values.size()-1)+0.5);
+	return values[at];
+}
+
+//capture wav [speed] [workMs]
+//the file through CWavFileCapture into a CCaptureWorker that feeds a
+//CStftEngine,wired as OnFileRecord wires the device,with 2 to 16
+//buffers of slack; workMs of extra work per chunk stands in for a
+//consumer that falls behind
+static int Capture(int argc,char *argv[])
+{
+	WavData wav;
+	if(!ReadWavFile(argv[0],wav) || !wav.sampleRate)
+	{
+		printf("can not read %s\n",argv[0]);
+		return 1;
+	}
+	double speed=argc>1?atof(argv[1]):1;
+	double workMs=argc>2?atof(argv[2]):0;
+	printf("%s: %.1f s at %u Hz,speed %.1f,%.1f ms extra work per chunk\n",argv[0],
+		(double)wav.samples.size()/wav.sampleRate,wav.sampleRate,speed,workMs);
+	for(size_t buffers=2;buffers<=16;buffers*=2)
+	{
+		SpectrumLines lines;
+		CStftEngine stft(FrameSize,FrameSize,&lines);
+		size_t lineCount=0;
+		CCaptureWorker worker(buffers*CaptureBufferSamples*2,CaptureBufferSamples,[&](const short *pcm,size_t count)
+		{
+			stft.Push(pcm,count);
+			lineCount+=lines.size();
+			lines.clear();
+			if(workMs>0)
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)(workMs*1000)));
+		});
+		CWavFileCapture capture(wav,CaptureBufferSamples,speed);
+		auto start=std::chrono::steady_clock::now();
+		worker.Start();
+		capture.Start([&worker](const short *pcm,size_t count){ worker.Submit(pcm,count); });
+		capture.Join();
+		worker.Stop();
+		double seconds=SecondsSince(start);
+		CaptureStats stats=worker.Stats();
+		printf("%2u buffers: %llu blocks,%llu overruns,%llu samples dropped,max fill %u,%u lines in %.2f s\n",
+			(unsigned int)buffers,(unsigned long long)stats.blocks,(unsigned long long)stats.overruns,
+			(unsigned long long)stats.droppedSamples,(unsigned int)stats.maxFill,(unsigned int)lineCount,seconds);
+	}
+	return 0;
+}
+
+//live speed from wav..
+//the files analysed whole into a CAnchorMemIndex,song ids in file order,
+//then each replayed from `from` seconds in through
+//ReplayLiveRecognition: the capture ring and worker,the streaming peak
+//picker and a CLiveRecognizer. Reports the audio and the wall time the
+//first match took
+static int Live(int argc,char *argv[])
+{
+	double speed=atof(argv[0]);
+	double from=atof(argv[1]);
+	AnalysisParams params={FrameSize,FrameSize};
+	std::vector<WavData> wavs(argc-2);
+	CAnchorMemIndex index;
+	for(int i=2;i<argc;i++)
+	{
+		WavData &wav=wavs[i-2];
+		if(!ReadWavFile(argv[i],wav) || wav.samples.empty() || !wav.sampleRate)
+		{
+			printf("can not read %s\n",argv[i]);
+			return 1;
+		}
+		std::vector<FreqInfo> freqinfos;
+		AnalyzeSamples(&wav.samples[0],wav.samples.size(),params,freqinfos);
+		std::vector<SongAnchor> anchors;
+		BuildSongAnchors(freqinfos,anchors);
+		index.AddSong(i-1,anchors);
+	}
+	index.Finish();
+	printf("%u songs,%u anchors,%u checks; replayed from %.1f s at speed %.1f\n",(unsigned int)wavs.size(),
+		(unsigned int)index.AnchorCount(),(unsigned int)index.CheckCount(),from,speed);
+
+	std::vector<double> audio;
+	std::vector<double> wall;
+	size_t right=0;
+	size_t wrong=0;
+	uint64_t overruns=0;
+	for(size_t s=0;s<wavs.size();s++)
+	{
+		WavData clip=wavs[s];
+		size_t skip=std::min(clip.samples.size(),(size_t)(from*clip.sampleRate));
+		clip.samples.erase(clip.samples.begin(),clip.samples.begin()+skip);
+		ReplayResult result;
+		ReplayLiveRecognition(clip,index,params,LiveMinScore,speed,result);
+		overruns+=result.capture.overruns;
+		if(!result.matched)
+		{
+			printf("%s: no match after %u peaks\n",argv[s+2],(unsigned int)result.peaks);
+			continue;
+		}
+		bool own=result.match.song_id==(int)s+1;
+		printf("%s: song %d offset %d score %d after %.2f s of audio,%.1f ms\n",argv[s+2],result.match.song_id,
+			result.match.offset,result.match.score,result.audioSeconds,result.wallSeconds*1000);
+		if(!own)
+		{
+			wrong++;
+			continue;
+		}
+		right++;
+		audio.push_back(result.audioSeconds);
+		wall.push_back(result.wallSeconds*1000);
+	}
+	printf("%u right,%u wrong,%u unmatched,%llu overruns\n",(unsigned int)right,(unsigned int)wrong,
+		(unsigned int)(wavs.size()-right-wrong),(unsigned long long)overruns);
+	printf("time to first match: audio p50 %.2f s p90 %.2f s,wall p50 %.1f ms p90 %.1f ms\n",Percentile(audio,0.5),
+		Percentile(audio,0.9),Percentile(wall,0.5),Percentile(wall,0.9));
+	return 0;
+}
+
+//the synthetic library the query timings are quoted on: 300 frames of 2 peaks
+//a song,queried with 60-frame clips
+static SyntheticLibrary Library(int songs)
+{
+	SyntheticLibrary library={songs,300,2,60};
+	return library;
+}
+
+//anchors songs [clips]
+//a synthetic library built into a CAnchorMemIndex,then each clip matched
+//and scored as OnFileOpen does; reports the latency and the clips whose
+//best song is the one they were cut from
+static int Anchors(int argc,char *argv[])
+{
+	SyntheticLibrary library=Library(atoi(argv[0]));
+	size_t count=argc>1?(size_t)atoi(argv[1]):200;
+	auto start=std::chrono::steady_clock::now();
+	CAnchorMemIndex index;
+	BuildSyntheticAnchorIndex(library,index);
+	printf("%d songs: %u anchors,%u checks,%u MB,built in %.1f s\n",library.songs,(unsigned int)index.AnchorCount(),
+		(unsigned int)index.CheckCount(),(unsigned int)(index.MemorySize()>>20),SecondsSince(start));
+	std::vector<std::vector<FreqInfo> > clips;
+	std::vector<int> owners;
+	MakeSyntheticClips(library,count,1,clips,owners);
+	LatencyStats stats;
+	size_t right=BenchClipQueries(clips,owners,[&index](const std::vector<FreqInfo> &clip,std::vector<MatchVote> &votes)
+	{
+		MatchAnchors(clip,index,votes);
+	},stats);
+	printf("memory index: mean %.1f ms,p50 %.1f ms,p99 %.1f ms,%u of %u clips right\n",stats.meanMs,stats.p50Ms,
+		stats.p99Ms,(unsigned int)right,(unsigned int)clips.size());
+	return 0;
+}
+
+//batch songs [clips]
+//the synthetic library's clips as single queries and as one batch,by
+//anchors against a CAnchorMemIndex and by hashes against a CHashTable
+static int Batch(int argc,char *argv[])
+{
+	SyntheticLibrary library=Library(atoi(argv[0]));
+	size_t count=argc>1?(size_t)atoi(argv[1]):300;
+	CAnchorMemIndex index;
+	BuildSyntheticAnchorIndex(library,index);
+	CHashTable hashes;
+	std::vector<FreqInfo> peaks;
+	std::vector<FingerprintHash> songHashes;
+	for(int s=1;s<=library.songs;s++)
+	{
+		MakeSyntheticSong((unsigned int)s,library.frames,library.peaksPerFrame,peaks);
+		GenerateHashes(peaks,HashMaxFanout,songHashes);
+		hashes.AddSong(s,songHashes);
+	}
+	std::vector<std::vector<FreqInfo> > clips;
+	std::vector<int> owners;
+	MakeSyntheticClips(library,count,1,clips,owners);
+	std::vector<std::vector<FingerprintHash> > hashClips(clips.size());
+	for(size_t c=0;c<clips.size();c++)
+		GenerateHashes(clips[c],0,hashClips[c]);
+
+	BatchReport anchors;
+	BenchBatchQueries(clips,index,anchors);
+	BatchReport keys;
+	BenchBatchHashQueries(hashClips,hashes,keys);
+	printf("%d songs,%u clips\n",library.songs,(unsigned int)clips.size());
+	printf("anchors: %.1f qps single,%.1f qps batched,%u lookups (%u one by one),%u scored the same\n",
+		anchors.singleQps,anchors.batchQps,(unsigned int)anchors.stats.lookups,(unsigned int)anchors.stats.singleLookups,
+		(unsigned int)anchors.sameScores);
+	printf("hashes:  %.1f qps single,%.1f qps batched,%u lookups (%u one by one),%u scored the same\n",
+		keys.singleQps,keys.batchQps,(unsigned int)keys.stats.lookups,(unsigned int)keys.stats.singleLookups,
+		(unsigned int)keys.sameScores);
+	return 0;
+}
+
+//the test of one anchor's check list timed over anchors,by the scan of every
+//point the sorted lists replaced and by CountCheckMatches
+static void PrintCheckMatches(const char *name,const std::vector<SongAnchor> &anchors)
+{
+	size_t checks=0;
+	for(auto a=anchors.begin();a!=anchors.end();++a)
+		checks+=a->checks.size();
+	double linear=BenchCheckMatches(anchors,20,CountCheckMatchesLinear);
+	double sorted=BenchCheckMatches(anchors,20);
+	printf("%s: %u anchors,%.1f checks avg: linear %.1f ns,sorted %.1f ns per call\n",name,(unsigned int)anchors.size(),
+		anchors.empty()?0:(double)checks/anchors.size(),linear,sorted);
+}
+
+//checks [wav..]
+//check list tests on 50 synthetic songs at 2,4 and 8 peaks a frame,then on
+//the anchors of the files given
+static int Checks(int argc,char *argv[])
+{
+	for(int peaksPerFrame=2;peaksPerFrame<=8;peaksPerFrame*=2)
+	{
+		std::vector<SongAnchor> all;
+		std::vector<FreqInfo> peaks;
+		std::vector<SongAnchor> anchors;
+		for(int s=1;s<=50;s++)
+		{
+			MakeSyntheticSong((unsigned int)s,300,peaksPerFrame,peaks);
+			BuildSongAnchors(peaks,anchors);
+			all.insert(all.end(),anchors.begin(),anchors.end());
+		}
+		char name[64];
+		sprintf(name,"synthetic %d peaks/frame",peaksPerFrame);
+		PrintCheckMatches(name,all);
+	}
+	if(!argc)
+		return 0;
+	AnalysisParams params={FrameSize,FrameSize};
+	std::vector<SongAnchor> all;
+	for(int i=0;i<argc;i++)
+	{
+		WavData wav;
+		if(!ReadWavFile(argv[i],wav) || wav.samples.empty() || !wav.sampleRate)
+		{
+			printf("can not read %s\n",argv[i]);
+			return 1;
+		}
+		std::vector<FreqInfo> freqinfos;
+		AnalyzeSamples(&wav.samples[0],wav.samples.size(),params,freqinfos);
+		std::vector<SongAnchor> anchors;
+		BuildSongAnchors(freqinfos,anchors);
+		all.insert(all.end(),anchors.begin(),anchors.end());
+	}
+	PrintCheckMatches("analysed files",all);
+	return 0;
+}
+
+//ingest folder [threads..]
+//the folder's wav files decoded and analysed one at a time,then through a
+//CIngestPipeline on each thread count,1,2,4.. up to every core by default
+static int Ingest(int argc,char *argv[])
+{
+	std::vector<std::string> files;
+	if(!ListWavFiles(argv[0],files))
+	{
+		printf("can not list %s\n",argv[0]);
+		return 1;
+	}
+	std::vector<size_t> threads;
+	for(int i=1;i<argc;i++)
+		threads.push_back((size_t)atoi(argv[i]));
+	if(threads.empty())
+	{
+		size_t cores=std::thread::hardware_concurrency();
+		for(size_t t=1;t<cores;t*=2)
+			threads.push_back(t);
+		threads.push_back(cores?cores:1);
+	}
+	AnalysisParams params={FrameSize,FrameSize};
+	std::vector<IngestBenchRun> runs;
+	BenchIngestPipeline(files,threads,params,runs);
+	printf("%u wav files,%u cores\n",(unsigned int)files.size(),std::thread::hardware_concurrency());
+	for(auto i=runs.begin();i!=runs.end();++i)
+	{
+		if(i->threads)
+			printf("%2u threads: ",(unsigned int)i->threads);
+		else
+			printf("one at a time: ");
+		printf("%u files in %.1f s,%.1f files/min,%u steals,%u batches,%llu postings\n",(unsigned int)i->files,
+			i->seconds,i->filesPerMinute,(unsigned int)i->steals,(unsigned int)i->batches,(unsigned long long)i->postings);
+	}
+	return 0;
+}
+
+//postings songs [frames] [clips]
+//the synthetic library's hashes as a raw and as a packed hash segment:
+//the size of the postings,the rate of walking every list and the time
+//of a hash query on each
+static int Postings(int argc,char *argv[])
+{
+	SyntheticLibrary library=Library(atoi(argv[0]));
+	if(argc>1)
+		library.frames=atoi(argv[1]);
+	size_t count=argc>2?(size_t)atoi(argv[2]):200;
+	PostingLayoutReport report;
+	BenchPostingLayouts(library,count,report);
+	printf("%d songs of %d frames: %u postings,%u keys\n",library.songs,library.frames,(unsigned int)report.postings,
+		(unsigned int)report.keys);
+	printf("postings %u MB raw,%u MB packed (%.2fx)\n",(unsigned int)(report.rawBytes>>20),
+		(unsigned int)(report.packedBytes>>20),report.packedBytes?(double)report.rawBytes/report.packedBytes:0);
+	printf("walk %.0fM postings/s raw,%.0fM/s packed\n",report.rawWalkRate,report.packedWalkRate);
+	printf("query raw: mean %.2f ms,p99 %.2f ms; packed: mean %.2f ms,p99 %.2f ms; %u of %u scored the same\n",
+		report.raw.meanMs,report.raw.p99Ms,report.packed.meanMs,report.packed.p99Ms,(unsigned int)report.sameScores,
+		(unsigned int)report.clips);
+	return 0;
+}
+
+//threads songs [clips]
+//the synthetic library's clips through a CQueryExecutor of 1,2,4,8 and 16
+//threads,each checked against MatchAnchors on the calling thread
+static int Threads(int argc,char *argv[])
+{
+	SyntheticLibrary library=Library(atoi(argv[0]));
+	size_t count=argc>1?(size_t)atoi(argv[1]):100;
+	CAnchorMemIndex index;
+	BuildSyntheticAnchorIndex(library,index);
+	std::vector<std::vector<FreqInfo> > clips;
+	std::vector<int> owners;
+	MakeSyntheticClips(library,count,1,clips,owners);
+	std::vector<ThreadSweepRun> runs;
+	for(size_t threads=1;threads<=16;threads*=2)
+	{
+		ThreadSweepRun run;
+		run.threads=threads;
+		runs.push_back(run);
+	}
+	BenchQueryThreads(clips,index,runs);
+	printf("%d songs,%u clips,%u cores\n",library.songs,(unsigned int)clips.size(),std::thread::hardware_concurrency());
+	for(auto r=runs.begin();r!=runs.end();++r)
+	{
+		printf("%2u threads: mean %.1f ms,p50 %.1f ms,p99 %.1f ms,%u of %u scored as serial\n",(unsigned int)r->threads,
+			r->latency.meanMs,r->latency.p50Ms,r->latency.p99Ms,(unsigned int)r->sameScores,(unsigned int)clips.size());
+	}
+	return 0;
+}
+
+//leader [count] [songs]
+//CVoteLeader against brute force: first votes whose best window centre
+//has no vote of its own,then count random votes of songs songs over a
+//few dozen offsets
+static int Leader(int argc,char *argv[])
+{
+	size_t count=argc>0?(size_t)atoi(argv[0]):2000;
+	int songs=argc>1?atoi(argv[1]):20;
+	//song 1 at 0 and 2*VoteWindow sums 2 only around VoteWindow,where it has no vote
+	MatchVote gap[]={{1,0},{2,0},{1,2*VoteWindow}};
+	bool gapRight=CheckVoteLeader(std::vector<MatchVote>(gap,gap+sizeof(gap)/sizeof(gap[0])));
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> song(1,songs);
+	std::uniform_int_distribution<int> offset(0,40);
+	std::vector<MatchVote> votes(count);
+	for(auto v=votes.begin();v!=votes.end();++v)
+	{
+		v->song_id=song(rng);
+		v->offset=offset(rng);
+	}
+	bool randomRight=CheckVoteLeader(votes);
+	printf("window between votes: %s\n",gapRight?"right":"WRONG");
+	printf("%u random votes,%d songs: %s\n",(unsigned int)count,songs,randomRight?"right":"WRONG");
+	return gapRight && randomRight?0:1;
+}
+
+//votes count songs [rounds]
+//random votes with one aligned song scored by the std::map ScoreVotes that
+//CVoteScorer replaced,and by the scorer's sort and hash methods
+static int Votes(int argc,char *argv[])
+{
+	size_t count=(size_t)atoi(argv[0]);
+	int songs=atoi(argv[1]);
+	int rounds=argc>2?atoi(argv[2]):20;
+	std::vector<MatchVote> votes;
+	MakeRandomVotes(1,count,songs,votes);
+	VoteScoringReport report;
+	BenchVoteScoring(votes,rounds,report);
+	printf("%u votes,%d songs: map %.2f ms,sort %.2f ms,hash %.2f ms per call,%s\n",(unsigned int)count,songs,
+		report.mapMs,report.sortMs,report.hashMs,report.same?"same scores":"SCORES DIFFER");
+	return report.same?0:1;
+}
+
+struct Command
+{
+	const char *name;
+	const char *args;
+	//arguments that must follow the command
+	int minArgs;
+	int (*run)(int argc,char *argv[]);
+};
+
+static const Command Commands[]=
+{
+	{"anchors","songs [clips]",1,Anchors},
+	{"batch","songs [clips]",1,Batch},
+	{"capture","wav [speed] [workMs]",1,Capture},
+	{"checks","[wav..]",0,Checks},
+	{"ingest","folder [threads..]",1,Ingest},
+	{"leader","[count] [songs]",0,Leader},
+	{"live","speed from wav..",3,Live},
+	{"postings","songs [frames] [clips]",1,Postings},
+	{"threads","songs [clips]",1,Threads},
+	{"votes","count songs [rounds]",2,Votes},
+};
+
+int main(int argc,char *argv[])
+{
+	for(size_t i=0;i<sizeof(Commands)/sizeof(Commands[0]);i++)
+	{
+		if(argc>=2+Commands[i].minArgs && !strcmp(argv[1],Commands[i].name))
+			return Commands[i].run(argc-2,argv+2);
+	}
+	printf("Usage: freqbench command args..\n");
+	for(size_t i=0;i<sizeof(Commands)/sizeof(Commands[0]);i++)
+		printf("  %s %s\n",Commands[i].name,Commands[i].args);
+	return -1;
+}
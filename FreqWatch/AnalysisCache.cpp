@@ -0,0 +1,308 @@
+#include "StdAfx.h"
+#include "AnalysisCache.h"
+#include <algorithm>
+#include <string.h>
+#include "MappedFile.h"
+
+static const char AnalysisCacheTag[4]={'F','W','A','C'};
+static const uint32_t AnalysisCacheVersion=1;
+
+static uint64_t FileTimeNow()
+{
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	return (uint64_t)now.dwHighDateTime<<32|now.dwLowDateTime;
+}
+
+static void SetWriteTime(LPCWSTR path,uint64_t when)
+{
+	HANDLE file=CreateFileW(path,FILE_WRITE_ATTRIBUTES,FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,NULL,
+		OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if(file==INVALID_HANDLE_VALUE)
+		return;
+	FILETIME time;
+	time.dwLowDateTime=(DWORD)when;
+	time.dwHighDateTime=(DWORD)(when>>32);
+	SetFileTime(file,NULL,NULL,&time);
+	CloseHandle(file);
+}
+
+//false if the entry is not one of key or is cut short; spectrum tells
+//whether it holds the lines,which are only copied out when asked for
+static bool ReadEntry(const uint8_t *data,size_t size,const AnalysisKey &key,bool &spectrum,SpectrumLines *dataline,
+	std::vector<FreqInfo> &freqinfos,std::vector<FingerprintHash> *hashes)
+{
+	AnalysisCacheHeader header;
+	if(size<sizeof(header))
+		return false;
+	memcpy(&header,data,sizeof(header));
+	if(memcmp(header.magic,AnalysisCacheTag,sizeof(AnalysisCacheTag)) || header.version!=AnalysisCacheVersion ||
+		header.contentHash!=key.contentHash || header.frameSize!=key.params.frameSize ||
+		header.gridSampleCount!=key.params.gridSampleCount || header.decoder!=key.decoder)
+		return false;
+	uint64_t lineBytes=(uint64_t)header.lines*header.bins*sizeof(float);
+	uint64_t peakBytes=(uint64_t)header.peaks*sizeof(FreqInfo);
+	uint64_t hashBytes=(uint64_t)header.hashes*sizeof(FingerprintHash);
+	if(sizeof(header)+lineBytes+peakBytes+hashBytes!=size)
+		return false;
+	spectrum=header.bins!=0;
+	const uint8_t *pos=data+sizeof(header);
+	if(dataline && spectrum)
+	{
+		dataline->assign(header.lines,std::vector<double>(header.bins));
+		const float *values=(const float*)pos;
+		for(uint32_t l=0;l<header.lines;l++)
+		{
+			std::vector<double> &line=(*dataline)[l];
+			for(uint32_t b=0;b<header.bins;b++)
+				line[b]=values[(size_t)l*header.bins+b];
+		}
+	}
+	pos+=lineBytes;
+	freqinfos.resize(header.peaks);
+	if(header.peaks)
+		memcpy(&freqinfos[0],pos,(size_t)peakBytes);
+	pos+=peakBytes;
+	if(hashes)
+	{
+		hashes->resize(header.hashes);
+		if(header.hashes)
+			memcpy(&(*hashes)[0],pos,(size_t)hashBytes);
+	}
+	return true;
+}
+
+CAnalysisCache::CAnalysisCache():m_maxBytes(0),m_bytes(0)
+{
+	memset(&m_stats,0,sizeof(m_stats));
+}
+
+bool CAnalysisCache::Open(LPCWSTR dir,uint64_t maxBytes)
+{
+	Close();
+	CreateDirectoryW(dir,NULL);
+	std::vector<CAtlString> doomed;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_dir=dir;
+		m_maxBytes=maxBytes;
+		WIN32_FIND_DATAW found;
+		HANDLE find=FindFirstFileW(m_dir+L"\\*.fwac",&found);
+		if(find!=INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				Entry &entry=m_entries[CAtlString(found.cFileName)];
+				entry.bytes=(uint64_t)found.nFileSizeHigh<<32|found.nFileSizeLow;
+				entry.used=(uint64_t)found.ftLastWriteTime.dwHighDateTime<<32|found.ftLastWriteTime.dwLowDateTime;
+				entry.writing=false;
+				m_bytes+=entry.bytes;
+			}
+			while(FindNextFileW(find,&found));
+			FindClose(find);
+		}
+		//a store cut off by a crash leaves its temporary file
+		find=FindFirstFileW(m_dir+L"\\*.tmp",&found);
+		if(find!=INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				doomed.push_back(CAtlString(found.cFileName));
+			}
+			while(FindNextFileW(find,&found));
+			FindClose(find);
+		}
+		if(m_bytes>m_maxBytes)
+			Evict(doomed);
+	}
+	for(auto i=doomed.begin();i!=doomed.end();++i)
+		DeleteFileW(m_dir+L"\\"+*i);
+	return true;
+}
+
+void CAnalysisCache::Close()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_dir.Empty();
+	m_entries.clear();
+	m_bytes=0;
+	memset(&m_stats,0,sizeof(m_stats));
+}
+
+CAtlString CAnalysisCache::EntryName(const AnalysisKey &key) const
+{
+	CAtlString name;
+	name.Format(L"%08x%08x_%u_%u_%u.fwac",(unsigned int)(key.contentHash>>32),(unsigned int)key.contentHash,
+		(unsigned int)key.params.frameSize,(unsigned int)key.params.gridSampleCount,key.decoder);
+	return name;
+}
+
+bool CAnalysisCache::Lookup(const AnalysisKey &key,SpectrumLines *dataline,std::vector<FreqInfo> &freqinfos,
+	std::vector<FingerprintHash> *hashes)
+{
+	CAtlString name=EntryName(key);
+	CAtlString path;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if(!IsOpen())
+			return false;
+		auto found=m_entries.find(name);
+		if(found==m_entries.end() || found->second.writing)
+		{
+			m_stats.misses++;
+			return false;
+		}
+		path=m_dir+L"\\"+name;
+	}
+	CMappedFile file;
+	bool spectrum=false;
+	bool valid=file.Open(path) &&
+		ReadEntry((const uint8_t*)file.Data(),file.Size(),key,spectrum,dataline,freqinfos,hashes);
+	file.Close();
+	uint64_t now=FileTimeNow();
+	bool hit=valid && (!dataline || spectrum);
+	bool damaged=false;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto found=m_entries.find(name);
+		if(!hit)
+		{
+			m_stats.misses++;
+			//gone or damaged,unless a store is replacing it meanwhile
+			if(!valid && found!=m_entries.end() && !found->second.writing)
+			{
+				m_bytes-=found->second.bytes;
+				m_entries.erase(found);
+				damaged=true;
+			}
+		}
+		else
+		{
+			m_stats.hits++;
+			if(found!=m_entries.end())
+				found->second.used=now;
+		}
+	}
+	//deleted once the lock is released,as evicted files are
+	if(damaged)
+		DeleteFileW(path);
+	if(!hit)
+		return false;
+	SetWriteTime(path,now);
+	return true;
+}
+
+bool CAnalysisCache::Store(const AnalysisKey &key,const SpectrumLines *dataline,const std::vector<FreqInfo> &freqinfos)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if(!IsOpen())
+			return false;
+	}
+	std::vector<FingerprintHash> hashes;
+	GenerateHashes(freqinfos,HashMaxFanout,hashes);
+	AnalysisCacheHeader header;
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,AnalysisCacheTag,sizeof(AnalysisCacheTag));
+	header.version=AnalysisCacheVersion;
+	header.contentHash=key.contentHash;
+	header.frameSize=(uint32_t)key.params.frameSize;
+	header.gridSampleCount=(uint32_t)key.params.gridSampleCount;
+	header.decoder=key.decoder;
+	if(dataline && !dataline->empty())
+	{
+		header.bins=(uint32_t)(*dataline)[0].size();
+		header.lines=(uint32_t)dataline->size();
+		//lines of uneven length are not stored
+		for(auto i=dataline->begin();i!=dataline->end();++i)
+		{
+			if(i->size()!=header.bins)
+				header.bins=header.lines=0;
+		}
+	}
+	header.peaks=(uint32_t)freqinfos.size();
+	header.hashes=(uint32_t)hashes.size();
+	std::vector<uint8_t> image(sizeof(header)+(size_t)header.lines*header.bins*sizeof(float)+
+		freqinfos.size()*sizeof(FreqInfo)+hashes.size()*sizeof(FingerprintHash));
+	memcpy(&image[0],&header,sizeof(header));
+	uint8_t *pos=&image[sizeof(header)];
+	for(uint32_t l=0;l<header.lines && header.bins;l++)
+	{
+		const std::vector<double> &line=(*dataline)[l];
+		float *values=(float*)pos;
+		for(uint32_t b=0;b<header.bins;b++)
+			values[b]=(float)line[b];
+		pos+=header.bins*sizeof(float);
+	}
+	if(!freqinfos.empty())
+		memcpy(pos,&freqinfos[0],freqinfos.size()*sizeof(FreqInfo));
+	pos+=freqinfos.size()*sizeof(FreqInfo);
+	if(!hashes.empty())
+		memcpy(pos,&hashes[0],hashes.size()*sizeof(FingerprintHash));
+
+	CAtlString name=EntryName(key);
+	CAtlString path;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto found=m_entries.find(name);
+		//one that holds as much or is being written is left alone
+		if(found!=m_entries.end() && (found->second.writing || found->second.bytes>=image.size()))
+			return true;
+		Entry &entry=m_entries[name];
+		if(found==m_entries.end())
+			entry.bytes=0;
+		entry.writing=true;
+		path=m_dir+L"\\"+name;
+	}
+	bool written=WriteWholeFile(path,&image[0],image.size());
+	std::vector<CAtlString> doomed;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		Entry &entry=m_entries[name];
+		entry.writing=false;
+		if(written)
+		{
+			m_bytes+=image.size()-entry.bytes;
+			entry.bytes=image.size();
+			entry.used=FileTimeNow();
+			m_stats.stores++;
+			if(m_bytes>m_maxBytes)
+				Evict(doomed);
+		}
+		else if(!entry.bytes)
+			m_entries.erase(name);
+	}
+	for(auto i=doomed.begin();i!=doomed.end();++i)
+		DeleteFileW(m_dir+L"\\"+*i);
+	return written;
+}
+
+void CAnalysisCache::Evict(std::vector<CAtlString> &doomed)
+{
+	std::vector<std::pair<uint64_t,CAtlString> > order;
+	for(auto i=m_entries.begin();i!=m_entries.end();++i)
+	{
+		if(!i->second.writing)
+			order.push_back(std::make_pair(i->second.used,i->first));
+	}
+	std::sort(order.begin(),order.end());
+	uint64_t target=m_maxBytes/10*9;
+	for(auto i=order.begin();i!=order.end() && m_bytes>target;++i)
+	{
+		auto found=m_entries.find(i->second);
+		m_bytes-=found->second.bytes;
+		m_entries.erase(found);
+		doomed.push_back(i->second);
+		m_stats.evictions++;
+	}
+}
+
+AnalysisCacheStats CAnalysisCache::Stats()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	AnalysisCacheStats stats=m_stats;
+	stats.entries=m_entries.size();
+	stats.bytes=m_bytes;
+	stats.maxBytes=m_maxBytes;
+	return stats;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "FreqAnalysis.h"
+#include "HashIndex.h"
+
+//decoders whose analyses are cached apart,as they may resample differently
+const uint32_t DecoderMediaFoundation=1;
+const uint32_t DecoderWavReader=2;
+
+//what an analysis is cached under: the file's bytes and how they were analysed
+struct AnalysisKey
+{
+	uint64_t contentHash;
+	AnalysisParams params;
+	uint32_t decoder;
+};
+
+struct AnalysisCacheStats
+{
+	size_t entries;
+	uint64_t bytes;
+	uint64_t maxBytes;
+	size_t hits;
+	size_t misses;
+	size_t stores;
+	size_t evictions;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CAnalysisCache
+// Analyses of audio files kept in a directory,a file per AnalysisKey:
+// the spectrum lines as floats (left out when not given),the peaks and
+// their hashes. A lookup maps the entry and copies it out,so a warm
+// reopen does no decoding and no transform. Once the entries pass
+// maxBytes the least recently used are deleted down to 90% of it; a
+// hit sets the entry's write time,so the order holds across runs.
+// Lookup and Store may be called from several threads.
+// Entry: AnalysisCacheHeader,float lines[lines*bins],FreqInfo
+// peaks[peaks],FingerprintHash hashes[hashes].
+//////////////////////////////////////////////////////////////////////
+struct AnalysisCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t contentHash;
+	uint32_t frameSize;
+	uint32_t gridSampleCount;
+	uint32_t decoder;
+	//0 when the spectrum was not stored
+	uint32_t bins;
+	uint32_t lines;
+	uint32_t peaks;
+	uint32_t hashes;
+	uint32_t reserved;
+};
+
+class CAnalysisCache
+{
+public:
+	CAnalysisCache();
+
+	//dir is created if missing; the entries already there count towards maxBytes
+	bool Open(LPCWSTR dir,uint64_t maxBytes);
+	void Close();
+	bool IsOpen() const { return !m_dir.IsEmpty(); }
+
+	//false on a miss; with dataline,an entry stored without the spectrum misses
+	bool Lookup(const AnalysisKey &key,SpectrumLines *dataline,std::vector<FreqInfo> &freqinfos,
+		std::vector<FingerprintHash> *hashes=nullptr);
+	//hashes are generated here; without dataline an entry that has one is kept
+	bool Store(const AnalysisKey &key,const SpectrumLines *dataline,const std::vector<FreqInfo> &freqinfos);
+	AnalysisCacheStats Stats();
+private:
+	CAnalysisCache(const CAnalysisCache&);
+	CAnalysisCache &operator=(const CAnalysisCache&);
+
+	struct Entry
+	{
+		uint64_t bytes;
+		//FILETIME ticks of the last store or hit
+		uint64_t used;
+		//being written by a Store
+		bool writing;
+	};
+	CAtlString EntryName(const AnalysisKey &key) const;
+	//deletes least recently used entries,called with m_lock held; the
+	//files go after it is released
+	void Evict(std::vector<CAtlString> &doomed);
+
+	CAtlString m_dir;
+	uint64_t m_maxBytes;
+	std::mutex m_lock;
+	std::map<CAtlString,Entry> m_entries;
+	uint64_t m_bytes;
+	AnalysisCacheStats m_stats;
+};
+
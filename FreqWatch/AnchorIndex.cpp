@@ -0,0 +1,188 @@
+#include "AnchorIndex.h"
+#include <algorithm>
+
+void SortCheckPoints(CheckPoint *checks,size_t count)
+{
+	std::sort(checks,checks+count,CheckPointLess);
+}
+
+void BuildSongAnchors(const std::vector<FreqInfo> &freqinfos,std::vector<SongAnchor> &anchors)
+{
+	anchors.clear();
+	std::vector<FreqInfo> freqinfos_use;
+	for(auto i=freqinfos.begin();i<freqinfos.end();i++)
+	{
+		if(i->freq>StoreMinFreq && i->freq<StoreMaxFreq)
+		{
+			freqinfos_use.push_back(*i);
+		}
+	}
+	for(auto i=freqinfos_use.begin();i<freqinfos_use.end();i++)
+	{
+		SongAnchor anchor;
+		anchor.freq=i->freq;
+		anchor.time=i->time;
+		for(auto j=i+1;j<freqinfos_use.end();j++)
+		{
+			if(j->time>i->time+AnchorMaxTimeOffset)
+				break;
+			if(InTargetZone(*i,*j))
+			{
+				CheckPoint pt;
+				pt.freq=j->freq;
+				pt.time_offset=j->time-i->time;
+				anchor.checks.push_back(pt);
+			}
+		}
+		if((int)anchor.checks.size()>AnchorMinChecks)
+		{
+			std::sort(anchor.checks.begin(),anchor.checks.end(),CheckPointLess);
+			anchors.push_back(std::move(anchor));
+		}
+	}
+}
+
+int CountCheckMatches(const CheckPoint *checks,size_t count,int freq,int time_offset)
+{
+	const CheckPoint *end=checks+count;
+	const CheckPoint *cp=std::lower_bound(checks,end,freq-1,[](const CheckPoint &c,int f)
+	{
+		return c.freq<f;
+	});
+	int match_count=0;
+	for(;cp!=end && cp->freq<=freq+1;++cp)
+	{
+		if(cp->time_offset>=time_offset-1 && cp->time_offset<=time_offset+1)
+			match_count++;
+	}
+	return match_count;
+}
+
+void SelectQueryPeaks(const std::vector<FreqInfo> &freqinfos,std::vector<FreqInfo> &peaks)
+{
+	peaks.clear();
+	for(auto i=freqinfos.begin();i<freqinfos.end();i++)
+	{
+		if(i->freq>QueryMinFreq && i->freq<QueryMaxFreq)
+			peaks.push_back(*i);
+	}
+}
+
+size_t MatchAnchorPeaks(const std::vector<FreqInfo> &peaks,size_t begin,size_t end,IAnchorSource &source,
+	std::vector<MatchVote> &votes)
+{
+	size_t maybecount=0;
+	std::vector<CheckPoint> targets;
+	for(auto i=peaks.begin()+begin;i<peaks.begin()+end;i++)
+	{
+		const AnchorRef *anchors=nullptr;
+		size_t count=source.FindAnchors(i->freq,&anchors);
+		if(!count)
+			continue;
+		maybecount+=count;
+		//the peak's own targets,shared by all anchors stored at its freq
+		targets.clear();
+		for(auto j=i+1;j<peaks.end();j++)
+		{
+			if(j->time>i->time+AnchorMaxTimeOffset)
+				break;
+			if(InTargetZone(*i,*j))
+			{
+				CheckPoint pt;
+				pt.freq=j->freq;
+				pt.time_offset=j->time-i->time;
+				targets.push_back(pt);
+			}
+		}
+		if(targets.empty())
+			continue;
+		for(size_t a=0;a<count;a++)
+		{
+			const CheckPoint *checks=nullptr;
+			size_t checkCount=source.GetChecks(anchors[a],&checks);
+			int match_count=0;
+			for(auto t=targets.begin();t!=targets.end();++t)
+				match_count+=CountCheckMatches(checks,checkCount,t->freq,t->time_offset);
+			if(match_count>=AnchorMinMatches)
+			{
+				MatchVote vote;
+				vote.song_id=anchors[a].song_id;
+				vote.offset=anchors[a].time-i->time;
+				votes.push_back(vote);
+			}
+		}
+	}
+	return maybecount;
+}
+
+size_t MatchAnchors(const std::vector<FreqInfo> &freqinfos,IAnchorSource &source,std::vector<MatchVote> &votes)
+{
+	votes.clear();
+	std::vector<FreqInfo> peaks;
+	SelectQueryPeaks(freqinfos,peaks);
+	return MatchAnchorPeaks(peaks,0,peaks.size(),source,votes);
+}
+
+CAnchorStreamMatcher::CAnchorStreamMatcher():m_anchorsChecked(0)
+{
+}
+
+void CAnchorStreamMatcher::SetQuery(const std::vector<FreqInfo> &freqinfos)
+{
+	std::vector<FreqInfo> peaks;
+	SelectQueryPeaks(freqinfos,peaks);
+	m_anchorsChecked=0;
+	m_targets.clear();
+	m_freqs.clear();
+	m_freqStart.assign(QueryMaxFreq+1,0);
+	for(auto i=peaks.begin();i!=peaks.end();++i)
+		m_freqStart[i->freq+1]++;
+	for(size_t f=0;f+1<m_freqStart.size();f++)
+	{
+		if(m_freqStart[f+1])
+			m_freqs.push_back((int)f);
+		m_freqStart[f+1]+=m_freqStart[f];
+	}
+	m_peaks.resize(peaks.size());
+	std::vector<uint32_t> fill(m_freqStart.begin(),m_freqStart.end()-1);
+	for(auto i=peaks.begin();i!=peaks.end();++i)
+	{
+		QueryPeak &peak=m_peaks[fill[i->freq]++];
+		peak.time=i->time;
+		peak.targetBegin=(uint32_t)m_targets.size();
+		for(auto j=i+1;j!=peaks.end();++j)
+		{
+			if(j->time>i->time+AnchorMaxTimeOffset)
+				break;
+			if(InTargetZone(*i,*j))
+			{
+				CheckPoint pt;
+				pt.freq=j->freq;
+				pt.time_offset=j->time-i->time;
+				m_targets.push_back(pt);
+			}
+		}
+		peak.targetEnd=(uint32_t)m_targets.size();
+	}
+}
+
+void CAnchorStreamMatcher::AddAnchor(const AnchorRef &anchor,const CheckPoint *checks,size_t count,std::vector<MatchVote> &votes)
+{
+	if(anchor.freq<=QueryMinFreq || anchor.freq>=QueryMaxFreq)
+		return;
+	for(uint32_t p=m_freqStart[anchor.freq];p<m_freqStart[anchor.freq+1];p++)
+	{
+		const QueryPeak &peak=m_peaks[p];
+		m_anchorsChecked++;
+		int match_count=0;
+		for(uint32_t t=peak.targetBegin;t<peak.targetEnd;t++)
+			match_count+=CountCheckMatches(checks,count,m_targets[t].freq,m_targets[t].time_offset);
+		if(match_count>=AnchorMinMatches)
+		{
+			MatchVote vote;
+			vote.song_id=anchor.song_id;
+			vote.offset=anchor.time-peak.time;
+			votes.push_back(vote);
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "FreqPeaks.h"
+#include "VoteEngine.h"
+
+//later peaks inside this zone around an anchor become its check points
+const int AnchorMinTimeOffset=5;	//exclusive
+const int AnchorMaxTimeOffset=45;
+const int AnchorFreqSpan=30;		//exclusive
+//an anchor is only stored with more than this many check points
+const int AnchorMinChecks=3;
+//anchor bins kept at ingest and looked up by queries (both exclusive)
+const int StoreMinFreq=40;
+const int StoreMaxFreq=600;
+const int QueryMinFreq=20;
+const int QueryMaxFreq=400;
+//check points of a stored anchor answering one query target before it votes
+const int AnchorMinMatches=2;
+
+inline bool InTargetZone(const FreqInfo &anchor,const FreqInfo &target)
+{
+	return target.freq>anchor.freq-AnchorFreqSpan && target.freq<anchor.freq+AnchorFreqSpan &&
+		target.time>anchor.time+AnchorMinTimeOffset && target.time<=anchor.time+AnchorMaxTimeOffset;
+}
+
+struct AnchorRef
+{
+	int id;
+	int freq;
+	int time;
+	int song_id;
+};
+struct CheckPoint
+{
+	int freq;
+	int time_offset;
+};
+//one anchor of a song as it is written to Anchor_freq_index/Check_freq_index
+struct SongAnchor
+{
+	int freq;
+	int time;
+	std::vector<CheckPoint> checks;
+};
+
+inline bool CheckPointLess(const CheckPoint &a,const CheckPoint &b)
+{
+	return a.freq<b.freq || (a.freq==b.freq && a.time_offset<b.time_offset);
+}
+void SortCheckPoints(CheckPoint *checks,size_t count);
+
+//anchors of a peak list sorted by time,same rules as SaveMusicInfoToDb;
+//the checks of each anchor come out sorted by CheckPointLess
+void BuildSongAnchors(const std::vector<FreqInfo> &freqinfos,std::vector<SongAnchor> &anchors);
+//check points within one bin and one frame of a query target; checks must be
+//sorted by CheckPointLess,only the three freq rows around freq are visited
+int CountCheckMatches(const CheckPoint *checks,size_t count,int freq,int time_offset);
+
+class IAnchorSource
+{
+public:
+	virtual ~IAnchorSource(){}
+	//anchors stored at freq; the array stays valid until the next FindAnchors call
+	virtual size_t FindAnchors(int freq,const AnchorRef **anchors)=0;
+	//check points of an anchor returned by FindAnchors,sorted by CheckPointLess;
+	//valid while the source lives
+	virtual size_t GetChecks(const AnchorRef &anchor,const CheckPoint **checks)=0;
+	//true when several threads may call FindAnchors/GetChecks at once and the
+	//arrays handed out stay valid for the lifetime of the source
+	virtual bool SharedReads() const { return false; }
+};
+
+//the query peaks of freqinfos: those in the QueryMinFreq..QueryMaxFreq band
+void SelectQueryPeaks(const std::vector<FreqInfo> &freqinfos,std::vector<FreqInfo> &peaks);
+//the anchor query of OnFileOpen for peaks[begin..end): each peak looks up the
+//stored anchors at its freq, and a stored anchor whose check points answer at
+//least AnchorMinMatches of the peak's targets (taken from all of peaks) votes
+//for its song at anchor time minus query time; votes are appended and the
+//number of stored anchors examined is returned
+size_t MatchAnchorPeaks(const std::vector<FreqInfo> &peaks,size_t begin,size_t end,IAnchorSource &source,
+	std::vector<MatchVote> &votes);
+//MatchAnchorPeaks over all query peaks of freqinfos
+size_t MatchAnchors(const std::vector<FreqInfo> &freqinfos,IAnchorSource &source,std::vector<MatchVote> &votes);
+
+//////////////////////////////////////////////////////////////////////
+// CAnchorStreamMatcher
+// MatchAnchors turned around for sources that deliver the stored anchors
+// of the query's freqs in one pass with their check points, such as a
+// single SQL join: the query peaks and their targets are set up first,
+// then each anchor is tested against the peaks at its freq as it arrives.
+//////////////////////////////////////////////////////////////////////
+class CAnchorStreamMatcher
+{
+public:
+	CAnchorStreamMatcher();
+
+	void SetQuery(const std::vector<FreqInfo> &freqinfos);
+	//distinct freqs of the query peaks,ascending
+	const std::vector<int> &QueryFreqs() const { return m_freqs; }
+	//appends the votes of anchor; checks sorted by CheckPointLess
+	void AddAnchor(const AnchorRef &anchor,const CheckPoint *checks,size_t count,std::vector<MatchVote> &votes);
+	//counted as MatchAnchors counts them
+	size_t AnchorsChecked() const { return m_anchorsChecked; }
+private:
+	struct QueryPeak
+	{
+		int time;
+		uint32_t targetBegin;
+		uint32_t targetEnd;
+	};
+	//peaks grouped by freq: those at freq f are m_peaks[m_freqStart[f]..m_freqStart[f+1])
+	std::vector<QueryPeak> m_peaks;
+	std::vector<uint32_t> m_freqStart;
+	std::vector<CheckPoint> m_targets;
+	std::vector<int> m_freqs;
+	size_t m_anchorsChecked;
+};
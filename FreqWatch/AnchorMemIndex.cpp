@@ -0,0 +1,111 @@
+#include "AnchorMemIndex.h"
+#include <algorithm>
+
+CAnchorMemIndex::CAnchorMemIndex():m_nextId(1)
+{
+}
+
+void CAnchorMemIndex::AddAnchor(int id,int freq,int time,int song_id)
+{
+	AnchorRef ref;
+	ref.id=id;
+	ref.freq=freq;
+	ref.time=time;
+	ref.song_id=song_id;
+	m_anchors.push_back(ref);
+	if(id>=m_nextId)
+		m_nextId=id+1;
+}
+
+void CAnchorMemIndex::AddCheck(int anchor_id,int freq,int time_offset)
+{
+	PendingCheck check;
+	check.anchor_id=anchor_id;
+	check.pt.freq=freq;
+	check.pt.time_offset=time_offset;
+	m_pendingChecks.push_back(check);
+}
+
+void CAnchorMemIndex::AddSong(int song_id,const std::vector<SongAnchor> &anchors)
+{
+	for(auto i=anchors.begin();i!=anchors.end();++i)
+	{
+		int id=m_nextId;
+		AddAnchor(id,i->freq,i->time,song_id);
+		for(auto j=i->checks.begin();j!=i->checks.end();++j)
+			AddCheck(id,j->freq,j->time_offset);
+	}
+}
+
+void CAnchorMemIndex::Finish()
+{
+	std::sort(m_anchors.begin(),m_anchors.end(),[](const AnchorRef &a,const AnchorRef &b)
+	{
+		return a.freq<b.freq || (a.freq==b.freq && a.id<b.id);
+	});
+
+	int maxFreq=m_anchors.empty()?0:m_anchors.back().freq;
+	m_freqStart.assign(maxFreq+2,0);
+	for(auto i=m_anchors.begin();i!=m_anchors.end();++i)
+	{
+		if(i->freq>=0)
+			m_freqStart[i->freq+1]++;
+	}
+	for(size_t f=1;f<m_freqStart.size();f++)
+		m_freqStart[f]+=m_freqStart[f-1];
+
+	//anchor id -> position,then bucket the checks by position
+	std::vector<std::pair<int,uint32_t> > idPos(m_anchors.size());
+	for(size_t i=0;i<m_anchors.size();i++)
+		idPos[i]=std::make_pair(m_anchors[i].id,(uint32_t)i);
+	std::sort(idPos.begin(),idPos.end());
+	std::vector<uint32_t> checkPos(m_pendingChecks.size(),UINT32_MAX);
+	m_checkStart.assign(m_anchors.size()+1,0);
+	for(size_t i=0;i<m_pendingChecks.size();i++)
+	{
+		auto found=std::lower_bound(idPos.begin(),idPos.end(),std::make_pair(m_pendingChecks[i].anchor_id,(uint32_t)0));
+		if(found==idPos.end() || found->first!=m_pendingChecks[i].anchor_id)
+			continue;
+		checkPos[i]=found->second;
+		m_checkStart[found->second+1]++;
+	}
+	for(size_t i=1;i<m_checkStart.size();i++)
+		m_checkStart[i]+=m_checkStart[i-1];
+	m_checks.resize(m_checkStart.back());
+	std::vector<uint32_t> fill(m_checkStart.begin(),m_checkStart.end()-1);
+	for(size_t i=0;i<m_pendingChecks.size();i++)
+	{
+		if(checkPos[i]!=UINT32_MAX)
+			m_checks[fill[checkPos[i]]++]=m_pendingChecks[i].pt;
+	}
+	for(size_t i=0;i+1<m_checkStart.size();i++)
+		SortCheckPoints(m_checks.data()+m_checkStart[i],m_checkStart[i+1]-m_checkStart[i]);
+	std::vector<PendingCheck>().swap(m_pendingChecks);
+}
+
+size_t CAnchorMemIndex::MemorySize() const
+{
+	return m_anchors.size()*sizeof(AnchorRef)+m_freqStart.size()*sizeof(uint32_t)+
+		m_checks.size()*sizeof(CheckPoint)+m_checkStart.size()*sizeof(uint32_t);
+}
+
+size_t CAnchorMemIndex::FindAnchors(int freq,const AnchorRef **anchors)
+{
+	if(freq<0 || freq+1>=(int)m_freqStart.size() || m_freqStart[freq]==m_freqStart[freq+1])
+	{
+		*anchors=nullptr;
+		return 0;
+	}
+	*anchors=&m_anchors[m_freqStart[freq]];
+	return m_freqStart[freq+1]-m_freqStart[freq];
+}
+
+size_t CAnchorMemIndex::GetChecks(const AnchorRef &anchor,const CheckPoint **checks)
+{
+	//anchors handed out by FindAnchors point into m_anchors
+	size_t pos=&anchor-&m_anchors[0];
+	uint32_t begin=m_checkStart[pos];
+	uint32_t end=m_checkStart[pos+1];
+	*checks=begin==end?nullptr:&m_checks[begin];
+	return end-begin;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include "AnchorIndex.h"
+
+//////////////////////////////////////////////////////////////////////
+// CAnchorMemIndex
+// All anchors and check points in flat arrays (CSR layout): anchors are
+// grouped by freq with m_freqStart giving each group's range, and each
+// anchor's check points are the range m_checkStart[i]..m_checkStart[i+1]
+// of m_checks. Filled once through AddAnchor/AddCheck or AddSong, then
+// Finish; afterwards lookups are pure array scans.
+//////////////////////////////////////////////////////////////////////
+class CAnchorMemIndex:public IAnchorSource
+{
+public:
+	CAnchorMemIndex();
+
+	//anchor ids only link checks to their anchor and may be sparse
+	void AddAnchor(int id,int freq,int time,int song_id);
+	void AddCheck(int anchor_id,int freq,int time_offset);
+	//anchors of an analysed song,ids are assigned here
+	void AddSong(int song_id,const std::vector<SongAnchor> &anchors);
+	void Finish();
+
+	size_t AnchorCount() const { return m_anchors.size(); }
+	size_t CheckCount() const { return m_checks.size(); }
+	size_t MemorySize() const;
+
+	size_t FindAnchors(int freq,const AnchorRef **anchors);
+	size_t GetChecks(const AnchorRef &anchor,const CheckPoint **checks);
+	//read only once Finish has run
+	bool SharedReads() const { return true; }
+private:
+	struct PendingCheck
+	{
+		int anchor_id;
+		CheckPoint pt;
+	};
+	std::vector<AnchorRef> m_anchors;
+	std::vector<uint32_t> m_freqStart;
+	std::vector<CheckPoint> m_checks;
+	std::vector<uint32_t> m_checkStart;
+	std::vector<PendingCheck> m_pendingChecks;
+	int m_nextId;
+};
@@ -0,0 +1,165 @@
+#include "BatchQuery.h"
+#include <algorithm>
+
+namespace
+{
+	struct PendingPeak
+	{
+		int freq;
+		uint32_t query;
+		//its targets in the shared target buffer
+		uint32_t targetBegin;
+		uint32_t targetEnd;
+		int time;
+	};
+	struct CheckList
+	{
+		const CheckPoint *checks;
+		size_t count;
+	};
+	struct PendingHash
+	{
+		uint32_t key;
+		uint32_t query;
+		int time;
+	};
+}
+
+void BatchMatchAnchors(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,
+	std::vector<std::vector<MatchVote> > &votes,BatchStats &stats,const CSongTombstones *deleted)
+{
+	votes.assign(queries.size(),std::vector<MatchVote>());
+	stats.lookups=0;
+	stats.singleLookups=0;
+	stats.anchorsChecked=0;
+
+	std::vector<PendingPeak> pending;
+	std::vector<CheckPoint> targets;
+	std::vector<FreqInfo> peaks;
+	for(size_t q=0;q<queries.size();q++)
+	{
+		SelectQueryPeaks(queries[q],peaks);
+		for(auto i=peaks.begin();i!=peaks.end();++i)
+		{
+			stats.singleLookups++;
+			PendingPeak peak;
+			peak.freq=i->freq;
+			peak.query=(uint32_t)q;
+			peak.time=i->time;
+			peak.targetBegin=(uint32_t)targets.size();
+			for(auto j=i+1;j!=peaks.end();++j)
+			{
+				if(j->time>i->time+AnchorMaxTimeOffset)
+					break;
+				if(InTargetZone(*i,*j))
+				{
+					CheckPoint pt;
+					pt.freq=j->freq;
+					pt.time_offset=j->time-i->time;
+					targets.push_back(pt);
+				}
+			}
+			peak.targetEnd=(uint32_t)targets.size();
+			//a peak without targets can not vote
+			if(peak.targetEnd!=peak.targetBegin)
+				pending.push_back(peak);
+		}
+	}
+	std::stable_sort(pending.begin(),pending.end(),[](const PendingPeak &a,const PendingPeak &b)
+	{
+		return a.freq<b.freq;
+	});
+
+	std::vector<CheckList> checkLists;
+	for(size_t i=0;i<pending.size();)
+	{
+		size_t end=i+1;
+		while(end<pending.size() && pending[end].freq==pending[i].freq)
+			end++;
+		const AnchorRef *anchors=nullptr;
+		size_t count=source.FindAnchors(pending[i].freq,&anchors);
+		stats.lookups++;
+		stats.anchorsChecked+=count*(end-i);
+		//every check list of the freq fetched once,then the waiting peaks
+		//each stream through the anchors in index order
+		checkLists.resize(count);
+		for(size_t a=0;a<count;a++)
+		{
+			//an empty list answers no target,so the anchor can not vote
+			checkLists[a].checks=nullptr;
+			checkLists[a].count=0;
+			if(!deleted || !deleted->Contains(anchors[a].song_id))
+				checkLists[a].count=source.GetChecks(anchors[a],&checkLists[a].checks);
+		}
+		for(size_t p=i;p<end;p++)
+		{
+			const PendingPeak &peak=pending[p];
+			for(size_t a=0;a<count;a++)
+			{
+				int match_count=0;
+				for(uint32_t t=peak.targetBegin;t<peak.targetEnd;t++)
+					match_count+=CountCheckMatches(checkLists[a].checks,checkLists[a].count,targets[t].freq,targets[t].time_offset);
+				if(match_count>=AnchorMinMatches)
+				{
+					MatchVote vote;
+					vote.song_id=anchors[a].song_id;
+					vote.offset=anchors[a].time-peak.time;
+					votes[peak.query].push_back(vote);
+				}
+			}
+		}
+		i=end;
+	}
+}
+
+void BatchMatchHashes(const std::vector<std::vector<FingerprintHash> > &queries,IHashSource &source,
+	std::vector<std::vector<MatchVote> > &votes,BatchStats &stats)
+{
+	votes.assign(queries.size(),std::vector<MatchVote>());
+	stats.lookups=0;
+	stats.singleLookups=0;
+	stats.anchorsChecked=0;
+
+	std::vector<PendingHash> pending;
+	for(size_t q=0;q<queries.size();q++)
+	{
+		const std::vector<FingerprintHash> &query=queries[q];
+		for(size_t i=0;i<query.size();i++)
+		{
+			//MatchHashes looks each distinct key of a query up once
+			if(!i || query[i].key!=query[i-1].key)
+				stats.singleLookups++;
+			PendingHash hash;
+			hash.key=query[i].key;
+			hash.query=(uint32_t)q;
+			hash.time=query[i].time;
+			pending.push_back(hash);
+		}
+	}
+	std::stable_sort(pending.begin(),pending.end(),[](const PendingHash &a,const PendingHash &b)
+	{
+		return a.key<b.key;
+	});
+
+	for(size_t i=0;i<pending.size();)
+	{
+		size_t end=i+1;
+		while(end<pending.size() && pending[end].key==pending[i].key)
+			end++;
+		const HashPosting *postings=nullptr;
+		size_t count=source.FindHash(pending[i].key,&postings);
+		stats.lookups++;
+		for(size_t q=i;q<end;q++)
+		{
+			std::vector<MatchVote> &queryVotes=votes[pending[q].query];
+			for(size_t p=0;p<count;p++)
+			{
+				MatchVote vote;
+				vote.song_id=postings[p].song_id;
+				vote.offset=postings[p].time-pending[q].time;
+				queryVotes.push_back(vote);
+			}
+		}
+		i=end;
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "AnchorIndex.h"
+#include "HashIndex.h"
+#include "SongTombstones.h"
+
+struct BatchStats
+{
+	//source lookups made,and what the same queries one by one would have made
+	size_t lookups;
+	size_t singleLookups;
+	size_t anchorsChecked;
+};
+
+//MatchAnchors for many queries at once: the query peaks of all of them are
+//grouped by freq,so each freq's anchors are fetched once and each anchor's
+//check points once,then tested against every peak waiting on them;
+//votes[q] gets exactly the votes MatchAnchors gives queries[q],in another order;
+//anchors of deleted songs are passed over without fetching their check points
+void BatchMatchAnchors(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,
+	std::vector<std::vector<MatchVote> > &votes,BatchStats &stats,const CSongTombstones *deleted=nullptr);
+//MatchHashes the same way,one FindHash per distinct key over all queries
+void BatchMatchHashes(const std::vector<std::vector<FingerprintHash> > &queries,IHashSource &source,
+	std::vector<std::vector<MatchVote> > &votes,BatchStats &stats);
@@ -0,0 +1,122 @@
+#include "CaptureRing.h"
+#include <string.h>
+#include <chrono>
+
+CSampleRing::CSampleRing(size_t capacity):m_head(0),m_tail(0)
+{
+	size_t size=1;
+	while(size<capacity)
+		size<<=1;
+	m_buffer.resize(size);
+	m_mask=size-1;
+}
+
+bool CSampleRing::Write(const short *data,size_t count)
+{
+	size_t head=m_head.load(std::memory_order_relaxed);
+	size_t tail=m_tail.load(std::memory_order_acquire);
+	if(count>m_buffer.size()-(head-tail))
+		return false;
+	size_t pos=head&m_mask;
+	size_t first=m_buffer.size()-pos;
+	if(first>count)
+		first=count;
+	memcpy(&m_buffer[pos],data,first*sizeof(short));
+	if(count>first)
+		memcpy(&m_buffer[0],data+first,(count-first)*sizeof(short));
+	m_head.store(head+count,std::memory_order_release);
+	return true;
+}
+
+size_t CSampleRing::Read(short *data,size_t count)
+{
+	size_t tail=m_tail.load(std::memory_order_relaxed);
+	size_t head=m_head.load(std::memory_order_acquire);
+	if(count>head-tail)
+		count=head-tail;
+	size_t pos=tail&m_mask;
+	size_t first=m_buffer.size()-pos;
+	if(first>count)
+		first=count;
+	memcpy(data,&m_buffer[pos],first*sizeof(short));
+	if(count>first)
+		memcpy(data+first,&m_buffer[0],(count-first)*sizeof(short));
+	m_tail.store(tail+count,std::memory_order_release);
+	return count;
+}
+
+size_t CSampleRing::Available() const
+{
+	return m_head.load(std::memory_order_acquire)-m_tail.load(std::memory_order_acquire);
+}
+
+CCaptureWorker::CCaptureWorker(size_t ringSamples,size_t chunkSamples,const Consumer &consumer)
+	:m_ring(ringSamples),m_chunk(chunkSamples),m_consumer(consumer),m_running(false),
+	m_blocks(0),m_samples(0),m_overruns(0),m_droppedSamples(0),m_maxFill(0)
+{
+}
+
+CCaptureWorker::~CCaptureWorker()
+{
+	Stop();
+}
+
+void CCaptureWorker::Start()
+{
+	if(m_running.exchange(true))
+		return;
+	m_thread=std::thread(&CCaptureWorker::Run,this);
+}
+
+void CCaptureWorker::Stop()
+{
+	if(!m_running.exchange(false))
+		return;
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+void CCaptureWorker::Submit(const short *pcm,size_t count)
+{
+	m_blocks.fetch_add(1,std::memory_order_relaxed);
+	if(!m_ring.Write(pcm,count))
+	{
+		m_overruns.fetch_add(1,std::memory_order_relaxed);
+		m_droppedSamples.fetch_add(count,std::memory_order_relaxed);
+		return;
+	}
+	m_samples.fetch_add(count,std::memory_order_relaxed);
+	size_t fill=m_ring.Available();
+	if(fill>m_maxFill.load(std::memory_order_relaxed))
+		m_maxFill.store(fill,std::memory_order_relaxed);
+	//no lock taken here,a missed wakeup costs at most one wait timeout
+	m_wake.notify_one();
+}
+
+CaptureStats CCaptureWorker::Stats() const
+{
+	CaptureStats stats;
+	stats.blocks=m_blocks.load();
+	stats.samples=m_samples.load();
+	stats.overruns=m_overruns.load();
+	stats.droppedSamples=m_droppedSamples.load();
+	stats.maxFill=m_maxFill.load();
+	return stats;
+}
+
+void CCaptureWorker::Run()
+{
+	for(;;)
+	{
+		size_t count=m_ring.Read(&m_chunk[0],m_chunk.size());
+		if(count)
+		{
+			m_consumer(&m_chunk[0],count);
+			continue;
+		}
+		if(!m_running.load())
+			break;
+		std::unique_lock<std::mutex> lock(m_wakeLock);
+		m_wake.wait_for(lock,std::chrono::milliseconds(20));
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//////////////////////////////////////////////////////////////////////
+// CSampleRing
+// Single producer/single consumer ring of 16 bit samples. Storage is
+// allocated once; Write and Read never lock or allocate, so the
+// producer side is safe to call from an audio driver callback.
+//////////////////////////////////////////////////////////////////////
+class CSampleRing
+{
+public:
+	//capacity is rounded up to a power of two
+	explicit CSampleRing(size_t capacity);
+
+	//all or nothing: returns false when the block does not fit
+	bool Write(const short *data,size_t count);
+	size_t Read(short *data,size_t count);
+	size_t Available() const;
+	size_t Capacity() const { return m_buffer.size(); }
+private:
+	std::vector<short> m_buffer;
+	size_t m_mask;
+	std::atomic<size_t> m_head;
+	std::atomic<size_t> m_tail;
+};
+
+struct CaptureStats
+{
+	uint64_t blocks;
+	uint64_t samples;
+	//blocks refused because the worker fell behind and the ring was full
+	uint64_t overruns;
+	uint64_t droppedSamples;
+	size_t maxFill;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CCaptureWorker
+// The capture callback calls Submit, which only copies into the ring
+// and wakes the worker thread. The worker drains the ring in chunks and
+// hands them to the consumer (normally a CStftEngine) off the callback.
+//////////////////////////////////////////////////////////////////////
+class CCaptureWorker
+{
+public:
+	typedef std::function<void(const short *pcm,size_t count)> Consumer;
+
+	CCaptureWorker(size_t ringSamples,size_t chunkSamples,const Consumer &consumer);
+	~CCaptureWorker();
+
+	void Start();
+	//returns once everything submitted so far has been consumed
+	void Stop();
+
+	void Submit(const short *pcm,size_t count);
+	CaptureStats Stats() const;
+private:
+	void Run();
+
+	CSampleRing m_ring;
+	std::vector<short> m_chunk;
+	Consumer m_consumer;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+	std::mutex m_wakeLock;
+	std::condition_variable m_wake;
+
+	std::atomic<uint64_t> m_blocks;
+	std::atomic<uint64_t> m_samples;
+	std::atomic<uint64_t> m_overruns;
+	std::atomic<uint64_t> m_droppedSamples;
+	std::atomic<size_t> m_maxFill;
+};
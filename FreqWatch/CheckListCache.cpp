@@ -0,0 +1,100 @@
+#include "CheckListCache.h"
+
+//128 MB of check points,about a third of a 10k song library
+static CCheckListCache sharedCache(16*1024*1024);
+
+CCheckListCache &SharedCheckListCache()
+{
+	return sharedCache;
+}
+
+CCheckListCache::CCheckListCache(size_t maxPoints):m_shardCapacity(maxPoints/CheckCacheShards),m_hits(0),m_misses(0),m_evictions(0)
+{
+	for(size_t i=0;i<CheckCacheShards;i++)
+		m_shards[i].points=0;
+}
+
+CheckListPtr CCheckListCache::Find(int anchor_id)
+{
+	Shard &shard=ShardOf(anchor_id);
+	std::lock_guard<std::mutex> lock(shard.lock);
+	auto found=shard.entries.find(anchor_id);
+	if(found==shard.entries.end())
+	{
+		m_misses.fetch_add(1,std::memory_order_relaxed);
+		return CheckListPtr();
+	}
+	m_hits.fetch_add(1,std::memory_order_relaxed);
+	shard.lru.splice(shard.lru.begin(),shard.lru,found->second);
+	return found->second->second;
+}
+
+void CCheckListCache::Insert(int anchor_id,const CheckListPtr &checks)
+{
+	Shard &shard=ShardOf(anchor_id);
+	std::lock_guard<std::mutex> lock(shard.lock);
+	auto found=shard.entries.find(anchor_id);
+	if(found!=shard.entries.end())
+	{
+		shard.points-=found->second->second->size();
+		shard.lru.erase(found->second);
+		shard.entries.erase(found);
+	}
+	shard.lru.push_front(std::make_pair(anchor_id,checks));
+	shard.entries[anchor_id]=shard.lru.begin();
+	shard.points+=checks->size();
+	Trim(shard);
+}
+
+void CCheckListCache::Trim(Shard &shard)
+{
+	size_t capacity=m_shardCapacity.load();
+	//the list just inserted stays even when it alone is over capacity
+	while(shard.points>capacity && shard.lru.size()>1)
+	{
+		auto &last=shard.lru.back();
+		shard.points-=last.second->size();
+		shard.entries.erase(last.first);
+		shard.lru.pop_back();
+		m_evictions.fetch_add(1,std::memory_order_relaxed);
+	}
+}
+
+void CCheckListCache::Clear()
+{
+	for(size_t i=0;i<CheckCacheShards;i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].lock);
+		m_shards[i].lru.clear();
+		m_shards[i].entries.clear();
+		m_shards[i].points=0;
+	}
+}
+
+void CCheckListCache::SetCapacity(size_t maxPoints)
+{
+	m_shardCapacity.store(maxPoints/CheckCacheShards);
+	for(size_t i=0;i<CheckCacheShards;i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].lock);
+		Trim(m_shards[i]);
+	}
+}
+
+CheckCacheStats CCheckListCache::Stats()
+{
+	CheckCacheStats stats;
+	stats.hits=m_hits.load();
+	stats.misses=m_misses.load();
+	stats.evictions=m_evictions.load();
+	stats.entries=0;
+	stats.points=0;
+	stats.capacity=m_shardCapacity.load()*CheckCacheShards;
+	for(size_t i=0;i<CheckCacheShards;i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].lock);
+		stats.entries+=m_shards[i].entries.size();
+		stats.points+=m_shards[i].points;
+	}
+	return stats;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "AnchorIndex.h"
+
+typedef std::shared_ptr<const std::vector<CheckPoint> > CheckListPtr;
+
+struct CheckCacheStats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t entries;
+	size_t points;
+	size_t capacity;
+};
+
+//shards of the cache,each with its own lock and LRU order
+const size_t CheckCacheShards=16;
+
+//////////////////////////////////////////////////////////////////////
+// CCheckListCache
+// Check point lists of anchors by anchor id, bounded by the total number
+// of check points held and evicted least recently used first. Lists are
+// handed out as shared pointers, so a list evicted while a query holds
+// it stays valid for that query.
+//////////////////////////////////////////////////////////////////////
+class CCheckListCache
+{
+public:
+	explicit CCheckListCache(size_t maxPoints);
+
+	//null when anchor_id is not cached
+	CheckListPtr Find(int anchor_id);
+	void Insert(int anchor_id,const CheckListPtr &checks);
+	//after anchors were deleted or ids reused
+	void Clear();
+	void SetCapacity(size_t maxPoints);
+	CheckCacheStats Stats();
+private:
+	typedef std::list<std::pair<int,CheckListPtr> > LruList;
+	struct Shard
+	{
+		std::mutex lock;
+		//most recently used first
+		LruList lru;
+		std::unordered_map<int,LruList::iterator> entries;
+		size_t points;
+	};
+	Shard &ShardOf(int anchor_id) { return m_shards[(uint32_t)anchor_id%CheckCacheShards]; }
+	void Trim(Shard &shard);
+
+	Shard m_shards[CheckCacheShards];
+	std::atomic<size_t> m_shardCapacity;
+	std::atomic<uint64_t> m_hits;
+	std::atomic<uint64_t> m_misses;
+	std::atomic<uint64_t> m_evictions;
+};
+
+//the cache shared by every database backed anchor source of the process
+CCheckListCache &SharedCheckListCache();
@@ -0,0 +1,68 @@
+#include "CheckPack.h"
+
+void PackCheckPoints(const CheckPoint *checks,size_t count,std::vector<uint8_t> &blob)
+{
+	blob.clear();
+	PutVarint(blob,(uint32_t)count);
+	for(size_t i=0;i<count;i++)
+	{
+		if(!i)
+		{
+			PutVarint(blob,ZigZag(checks[i].freq));
+			PutVarint(blob,ZigZag(checks[i].time_offset));
+		}
+		else if(checks[i].freq==checks[i-1].freq)
+		{
+			PutVarint(blob,0);
+			PutVarint(blob,(uint32_t)(checks[i].time_offset-checks[i-1].time_offset));
+		}
+		else
+		{
+			PutVarint(blob,(uint32_t)(checks[i].freq-checks[i-1].freq));
+			PutVarint(blob,ZigZag(checks[i].time_offset));
+		}
+	}
+}
+
+bool UnpackCheckPoints(const uint8_t *blob,size_t size,std::vector<CheckPoint> &checks)
+{
+	checks.clear();
+	const uint8_t *pos=blob;
+	const uint8_t *end=blob+size;
+	uint32_t count;
+	//every point takes at least two bytes
+	if(!GetVarint(pos,end,count) || count>(size_t)(end-pos)/2)
+		return false;
+	checks.resize(count);
+	for(uint32_t i=0;i<count;i++)
+	{
+		uint32_t freq,time;
+		if(!GetVarint(pos,end,freq) || !GetVarint(pos,end,time))
+		{
+			checks.clear();
+			return false;
+		}
+		CheckPoint &pt=checks[i];
+		if(!i)
+		{
+			pt.freq=UnZigZag(freq);
+			pt.time_offset=UnZigZag(time);
+		}
+		else if(!freq)
+		{
+			pt.freq=checks[i-1].freq;
+			pt.time_offset=checks[i-1].time_offset+(int)time;
+		}
+		else
+		{
+			pt.freq=checks[i-1].freq+(int)freq;
+			pt.time_offset=UnZigZag(time);
+		}
+	}
+	if(pos!=end)
+	{
+		checks.clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "AnchorIndex.h"
+
+//Check points of one anchor as a byte string: the point count, then per
+//point in CheckPointLess order the freq step from the previous point and
+//the time offset, itself a step when the freq repeats. Every number is a
+//LEB128 varint; the first freq and a time after a freq change are zigzag
+//coded so negative values stay short too. A typical point takes 2 bytes
+//against two integer columns and a row of Check_freq_index.
+
+inline void PutVarint(std::vector<uint8_t> &out,uint32_t value)
+{
+	while(value>=0x80)
+	{
+		out.push_back((uint8_t)(value|0x80));
+		value>>=7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+//false when the bytes run out or the value overflows 32 bits
+inline bool GetVarint(const uint8_t *&pos,const uint8_t *end,uint32_t &value)
+{
+	value=0;
+	for(int shift=0;shift<35;shift+=7)
+	{
+		if(pos==end)
+			return false;
+		uint8_t b=*pos++;
+		//the 5th byte has room for the top 4 bits only
+		if(shift==28 && (b&0x70))
+			return false;
+		value|=(uint32_t)(b&0x7f)<<shift;
+		if(!(b&0x80))
+			return true;
+	}
+	return false;
+}
+
+inline uint32_t ZigZag(int value)
+{
+	return ((uint32_t)value<<1)^(uint32_t)(value>>31);
+}
+inline int UnZigZag(uint32_t value)
+{
+	return (int)(value>>1)^-(int)(value&1);
+}
+
+//checks must be sorted by CheckPointLess; blob is replaced
+void PackCheckPoints(const CheckPoint *checks,size_t count,std::vector<uint8_t> &blob);
+//checks is replaced; false on a malformed blob,leaving checks empty
+bool UnpackCheckPoints(const uint8_t *blob,size_t size,std::vector<CheckPoint> &checks);
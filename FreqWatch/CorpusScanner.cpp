@@ -0,0 +1,321 @@
+#include "StdAfx.h"
+#include "CorpusScanner.h"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include "MappedFile.h"
+#include "WorkStealingPool.h"
+
+static inline uint64_t MixHash(uint64_t h)
+{
+	h^=h>>33;
+	h*=0xFF51AFD7ED558CCDull;
+	h^=h>>33;
+	h*=0xC4CEB9FE1A85EC53ull;
+	h^=h>>33;
+	return h;
+}
+
+uint64_t ContentHash(const void *data,size_t size)
+{
+	//four independent lanes over 32 byte blocks,so the multiplies overlap
+	const uint8_t *bytes=(const uint8_t*)data;
+	uint64_t lanes[4]={0x9E3779B97F4A7C15ull,0xBF58476D1CE4E5B9ull,0x94D049BB133111EBull,0x2545F4914F6CDD1Dull};
+	size_t blocks=size/32;
+	for(size_t b=0;b<blocks;b++)
+	{
+		for(int l=0;l<4;l++)
+		{
+			uint64_t word;
+			memcpy(&word,bytes+b*32+l*8,8);
+			lanes[l]=(lanes[l]^word)*0x9E3779B97F4A7C15ull;
+			lanes[l]^=lanes[l]>>29;
+		}
+	}
+	uint8_t tail[32]={0};
+	memcpy(tail,bytes+blocks*32,size-blocks*32);
+	uint64_t hash=size;
+	for(int l=0;l<4;l++)
+	{
+		uint64_t word;
+		memcpy(&word,tail+l*8,8);
+		hash=MixHash(hash^MixHash(lanes[l]^word));
+	}
+	return hash;
+}
+
+bool HashFileContent(LPCWSTR path,uint64_t &hash)
+{
+	CMappedFile file;
+	if(!file.Open(path))
+		return false;
+	hash=ContentHash(file.Data(),file.Size());
+	return true;
+}
+
+CIngestCheckpoint::CIngestCheckpoint():m_log(nullptr)
+{
+}
+
+CIngestCheckpoint::~CIngestCheckpoint()
+{
+	Close();
+}
+
+void CIngestCheckpoint::FormatLine(const CAtlString &path,const CheckpointEntry &entry,std::string &line)
+{
+	char numbers[80];
+	sprintf_s(numbers,"%016llx %llx %llx %d ",(unsigned long long)entry.contentHash,(unsigned long long)entry.size,
+		(unsigned long long)entry.modified,entry.song_id);
+	line=numbers;
+	line+=CW2A(path,CP_UTF8);
+	line+="\n";
+}
+
+bool CIngestCheckpoint::Open(LPCWSTR path)
+{
+	Close();
+	m_entries.clear();
+	size_t lines=0;
+	FILE *log=_wfopen(path,L"rb");
+	if(log)
+	{
+		std::vector<char> line(1<<16);
+		while(fgets(&line[0],(int)line.size(),log))
+		{
+			unsigned long long hash,size,modified;
+			int song_id;
+			int used=0;
+			//a line cut short by a crash has no path or no newline
+			if(sscanf(&line[0],"%llx %llx %llx %d %n",&hash,&size,&modified,&song_id,&used)<4 || !used)
+				continue;
+			char *name=&line[used];
+			size_t length=strlen(name);
+			if(!length || name[length-1]!='\n')
+				continue;
+			while(length && (name[length-1]=='\n' || name[length-1]=='\r'))
+				name[--length]=0;
+			lines++;
+			if(!song_id)
+			{
+				m_entries.erase(CAtlString(CA2W(name,CP_UTF8)));
+				continue;
+			}
+			CheckpointEntry &entry=m_entries[CAtlString(CA2W(name,CP_UTF8))];
+			entry.contentHash=hash;
+			entry.size=size;
+			entry.modified=modified;
+			entry.song_id=song_id;
+		}
+		fclose(log);
+	}
+	//mostly replaced lines: write the live ones out as a new log
+	if(lines>1024 && lines>2*m_entries.size())
+	{
+		std::string text,line;
+		for(auto i=m_entries.begin();i!=m_entries.end();++i)
+		{
+			FormatLine(i->first,i->second,line);
+			text+=line;
+		}
+		if(!WriteWholeFile(path,text.c_str(),text.size()))
+			return false;
+	}
+	m_log=_wfopen(path,L"ab");
+	return m_log!=nullptr;
+}
+
+void CIngestCheckpoint::Close()
+{
+	if(m_log)
+		fclose(m_log);
+	m_log=nullptr;
+}
+
+const CheckpointEntry *CIngestCheckpoint::Find(const CAtlString &path) const
+{
+	auto found=m_entries.find(path);
+	return found==m_entries.end()?nullptr:&found->second;
+}
+
+bool CIngestCheckpoint::Record(const CAtlString &path,const CheckpointEntry &entry)
+{
+	if(!m_log)
+		return false;
+	std::string line;
+	FormatLine(path,entry,line);
+	bool written=fputs(line.c_str(),m_log)>=0 && !fflush(m_log);
+	m_entries[path]=entry;
+	return written;
+}
+
+size_t CIngestCheckpoint::ForgetSongs(std::vector<int> song_ids)
+{
+	if(!m_log)
+		return 0;
+	std::sort(song_ids.begin(),song_ids.end());
+	CheckpointEntry forgotten;
+	memset(&forgotten,0,sizeof(forgotten));
+	std::string line;
+	size_t count=0;
+	for(auto i=m_entries.begin();i!=m_entries.end();)
+	{
+		if(!std::binary_search(song_ids.begin(),song_ids.end(),i->second.song_id))
+		{
+			++i;
+			continue;
+		}
+		FormatLine(i->first,forgotten,line);
+		fputs(line.c_str(),m_log);
+		i=m_entries.erase(i);
+		count++;
+	}
+	fflush(m_log);
+	return count;
+}
+
+bool IsAudioFileName(LPCWSTR path)
+{
+	static const wchar_t *extensions[]={L".wav",L".mp3",L".wma",L".m4a",L".mp4",L".aac",L".flac",L".ogg"};
+	const wchar_t *dot=wcsrchr(path,L'.');
+	if(!dot)
+		return false;
+	for(size_t i=0;i<sizeof(extensions)/sizeof(extensions[0]);i++)
+	{
+		if(!_wcsicmp(dot,extensions[i]))
+			return true;
+	}
+	return false;
+}
+
+bool LooksLikeAudio(const uint8_t *head,size_t size)
+{
+	static const uint8_t asf[]={0x30,0x26,0xB2,0x75,0x8E,0x66,0xCF,0x11};
+	if(size<12)
+		return false;
+	if(!memcmp(head,"RIFF",4) && !memcmp(head+8,"WAVE",4))
+		return true;
+	if(!memcmp(head,"ID3",3) || !memcmp(head,"fLaC",4) || !memcmp(head,"OggS",4) || !memcmp(head+4,"ftyp",4) ||
+		!memcmp(head,asf,sizeof(asf)))
+		return true;
+	//an mpeg audio or adts frame sync
+	return head[0]==0xFF && (head[1]&0xE0)==0xE0;
+}
+
+//what one thread of ScanCorpus found
+struct ScanShare
+{
+	ScanShare()
+	{
+		memset(&stats,0,sizeof(stats));
+	}
+	std::vector<CorpusFile> files;
+	std::vector<std::pair<CAtlString,CheckpointEntry> > touched;
+	CorpusScanStats stats;
+};
+
+static void ScanDirectory(CWorkStealingPool &pool,size_t slot,const CAtlString &dir,const CIngestCheckpoint *checkpoint,
+	std::vector<ScanShare> &shares)
+{
+	ScanShare &share=shares[slot];
+	share.stats.directories++;
+	WIN32_FIND_DATAW found;
+	HANDLE find=FindFirstFileW(dir+L"\\*",&found);
+	if(find==INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		CAtlString path=dir+L"\\"+found.cFileName;
+		if(found.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY)
+		{
+			//links could lead back up the tree
+			if(!wcscmp(found.cFileName,L".") || !wcscmp(found.cFileName,L"..") ||
+				(found.dwFileAttributes&FILE_ATTRIBUTE_REPARSE_POINT))
+				continue;
+			pool.Push(slot,[&pool,path,checkpoint,&shares](size_t next)
+			{
+				ScanDirectory(pool,next,path,checkpoint,shares);
+			});
+			continue;
+		}
+		if(!IsAudioFileName(found.cFileName))
+		{
+			share.stats.notAudio++;
+			continue;
+		}
+		CorpusFile file;
+		file.path=path;
+		file.size=(uint64_t)found.nFileSizeHigh<<32|found.nFileSizeLow;
+		file.modified=(uint64_t)found.ftLastWriteTime.dwHighDateTime<<32|found.ftLastWriteTime.dwLowDateTime;
+		file.contentHash=0;
+		const CheckpointEntry *entry=checkpoint?checkpoint->Find(path):nullptr;
+		if(entry && entry->size==file.size && entry->modified==file.modified)
+		{
+			share.stats.files++;
+			share.stats.unchanged++;
+			continue;
+		}
+		CMappedFile mapped;
+		if(!mapped.Open(path) || !LooksLikeAudio((const uint8_t*)mapped.Data(),mapped.Size()))
+		{
+			share.stats.notAudio++;
+			continue;
+		}
+		share.stats.files++;
+		if(entry && entry->size==file.size)
+		{
+			file.contentHash=ContentHash(mapped.Data(),mapped.Size());
+			if(file.contentHash==entry->contentHash)
+			{
+				CheckpointEntry touched=*entry;
+				touched.modified=file.modified;
+				share.touched.push_back(std::make_pair(path,touched));
+				share.stats.touched++;
+				continue;
+			}
+		}
+		share.files.push_back(file);
+	}
+	while(FindNextFileW(find,&found));
+	FindClose(find);
+}
+
+void ScanCorpus(LPCWSTR root,CIngestCheckpoint *checkpoint,size_t threads,std::vector<CorpusFile> &files,
+	CorpusScanStats &stats)
+{
+	auto start=std::chrono::steady_clock::now();
+	memset(&stats,0,sizeof(stats));
+	files.clear();
+	CWorkStealingPool pool(threads);
+	std::vector<ScanShare> shares(pool.Threads());
+	CAtlString dir(root);
+	dir.TrimRight(L'\\');
+	pool.Push(0,[&pool,dir,checkpoint,&shares](size_t slot)
+	{
+		ScanDirectory(pool,slot,dir,checkpoint,shares);
+	});
+	pool.Wait();
+
+	for(auto i=shares.begin();i!=shares.end();++i)
+	{
+		files.insert(files.end(),i->files.begin(),i->files.end());
+		stats.directories+=i->stats.directories;
+		stats.files+=i->stats.files;
+		stats.notAudio+=i->stats.notAudio;
+		stats.unchanged+=i->stats.unchanged;
+		stats.touched+=i->stats.touched;
+		//the checkpoint is only read while the pool runs
+		for(auto t=i->touched.begin();t!=i->touched.end();++t)
+			checkpoint->Record(t->first,t->second);
+	}
+	std::sort(files.begin(),files.end(),[](const CorpusFile &a,const CorpusFile &b)
+	{
+		if(a.size!=b.size)
+			return a.size>b.size;
+		return a.path<b.path;
+	});
+	stats.todo=files.size();
+	for(auto i=files.begin();i!=files.end();++i)
+		stats.todoBytes+=i->size;
+	stats.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+//64 bit hash of a file's bytes,for telling a changed file from one only
+//touched; not meant to resist crafted collisions
+uint64_t ContentHash(const void *data,size_t size);
+bool HashFileContent(LPCWSTR path,uint64_t &hash);
+
+//////////////////////////////////////////////////////////////////////
+// CIngestCheckpoint
+// The files an ingest has finished,as a log next to the database: a
+// line per file appended and flushed as each one is written,so an
+// ingest that is cut off loses at most the files it had not recorded.
+// A later line for the same path replaces the earlier one; Open rewrites
+// the log once most of its lines are replaced. A line with song_id 0
+// removes the path,so the file of a deleted song is ingested again.
+// Line: hash size modified song_id path,the numbers in hex,the path UTF-8.
+//////////////////////////////////////////////////////////////////////
+struct CheckpointEntry
+{
+	uint64_t size;
+	//last write time,FILETIME ticks
+	uint64_t modified;
+	uint64_t contentHash;
+	int song_id;
+};
+
+class CIngestCheckpoint
+{
+public:
+	CIngestCheckpoint();
+	~CIngestCheckpoint();
+
+	//loads the log at path,created if missing,and appends to it from then on
+	bool Open(LPCWSTR path);
+	void Close();
+
+	size_t Count() const { return m_entries.size(); }
+	//null for a file not recorded; not to be called while Record runs
+	const CheckpointEntry *Find(const CAtlString &path) const;
+	bool Record(const CAtlString &path,const CheckpointEntry &entry);
+	//removes the files recorded as any of song_ids,returns how many
+	size_t ForgetSongs(std::vector<int> song_ids);
+private:
+	CIngestCheckpoint(const CIngestCheckpoint&);
+	CIngestCheckpoint &operator=(const CIngestCheckpoint&);
+
+	static void FormatLine(const CAtlString &path,const CheckpointEntry &entry,std::string &line);
+
+	FILE *m_log;
+	std::map<CAtlString,CheckpointEntry> m_entries;
+};
+
+//////////////////////////////////////////////////////////////////////
+// ScanCorpus
+// The audio files under root,subdirectories included,largest first so
+// the longest analyses start early and the pipeline ends on short ones.
+// Directories are listed in parallel on a CWorkStealingPool. A file
+// passes on its extension and then on the magic bytes at its head.
+// With a checkpoint,a file recorded with the same size and write time
+// is passed over unopened; one whose time changed but whose content
+// hash did not is passed over too,and its entry rewritten.
+//////////////////////////////////////////////////////////////////////
+struct CorpusFile
+{
+	CAtlString path;
+	uint64_t size;
+	uint64_t modified;
+	//0 until hashed
+	uint64_t contentHash;
+};
+
+struct CorpusScanStats
+{
+	size_t directories;
+	//audio files found,and the files left out as not audio
+	size_t files;
+	size_t notAudio;
+	//passed over by the checkpoint,unchanged or only touched
+	size_t unchanged;
+	size_t touched;
+	//left to ingest
+	size_t todo;
+	uint64_t todoBytes;
+	double seconds;
+};
+
+//threads 0 uses every core
+void ScanCorpus(LPCWSTR root,CIngestCheckpoint *checkpoint,size_t threads,std::vector<CorpusFile> &files,
+	CorpusScanStats &stats);
+//by extension and magic bytes: wav,mp3,wma,m4a/mp4/aac,flac and ogg
+bool IsAudioFileName(LPCWSTR path);
+bool LooksLikeAudio(const uint8_t *head,size_t size);
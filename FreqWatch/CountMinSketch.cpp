@@ -0,0 +1,128 @@
+#include "CountMinSketch.h"
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+static const uint32_t SketchMagic=0x4d435746;	//"FWCM"
+static const uint32_t SketchVersion=1;
+
+//odd multipliers of the rows' multiply-shift hashes
+static const uint64_t SketchSeeds[]=
+{
+	0x9e3779b97f4a7c15ull,0xc2b2ae3d27d4eb4full,0x165667b19e3779f9ull,0xd6e8feb86659fd93ull,
+	0xa0761d6478bd642full,0xe7037ed1a0b428dbull,0x8ebc6af09c88c6e3ull,0x589965cc75374cc3ull,
+};
+static const int SketchMaxDepth=sizeof(SketchSeeds)/sizeof(SketchSeeds[0]);
+
+struct SketchHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t widthBits;
+	uint32_t depth;
+	uint64_t total;
+	uint64_t used;
+};
+
+CCountMinSketch::CCountMinSketch(int widthBits,int depth):m_widthBits(std::min(std::max(widthBits,1),31)),
+	m_depth(std::min(std::max(depth,1),SketchMaxDepth)),m_total(0),m_used(0)
+{
+	m_counters.resize((size_t)m_depth<<m_widthBits);
+}
+
+size_t CCountMinSketch::Cell(int row,uint32_t key) const
+{
+	//the high bits of the product,with the row added in so keys that
+	//collide in one row do not collide in the next
+	uint64_t hash=((uint64_t)key+row+1)*SketchSeeds[row];
+	return ((size_t)row<<m_widthBits)+(size_t)(hash>>(64-m_widthBits));
+}
+
+void CCountMinSketch::Add(uint32_t key,uint32_t count)
+{
+	if(!count)
+		return;
+	size_t cells[SketchMaxDepth]={};
+	uint32_t least=UINT_MAX;
+	for(int r=0;r<m_depth;r++)
+	{
+		cells[r]=Cell(r,key);
+		least=std::min(least,m_counters[cells[r]]);
+	}
+	uint32_t target=least>UINT_MAX-count?UINT_MAX:least+count;
+	if(!m_counters[cells[0]])
+		m_used++;
+	for(int r=0;r<m_depth;r++)
+	{
+		if(m_counters[cells[r]]<target)
+			m_counters[cells[r]]=target;
+	}
+	m_total+=count;
+}
+
+uint32_t CCountMinSketch::Estimate(uint32_t key) const
+{
+	uint32_t least=UINT_MAX;
+	for(int r=0;r<m_depth;r++)
+		least=std::min(least,m_counters[Cell(r,key)]);
+	return least;
+}
+
+void CCountMinSketch::Clear()
+{
+	std::fill(m_counters.begin(),m_counters.end(),0);
+	m_total=0;
+	m_used=0;
+}
+
+double CCountMinSketch::DistinctKeys() const
+{
+	//linear counting: n keys leave about width*e^(-n/width) cells unused
+	double width=(double)((size_t)1<<m_widthBits);
+	if(m_used>=(size_t)1<<m_widthBits)
+		return width*log(width);
+	return -width*log((width-m_used)/width);
+}
+
+double CCountMinSketch::MeanCount() const
+{
+	double distinct=DistinctKeys();
+	return distinct>0?m_total/distinct:0;
+}
+
+void CCountMinSketch::Save(std::vector<uint8_t> &image) const
+{
+	SketchHeader header;
+	memset(&header,0,sizeof(header));
+	header.magic=SketchMagic;
+	header.version=SketchVersion;
+	header.widthBits=m_widthBits;
+	header.depth=m_depth;
+	header.total=m_total;
+	header.used=m_used;
+	image.resize(sizeof(header)+Bytes());
+	memcpy(&image[0],&header,sizeof(header));
+	memcpy(&image[sizeof(header)],&m_counters[0],Bytes());
+}
+
+bool CCountMinSketch::Load(const void *data,size_t size)
+{
+	SketchHeader header;
+	if(size>=sizeof(header))
+		memcpy(&header,data,sizeof(header));
+	if(size<sizeof(header) || header.magic!=SketchMagic || header.version!=SketchVersion ||
+		header.widthBits<1 || header.widthBits>31 || header.depth<1 || header.depth>(uint32_t)SketchMaxDepth ||
+		size!=sizeof(header)+((uint64_t)header.depth<<header.widthBits)*sizeof(uint32_t))
+	{
+		Clear();
+		return false;
+	}
+	m_widthBits=header.widthBits;
+	m_depth=header.depth;
+	m_counters.resize((size_t)m_depth<<m_widthBits);
+	memcpy(&m_counters[0],(const uint8_t*)data+sizeof(header),Bytes());
+	m_total=header.total;
+	m_used=(size_t)header.used;
+	return true;
+}
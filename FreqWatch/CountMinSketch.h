@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//columns per row as a power of two,and rows: 4 rows of 1<<20 counters
+//take 16 MB and overestimate a key by under e/(1<<20) of the total in
+//all but about 2% of keys; the distinct keys are counted well up to a
+//few times the width
+const int SketchWidthBits=20;
+const int SketchDepth=4;
+
+//////////////////////////////////////////////////////////////////////
+// CCountMinSketch
+// Approximate counts of keys in a fixed size table: each of depth rows
+// adds a key's count to one counter picked by a hash of its own,and the
+// estimate is the smallest of them. An estimate is never below the true
+// count. Adds are conservative,raising only the counters that are below
+// the new estimate,which keeps the error on rare keys down. The distinct
+// keys are estimated from the counters of the first row still at 0.
+// Saved as an image: magic,version,width bits,depth,total,used cells,
+// then the counters row by row.
+//////////////////////////////////////////////////////////////////////
+class CCountMinSketch
+{
+public:
+	CCountMinSketch(int widthBits=SketchWidthBits,int depth=SketchDepth);
+
+	void Add(uint32_t key,uint32_t count=1);
+	uint32_t Estimate(uint32_t key) const;
+	void Clear();
+	//sum of every count added
+	uint64_t Total() const { return m_total; }
+	double DistinctKeys() const;
+	//Total over DistinctKeys,0 while empty
+	double MeanCount() const;
+	size_t Bytes() const { return m_counters.size()*sizeof(uint32_t); }
+
+	void Save(std::vector<uint8_t> &image) const;
+	//false if data is not a sketch,it is then cleared; the width and
+	//depth are taken from the image
+	bool Load(const void *data,size_t size);
+private:
+	size_t Cell(int row,uint32_t key) const;
+
+	int m_widthBits;
+	int m_depth;
+	std::vector<uint32_t> m_counters;
+	uint64_t m_total;
+	//cells of the first row above 0
+	size_t m_used;
+};
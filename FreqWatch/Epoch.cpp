@@ -0,0 +1,94 @@
+#include "Epoch.h"
+#include <thread>
+
+CEpochManager::CEpochManager(size_t slots):m_slots(slots?slots:1),m_epoch(1),m_retiredCount(0),m_reclaimed(0),m_maxPending(0)
+{
+	for(auto i=m_slots.begin();i!=m_slots.end();++i)
+		i->epoch.store(0);
+}
+
+CEpochManager::~CEpochManager()
+{
+	for(auto i=m_retired.begin();i!=m_retired.end();++i)
+		i->free();
+}
+
+size_t CEpochManager::Enter()
+{
+	//threads start looking at different slots
+	size_t start=std::hash<std::thread::id>()(std::this_thread::get_id())%m_slots.size();
+	for(;;)
+	{
+		for(size_t n=0;n<m_slots.size();n++)
+		{
+			Slot &slot=m_slots[(start+n)%m_slots.size()];
+			if(slot.epoch.load(std::memory_order_relaxed))
+				continue;
+			//the announcement is ordered before the reader's loads: a writer
+			//that finds the slot free has already unlinked what it retires
+			uint64_t free=0;
+			if(slot.epoch.compare_exchange_strong(free,m_epoch.load()))
+				return (start+n)%m_slots.size();
+		}
+		std::this_thread::yield();
+	}
+}
+
+void CEpochManager::Exit(size_t slot)
+{
+	m_slots[slot].epoch.store(0,std::memory_order_release);
+}
+
+void CEpochManager::Retire(const std::function<void()> &free)
+{
+	Retired retired;
+	retired.free=free;
+	std::lock_guard<std::mutex> lock(m_retireLock);
+	//readers that announce a later epoch can no longer reach it
+	retired.epoch=m_epoch.fetch_add(1);
+	m_retired.push_back(retired);
+	m_retiredCount++;
+	if(m_retired.size()>m_maxPending)
+		m_maxPending=m_retired.size();
+}
+
+size_t CEpochManager::Reclaim()
+{
+	std::vector<Retired> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_retireLock);
+		uint64_t oldest=UINT64_MAX;
+		for(auto i=m_slots.begin();i!=m_slots.end();++i)
+		{
+			uint64_t epoch=i->epoch.load();
+			if(epoch && epoch<oldest)
+				oldest=epoch;
+		}
+		size_t kept=0;
+		for(size_t i=0;i<m_retired.size();i++)
+		{
+			if(m_retired[i].epoch<oldest)
+				ready.push_back(m_retired[i]);
+			else
+				m_retired[kept++]=m_retired[i];
+		}
+		m_retired.resize(kept);
+		m_reclaimed+=ready.size();
+	}
+	//outside the lock,a free may unmap or delete a file
+	for(auto i=ready.begin();i!=ready.end();++i)
+		i->free();
+	return ready.size();
+}
+
+EpochStats CEpochManager::Stats()
+{
+	std::lock_guard<std::mutex> lock(m_retireLock);
+	EpochStats stats;
+	stats.epoch=m_epoch.load();
+	stats.retired=m_retiredCount;
+	stats.reclaimed=m_reclaimed;
+	stats.pending=m_retired.size();
+	stats.maxPending=m_maxPending;
+	return stats;
+}
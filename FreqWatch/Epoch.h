@@ -0,0 +1,117 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct EpochStats
+{
+	uint64_t epoch;
+	size_t retired;
+	size_t reclaimed;
+	//retired and still waiting on a reader,now and at most
+	size_t pending;
+	size_t maxPending;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CEpochManager
+// Epoch based reclamation. A reader claims a slot and announces the
+// epoch it started in; nothing it could have loaded is freed until it
+// leaves. Retire tags an object with the epoch it was unlinked in and
+// moves the epoch on; Reclaim frees what every announced epoch is past.
+// Readers never lock or allocate. Retire and Reclaim may lock and free,
+// they are for the writers.
+//////////////////////////////////////////////////////////////////////
+class CEpochManager
+{
+public:
+	//readers at once; more wait in Enter for a slot
+	explicit CEpochManager(size_t slots=64);
+	~CEpochManager();
+
+	size_t Enter();
+	void Exit(size_t slot);
+
+	//free runs once no reader can still see what it frees
+	void Retire(const std::function<void()> &free);
+	template<class T> void RetireObject(T *object)
+	{
+		Retire([object]()
+		{
+			delete object;
+		});
+	}
+	//returns the number freed
+	size_t Reclaim();
+	EpochStats Stats();
+private:
+	CEpochManager(const CEpochManager&);
+	CEpochManager &operator=(const CEpochManager&);
+
+	//a cache line each,so readers on different slots don't share one
+	struct Slot
+	{
+		std::atomic<uint64_t> epoch;
+		char pad[64-sizeof(std::atomic<uint64_t>)];
+	};
+	struct Retired
+	{
+		uint64_t epoch;
+		std::function<void()> free;
+	};
+
+	std::vector<Slot> m_slots;
+	//starts at 1,a slot at 0 is free
+	std::atomic<uint64_t> m_epoch;
+	std::mutex m_retireLock;
+	std::vector<Retired> m_retired;
+	size_t m_retiredCount;
+	size_t m_reclaimed;
+	size_t m_maxPending;
+};
+
+//a reader's stay in a slot,for a scope
+class CEpochGuard
+{
+public:
+	explicit CEpochGuard(CEpochManager &epochs):m_epochs(epochs),m_slot(epochs.Enter()){}
+	~CEpochGuard() { m_epochs.Exit(m_slot); }
+private:
+	CEpochGuard(const CEpochGuard&);
+	CEpochGuard &operator=(const CEpochGuard&);
+
+	CEpochManager &m_epochs;
+	size_t m_slot;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CRcuCell
+// One published object. Readers inside a CEpochGuard load it without a
+// lock and may use it until the guard is gone; Publish swaps in the next
+// one and retires the old. Publishers are serialized by the caller.
+//////////////////////////////////////////////////////////////////////
+template<class T>
+class CRcuCell
+{
+public:
+	explicit CRcuCell(CEpochManager &epochs):m_epochs(epochs),m_current(nullptr){}
+	//no reader may be left
+	~CRcuCell() { delete m_current.load(); }
+
+	const T *Read() const { return m_current.load(); }
+	void Publish(T *next)
+	{
+		T *old=m_current.exchange(next);
+		if(old)
+			m_epochs.RetireObject(old);
+	}
+private:
+	CRcuCell(const CRcuCell&);
+	CRcuCell &operator=(const CRcuCell&);
+
+	CEpochManager &m_epochs;
+	std::atomic<T*> m_current;
+};
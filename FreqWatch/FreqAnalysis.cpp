@@ -0,0 +1,19 @@
+#include "FreqAnalysis.h"
+#include "../WavSink/StftEngine.h"
+
+void AnalyzeSamples(const short *pcm,size_t count,const AnalysisParams &params,std::vector<FreqInfo> &freqinfos)
+{
+	SpectrumLines dataline;
+	CStftEngine stft(params.frameSize,params.frameSize,&dataline);
+	stft.Push(pcm,count);
+	ExtractPeaks(dataline,params,freqinfos);
+}
+
+void ExtractPeaks(const SpectrumLines &dataline,const AnalysisParams &params,std::vector<FreqInfo> &freqinfos)
+{
+	SpectrumLines darklines;
+	BuildDarkLines(dataline,params.frameSize/2,darklines);
+	PickPeaks(darklines,params.frameSize/2,freqinfos);
+	InterpolatePeaks(darklines,freqinfos);
+	QuantizePeaks(freqinfos,params.FreqScale(),params.TimeScale());
+}
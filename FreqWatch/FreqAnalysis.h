@@ -0,0 +1,18 @@
+#pragma once
+#include "FreqPeaks.h"
+
+struct AnalysisParams
+{
+	//transform length,one spectrum line per frameSize samples
+	size_t frameSize;
+	//transform length whose bin/frame grid the peaks are quantized to
+	size_t gridSampleCount;
+
+	double FreqScale() const { return (double)gridSampleCount/frameSize; }
+	double TimeScale() const { return (double)frameSize/gridSampleCount; }
+};
+
+//dark lines and interpolated,quantized peaks of a whole spectrum
+void ExtractPeaks(const SpectrumLines &dataline,const AnalysisParams &params,std::vector<FreqInfo> &freqinfos);
+//batch analysis of a whole clip: spectrum,dark lines and interpolated peaks
+void AnalyzeSamples(const short *pcm,size_t count,const AnalysisParams &params,std::vector<FreqInfo> &freqinfos);
@@ -0,0 +1,256 @@
+#include "FreqPeaks.h"
+#include <math.h>
+#include <algorithm>
+
+static const int checkR=2;
+static const int area=5;
+static const double peakThreshold=0.35;
+
+//rows holds the 2*checkR spectrum lines around the output line
+static void ComputeDarkLine(const std::vector<double> *const rows[2*checkR],size_t bins,std::vector<double> &line)
+{
+	const double core1[5][5]={
+		{0,-0.5,-1,-0.5,0},
+		{-0.5,-1,-2,-1,-0.5},
+		{-1,-2,21,-2,-1},
+		{-0.5,-1,-2,-1,-0.5},
+		{0,-0.5,-1,-0.5,0}
+	};
+	line.assign(bins,0);
+	for(size_t j=checkR;j<bins-checkR;j++)
+	{
+		double gx=0;
+		for(int testi=-checkR;testi<checkR;testi++)
+		{
+			const std::vector<double> &row=*rows[testi+checkR];
+			for(int testj=-checkR;testj<checkR;testj++)
+			{
+				gx+=row[j+testj]*core1[testi+checkR][testj+checkR];
+			}
+		}
+		if(gx>0)
+			line[j]=sqrt(gx);
+	}
+}
+
+void BuildDarkLines(const SpectrumLines &dataline,size_t bins,SpectrumLines &darklines)
+{
+	darklines.clear();
+	if(dataline.size()<=2*checkR)
+		return;
+	for(size_t i=checkR;i!=dataline.size()-checkR;i++)
+	{
+		const std::vector<double> *rows[2*checkR];
+		for(int k=0;k<2*checkR;k++)
+			rows[k]=&dataline[i-checkR+k];
+		std::vector<double> line;
+		ComputeDarkLine(rows,bins,line);
+		darklines.push_back(std::move(line));
+	}
+	if(darklines.size()<3)
+		return;
+	double darkmax=0,darkmin=1e20;
+	for(size_t i=1;i!=darklines.size()-1;i++)
+	{
+		for(size_t j=1;j<bins-1;j++)
+		{
+			double v=darklines[i][j];
+			if(v>darkmax)
+				darkmax=v;
+			if(v<darkmin)
+				darkmin=v;
+		}
+	}
+	double darkspan=darkmax-darkmin;
+	if(darkspan<=0)
+		return;
+	for(size_t i=1;i!=darklines.size()-1;i++)
+	{
+		for(size_t j=1;j<bins-1;j++)
+		{
+			double &v=darklines[i][j];
+			v=(v-darkmin)/darkspan;
+		}
+	}
+}
+
+void PickPeaks(const SpectrumLines &darklines,size_t bins,std::vector<FreqInfo> &freqinfos)
+{
+	freqinfos.clear();
+	if(darklines.size()<=2*area)
+		return;
+	for(int i=area;i!=(int)darklines.size()-area;i++)
+	{
+		for(int j=area;j<(int)bins-area;j++)
+		{
+			double strong=darklines[i][j];
+			if(strong>peakThreshold)
+			{
+				for(int x=-area;x<=area;x++)
+				{
+					for(int y=-area;y<=area;y++)
+					{
+						if(!(x==0 && y==0))
+						{
+							double other=darklines[i+x][j+y];
+							if(other>strong)
+							{
+								goto NEXT;
+							}
+						}
+					}
+				}
+				FreqInfo info;
+				info.freq=j;
+				info.time=i;
+				info.strong=strong;
+				info.exact_freq=j;
+				info.exact_time=i;
+				freqinfos.push_back(info);
+NEXT:;
+			}
+		}
+	}
+}
+
+double ParabolicOffset(double left,double center,double right)
+{
+	double curve=left-2*center+right;
+	//flat or not a maximum,keep the grid position
+	if(curve>=0)
+		return 0;
+	double offset=0.5*(left-right)/curve;
+	if(offset>0.5)
+		offset=0.5;
+	else if(offset<-0.5)
+		offset=-0.5;
+	return offset;
+}
+
+void InterpolatePeaks(const SpectrumLines &darklines,std::vector<FreqInfo> &freqinfos)
+{
+	for(auto i=freqinfos.begin();i!=freqinfos.end();i++)
+	{
+		i->exact_freq=i->freq;
+		i->exact_time=i->time;
+		if(i->time<1 || i->time+1>=(int)darklines.size())
+			continue;
+		const std::vector<double> &line=darklines[i->time];
+		if(i->freq<1 || i->freq+1>=(int)line.size())
+			continue;
+		double center=line[i->freq];
+		i->exact_freq+=ParabolicOffset(line[i->freq-1],center,line[i->freq+1]);
+		i->exact_time+=ParabolicOffset(darklines[i->time-1][i->freq],center,darklines[i->time+1][i->freq]);
+	}
+}
+
+int QuantizePosition(double pos,double scale)
+{
+	return (int)floor(pos*scale+0.5);
+}
+
+void QuantizePeaks(std::vector<FreqInfo> &freqinfos,double freqScale,double timeScale)
+{
+	for(auto i=freqinfos.begin();i!=freqinfos.end();i++)
+	{
+		i->freq=QuantizePosition(i->exact_freq,freqScale);
+		i->time=QuantizePosition(i->exact_time,timeScale);
+	}
+	//rounding may swap neighbours,the anchor sweeps expect time order
+	std::stable_sort(freqinfos.begin(),freqinfos.end(),[](const FreqInfo &a,const FreqInfo &b)
+	{
+		return a.time<b.time || (a.time==b.time && a.freq<b.freq);
+	});
+}
+
+CStreamPeakPicker::CStreamPeakPicker(size_t bins,double freqScale,double timeScale)
+	:m_bins(bins),m_freqScale(freqScale),m_timeScale(timeScale)
+{
+	Reset();
+}
+
+void CStreamPeakPicker::Reset()
+{
+	m_lines.clear();
+	m_dark.clear();
+	m_darkBase=0;
+	m_darkCount=0;
+	m_darkMax=0;
+	m_darkMin=1e20;
+}
+
+void CStreamPeakPicker::PushLine(const std::vector<double> &line,std::vector<FreqInfo> &peaks)
+{
+	m_lines.push_back(line);
+	if(m_lines.size()<2*checkR)
+		return;
+	const std::vector<double> *rows[2*checkR];
+	for(int k=0;k<2*checkR;k++)
+		rows[k]=&m_lines[k];
+	std::vector<double> dark;
+	ComputeDarkLine(rows,m_bins,dark);
+	m_lines.pop_front();
+
+	for(size_t j=1;j+1<m_bins;j++)
+	{
+		if(dark[j]>m_darkMax)
+			m_darkMax=dark[j];
+		if(dark[j]<m_darkMin)
+			m_darkMin=dark[j];
+	}
+	m_dark.push_back(std::move(dark));
+	m_darkCount++;
+	if(m_dark.size()>2*area+1)
+	{
+		m_dark.pop_front();
+		m_darkBase++;
+	}
+	//the row whose whole neighbourhood just became known
+	if(m_darkCount>2*area)
+	{
+		size_t first=peaks.size();
+		PickRow(m_darkCount-1-area,peaks);
+		std::sort(peaks.begin()+first,peaks.end(),[](const FreqInfo &a,const FreqInfo &b)
+		{
+			return a.time<b.time || (a.time==b.time && a.freq<b.freq);
+		});
+	}
+}
+
+void CStreamPeakPicker::PickRow(size_t row,std::vector<FreqInfo> &peaks)
+{
+	double span=m_darkMax-m_darkMin;
+	if(span<=0)
+		return;
+	int i=(int)(row-m_darkBase);
+	const std::vector<double> &line=m_dark[i];
+	for(int j=area;j<(int)m_bins-area;j++)
+	{
+		double raw=line[j];
+		double strong=(raw-m_darkMin)/span;
+		if(strong<=peakThreshold)
+			continue;
+		bool isPeak=true;
+		for(int x=-area;x<=area && isPeak;x++)
+		{
+			const std::vector<double> &other=m_dark[i+x];
+			for(int y=-area;y<=area;y++)
+			{
+				if(!(x==0 && y==0) && other[j+y]>raw)
+				{
+					isPeak=false;
+					break;
+				}
+			}
+		}
+		if(!isPeak)
+			continue;
+		FreqInfo info;
+		info.strong=strong;
+		info.exact_freq=j+ParabolicOffset(line[j-1],raw,line[j+1]);
+		info.exact_time=row+ParabolicOffset(m_dark[i-1][j],raw,m_dark[i+1][j]);
+		info.freq=QuantizePosition(info.exact_freq,m_freqScale);
+		info.time=QuantizePosition(info.exact_time,m_timeScale);
+		peaks.push_back(info);
+	}
+}
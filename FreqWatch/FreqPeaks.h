@@ -0,0 +1,60 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include <deque>
+
+struct FreqInfo
+{
+	int freq;
+	int time;
+	double strong;
+	//peak position refined between grid cells, in bins and frames of the analysed spectrum
+	double exact_freq;
+	double exact_time;
+};
+typedef std::vector<std::vector<double>> SpectrumLines;
+
+//edge-enhanced and normalized spectrum used for peak picking
+void BuildDarkLines(const SpectrumLines &dataline,size_t bins,SpectrumLines &darklines);
+//local maxima of darklines,ordered by time then freq
+void PickPeaks(const SpectrumLines &darklines,size_t bins,std::vector<FreqInfo> &freqinfos);
+
+//vertex of the parabola through three samples,relative to the middle one (-0.5..0.5)
+double ParabolicOffset(double left,double center,double right);
+//fill exact_freq/exact_time of every peak by fitting a parabola along each axis
+void InterpolatePeaks(const SpectrumLines &darklines,std::vector<FreqInfo> &freqinfos);
+
+int QuantizePosition(double pos,double scale);
+//rewrite freq/time as exact positions scaled onto the grid used for hashing
+void QuantizePeaks(std::vector<FreqInfo> &freqinfos,double freqScale,double timeScale);
+
+//////////////////////////////////////////////////////////////////////
+// CStreamPeakPicker
+// Incremental BuildDarkLines/PickPeaks/InterpolatePeaks/QuantizePeaks
+// for spectra arriving one line at a time. A peak is emitted once the
+// lines around it are known, about seven lines after it was captured.
+// The whole spectrum is not known yet, so strength is normalized by
+// the range seen so far instead of the global one.
+//////////////////////////////////////////////////////////////////////
+class CStreamPeakPicker
+{
+public:
+	CStreamPeakPicker(size_t bins,double freqScale,double timeScale);
+
+	//appends the peaks completed by this line,in time order
+	void PushLine(const std::vector<double> &line,std::vector<FreqInfo> &peaks);
+	void Reset();
+private:
+	void PickRow(size_t row,std::vector<FreqInfo> &peaks);
+
+	size_t m_bins;
+	double m_freqScale;
+	double m_timeScale;
+	std::deque<std::vector<double> > m_lines;
+	std::deque<std::vector<double> > m_dark;
+	//index of m_dark.front() among all dark lines
+	size_t m_darkBase;
+	size_t m_darkCount;
+	double m_darkMax;
+	double m_darkMin;
+};
@@ -5,6 +5,9 @@
 #pragma once
 #include "DIBBitmap.h"
 static const size_t SampleCount=8192;
+//peaks are hashed on the grid of an 8192 point transform whatever SampleCount is,
+//so a smaller transform plus interpolation still matches the stored fingerprints
+static const size_t HashGridSampleCount=8192;
 const int WM_CLIENTMOUSEMOVE=WM_USER+1;
 
 class CFreqWatchView : public CScrollWindowImpl<CFreqWatchView>
@@ -44,10 +47,12 @@ public:
 		auto end=freqinfos->end();
 		for(auto i=freqinfos->begin();i!=end;i++)
 		{
-			dc.MoveTo(i->freq-3,i->time-3);
-			dc.LineTo(i->freq+3,i->time+3);
-			dc.MoveTo(i->freq-3,i->time+3);
-			dc.LineTo(i->freq+3,i->time-3);
+			int x=(int)(i->exact_freq+0.5);
+			int y=(int)(i->exact_time+0.5);
+			dc.MoveTo(x-3,y-3);
+			dc.LineTo(x+3,y+3);
+			dc.MoveTo(x-3,y+3);
+			dc.LineTo(x+3,y-3);
 		}
 
 		CPen linepen;
@@ -0,0 +1,92 @@
+#include "HashIndex.h"
+#include <algorithm>
+
+void GenerateHashes(const std::vector<FreqInfo> &freqinfos,size_t maxFanout,std::vector<FingerprintHash> &hashes)
+{
+	hashes.clear();
+	std::vector<const FreqInfo*> use;
+	use.reserve(freqinfos.size());
+	for(auto i=freqinfos.begin();i!=freqinfos.end();++i)
+	{
+		if(i->freq>StoreMinFreq && i->freq<StoreMaxFreq)
+			use.push_back(&*i);
+	}
+	//the zone of an anchor starts after AnchorMinTimeOffset,so the first
+	//candidate target only moves forward as the anchors do
+	size_t zoneStart=0;
+	for(size_t i=0;i<use.size();i++)
+	{
+		const FreqInfo &anchor=*use[i];
+		if(zoneStart<=i)
+			zoneStart=i+1;
+		while(zoneStart<use.size() && use[zoneStart]->time<=anchor.time+AnchorMinTimeOffset)
+			zoneStart++;
+		size_t fanout=0;
+		for(size_t j=zoneStart;j<use.size();j++)
+		{
+			const FreqInfo &target=*use[j];
+			if(target.time>anchor.time+AnchorMaxTimeOffset)
+				break;
+			if(!InTargetZone(anchor,target))
+				continue;
+			FingerprintHash hash;
+			hash.key=PackHashKey(anchor.freq,target.freq,target.time-anchor.time);
+			hash.time=anchor.time;
+			hashes.push_back(hash);
+			if(maxFanout && ++fanout>=maxFanout)
+				break;
+		}
+	}
+	std::sort(hashes.begin(),hashes.end(),[](const FingerprintHash &a,const FingerprintHash &b)
+	{
+		return a.key<b.key || (a.key==b.key && a.time<b.time);
+	});
+}
+
+void MatchHashes(const std::vector<FingerprintHash> &query,IHashSource &source,std::vector<MatchVote> &votes)
+{
+	votes.clear();
+	for(size_t i=0;i<query.size();)
+	{
+		//query hashes are sorted,so every distinct key is looked up once
+		size_t end=i+1;
+		while(end<query.size() && query[end].key==query[i].key)
+			end++;
+		const HashPosting *postings=nullptr;
+		size_t count=source.FindHash(query[i].key,&postings);
+		for(size_t q=i;q<end;q++)
+		{
+			for(size_t p=0;p<count;p++)
+			{
+				MatchVote vote;
+				vote.song_id=postings[p].song_id;
+				vote.offset=postings[p].time-query[q].time;
+				votes.push_back(vote);
+			}
+		}
+		i=end;
+	}
+}
+
+void CHashTable::AddSong(int song_id,const std::vector<FingerprintHash> &hashes)
+{
+	for(auto i=hashes.begin();i!=hashes.end();++i)
+	{
+		HashPosting posting;
+		posting.song_id=song_id;
+		posting.time=i->time;
+		m_postings[i->key].push_back(posting);
+	}
+}
+
+size_t CHashTable::FindHash(uint32_t key,const HashPosting **postings)
+{
+	auto found=m_postings.find(key);
+	if(found==m_postings.end() || found->second.empty())
+	{
+		*postings=nullptr;
+		return 0;
+	}
+	*postings=&found->second[0];
+	return found->second.size();
+}
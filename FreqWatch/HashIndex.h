@@ -0,0 +1,73 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include "AnchorIndex.h"
+#include "VoteEngine.h"
+
+//key layout: anchor freq 12 bits | target freq 12 bits | delta time 8 bits
+const int HashFreqBits=12;
+const int HashTimeBits=8;
+//targets paired with one anchor,the earliest ones in the zone win
+const size_t HashMaxFanout=8;
+
+inline uint32_t PackHashKey(int anchorFreq,int targetFreq,int dt)
+{
+	const uint32_t freqMask=(1u<<HashFreqBits)-1;
+	const uint32_t timeMask=(1u<<HashTimeBits)-1;
+	return (((uint32_t)anchorFreq&freqMask)<<(HashFreqBits+HashTimeBits))|
+		(((uint32_t)targetFreq&freqMask)<<HashTimeBits)|
+		((uint32_t)dt&timeMask);
+}
+
+inline void UnpackHashKey(uint32_t key,int &anchorFreq,int &targetFreq,int &dt)
+{
+	anchorFreq=(int)(key>>(HashFreqBits+HashTimeBits));
+	targetFreq=(int)((key>>HashTimeBits)&((1u<<HashFreqBits)-1));
+	dt=(int)(key&((1u<<HashTimeBits)-1));
+}
+
+struct FingerprintHash
+{
+	uint32_t key;
+	//anchor time
+	int time;
+};
+
+struct HashPosting
+{
+	int song_id;
+	int time;
+};
+
+//anchor/target pairs of a peak list sorted by time,using the anchor target zone
+//and the StoreMinFreq..StoreMaxFreq band; the result is sorted by key then time
+void GenerateHashes(const std::vector<FreqInfo> &freqinfos,size_t maxFanout,std::vector<FingerprintHash> &hashes);
+
+class IHashSource
+{
+public:
+	virtual ~IHashSource(){}
+	//postings stored under key; the array stays valid until the next call
+	virtual size_t FindHash(uint32_t key,const HashPosting **postings)=0;
+};
+
+//one vote per posting of every query key,offset is stored time minus query time
+void MatchHashes(const std::vector<FingerprintHash> &query,IHashSource &source,std::vector<MatchVote> &votes);
+
+//////////////////////////////////////////////////////////////////////
+// CHashTable
+// Hash postings held in memory,for replay runs without a database.
+//////////////////////////////////////////////////////////////////////
+class CHashTable:public IHashSource
+{
+public:
+	typedef std::map<uint32_t,std::vector<HashPosting> > PostingMap;
+
+	void AddSong(int song_id,const std::vector<FingerprintHash> &hashes);
+	size_t FindHash(uint32_t key,const HashPosting **postings);
+	const PostingMap &Postings() const { return m_postings; }
+private:
+	PostingMap m_postings;
+};
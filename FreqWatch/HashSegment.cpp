@@ -0,0 +1,206 @@
+#include "HashSegment.h"
+#include "PostingCodec.h"
+#include <algorithm>
+#include <string.h>
+
+static uint64_t AlignSegment(uint64_t offset)
+{
+	return (offset+7)&~(uint64_t)7;
+}
+
+void CHashSegmentBuilder::AddSong(int song_id,const std::vector<FreqInfo> &freqinfos)
+{
+	std::vector<FingerprintHash> hashes;
+	GenerateHashes(freqinfos,HashMaxFanout,hashes);
+	AddHashes(song_id,hashes);
+}
+
+void CHashSegmentBuilder::AddHashes(int song_id,const std::vector<FingerprintHash> &hashes)
+{
+	for(auto i=hashes.begin();i!=hashes.end();++i)
+		AddPosting(i->key,song_id,i->time);
+}
+
+void CHashSegmentBuilder::AddPosting(uint32_t key,int song_id,int time)
+{
+	Entry entry;
+	entry.key=key;
+	entry.posting.song_id=song_id;
+	entry.posting.time=time;
+	m_entries.push_back(entry);
+}
+
+void CHashSegmentBuilder::Clear()
+{
+	std::vector<Entry>().swap(m_entries);
+}
+
+void CHashSegmentBuilder::Build(std::vector<uint8_t> &image,bool packed)
+{
+	std::sort(m_entries.begin(),m_entries.end(),[](const Entry &a,const Entry &b)
+	{
+		if(a.key!=b.key)
+			return a.key<b.key;
+		if(a.posting.song_id!=b.posting.song_id)
+			return a.posting.song_id<b.posting.song_id;
+		return a.posting.time<b.posting.time;
+	});
+	size_t keyCount=0;
+	for(size_t i=0;i<m_entries.size();i++)
+	{
+		if(!i || m_entries[i].key!=m_entries[i-1].key)
+			keyCount++;
+	}
+	//packed lists are encoded first,their size fixes the layout
+	std::vector<uint8_t> lists;
+	std::vector<uint32_t> listStarts;
+	if(packed)
+	{
+		std::vector<HashPosting> postings;
+		for(size_t i=0;i<m_entries.size();)
+		{
+			size_t end=i+1;
+			while(end<m_entries.size() && m_entries[end].key==m_entries[i].key)
+				end++;
+			postings.clear();
+			for(size_t p=i;p<end;p++)
+				postings.push_back(m_entries[p].posting);
+			listStarts.push_back((uint32_t)lists.size());
+			EncodePostings(&postings[0],postings.size(),lists);
+			i=end;
+		}
+		listStarts.push_back((uint32_t)lists.size());
+	}
+
+	HashSegmentHeader header;
+	memset(&header,0,sizeof(header));
+	header.magic=HashSegmentMagic;
+	header.version=packed?HashSegmentPackedVersion:HashSegmentVersion;
+	header.keyCount=(uint32_t)keyCount;
+	header.postingCount=(uint32_t)m_entries.size();
+	header.bucketsOffset=AlignSegment(sizeof(header));
+	header.keysOffset=AlignSegment(header.bucketsOffset+(HashSegmentBuckets+1)*sizeof(uint32_t));
+	header.startsOffset=AlignSegment(header.keysOffset+keyCount*sizeof(uint32_t));
+	header.postingsOffset=AlignSegment(header.startsOffset+(keyCount+1)*sizeof(uint32_t));
+	header.size=header.postingsOffset+(packed?lists.size():m_entries.size()*sizeof(HashPosting));
+
+	image.assign((size_t)header.size,0);
+	memcpy(&image[0],&header,sizeof(header));
+	uint32_t *buckets=(uint32_t*)&image[(size_t)header.bucketsOffset];
+	uint32_t *keys=(uint32_t*)&image[(size_t)header.keysOffset];
+	uint32_t *starts=(uint32_t*)&image[(size_t)header.startsOffset];
+	HashPosting *postings=m_entries.empty() || packed?nullptr:(HashPosting*)&image[(size_t)header.postingsOffset];
+	size_t k=0;
+	for(size_t i=0;i<m_entries.size();i++)
+	{
+		if(!i || m_entries[i].key!=m_entries[i-1].key)
+		{
+			keys[k]=m_entries[i].key;
+			starts[k]=packed?listStarts[k]:(uint32_t)i;
+			//buckets[b] counts the keys below bucket b until the prefix pass
+			buckets[(m_entries[i].key>>HashSegmentBucketShift)+1]++;
+			k++;
+		}
+		if(!packed)
+			postings[i]=m_entries[i].posting;
+	}
+	starts[keyCount]=packed?listStarts[keyCount]:(uint32_t)m_entries.size();
+	if(packed && !lists.empty())
+		memcpy(&image[(size_t)header.postingsOffset],&lists[0],lists.size());
+	for(uint32_t b=1;b<=HashSegmentBuckets;b++)
+		buckets[b]+=buckets[b-1];
+}
+
+CHashSegment::CHashSegment()
+{
+	Detach();
+}
+
+void CHashSegment::Detach()
+{
+	m_buckets=nullptr;
+	m_keys=nullptr;
+	m_starts=nullptr;
+	m_postings=nullptr;
+	m_packedPostings=nullptr;
+	m_keyCount=0;
+	m_postingCount=0;
+	m_packed=false;
+}
+
+bool CHashSegment::Attach(const void *data,size_t size)
+{
+	Detach();
+	if(size<sizeof(HashSegmentHeader))
+		return false;
+	const uint8_t *base=(const uint8_t*)data;
+	const HashSegmentHeader *header=(const HashSegmentHeader*)base;
+	bool packed=header->version==HashSegmentPackedVersion;
+	if(header->magic!=HashSegmentMagic || (header->version!=HashSegmentVersion && !packed) || header->size>size ||
+		header->postingsOffset>header->size)
+		return false;
+	uint64_t keys=header->keyCount;
+	uint64_t postingBytes=packed?header->size-header->postingsOffset:(uint64_t)header->postingCount*sizeof(HashPosting);
+	if(header->bucketsOffset+(HashSegmentBuckets+1)*sizeof(uint32_t)>header->keysOffset ||
+		header->keysOffset+keys*sizeof(uint32_t)>header->startsOffset ||
+		header->startsOffset+(keys+1)*sizeof(uint32_t)>header->postingsOffset ||
+		header->postingsOffset+postingBytes>header->size)
+		return false;
+	//lookups index with these without further checks
+	const uint32_t *buckets=(const uint32_t*)(base+header->bucketsOffset);
+	const uint32_t *starts=(const uint32_t*)(base+header->startsOffset);
+	if(buckets[0] || buckets[HashSegmentBuckets]!=header->keyCount ||
+		starts[0] || starts[keys]!=(packed?postingBytes:header->postingCount))
+		return false;
+	for(uint32_t b=0;b<HashSegmentBuckets;b++)
+	{
+		if(buckets[b]>buckets[b+1])
+			return false;
+	}
+	//ascending from 0 to the posting count or bytes keeps every list inside
+	for(uint64_t k=0;k<keys;k++)
+	{
+		if(starts[k]>starts[k+1])
+			return false;
+	}
+	m_buckets=buckets;
+	m_starts=starts;
+	if(packed)
+		m_packedPostings=base+header->postingsOffset;
+	else
+		m_postings=(const HashPosting*)(base+header->postingsOffset);
+	m_packed=packed;
+	m_keys=(const uint32_t*)(base+header->keysOffset);
+	m_keyCount=header->keyCount;
+	m_postingCount=header->postingCount;
+	return true;
+}
+
+size_t CHashSegment::FindHash(uint32_t key,const HashPosting **postings)
+{
+	*postings=nullptr;
+	uint32_t bucket=key>>HashSegmentBucketShift;
+	if(!m_keys || bucket>=HashSegmentBuckets)
+		return 0;
+	const uint32_t *end=m_keys+m_buckets[bucket+1];
+	const uint32_t *found=std::lower_bound(m_keys+m_buckets[bucket],end,key);
+	if(found==end || *found!=key)
+		return 0;
+	return KeyPostings(found-m_keys,postings);
+}
+
+size_t CHashSegment::KeyPostings(size_t k,const HashPosting **postings)
+{
+	*postings=nullptr;
+	if(k>=m_keyCount)
+		return 0;
+	if(m_packed)
+	{
+		if(!DecodePostings(m_packedPostings+m_starts[k],m_starts[k+1]-m_starts[k],m_decoded) || m_decoded.empty())
+			return 0;
+		*postings=&m_decoded[0];
+		return m_decoded.size();
+	}
+	*postings=m_postings+m_starts[k];
+	return m_starts[k+1]-m_starts[k];
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "HashIndex.h"
+
+//Hash segment: an immutable file of hash postings laid out so it can be used
+//straight from a mapped view. All offsets are bytes from the segment start
+//and 8 byte aligned; the arrays are
+//  buckets  uint32_t[HashSegmentBuckets+1]  first key of each anchor freq
+//  keys     uint32_t[keyCount]              ascending
+//  starts   uint32_t[keyCount+1]            first posting of each key
+//  postings HashPosting[postingCount]       by key,then song_id and time
+//A packed segment (HashSegmentPackedVersion) keeps each key's postings as an
+//EncodePostings list instead; starts then holds byte offsets into the
+//postings section, which stays below 4GB.
+const uint32_t HashSegmentMagic=0x53485746;	//"FWHS"
+const uint32_t HashSegmentVersion=1;
+const uint32_t HashSegmentPackedVersion=2;
+//keys are bucketed by their anchor freq bits
+const int HashSegmentBucketShift=HashFreqBits+HashTimeBits;
+const uint32_t HashSegmentBuckets=1u<<HashFreqBits;
+
+struct HashSegmentHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t keyCount;
+	uint32_t postingCount;
+	uint64_t bucketsOffset;
+	uint64_t keysOffset;
+	uint64_t startsOffset;
+	uint64_t postingsOffset;
+	uint64_t size;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CHashSegmentBuilder
+// Collects postings in any order and lays them out as a segment image.
+//////////////////////////////////////////////////////////////////////
+class CHashSegmentBuilder
+{
+public:
+	//hashes of an analysed peak list,as GenerateHashes makes them at ingest
+	void AddSong(int song_id,const std::vector<FreqInfo> &freqinfos);
+	void AddHashes(int song_id,const std::vector<FingerprintHash> &hashes);
+	void AddPosting(uint32_t key,int song_id,int time);
+	size_t PostingCount() const { return m_entries.size(); }
+	//image is replaced by the whole segment; the postings are kept
+	void Build(std::vector<uint8_t> &image,bool packed=false);
+	void Clear();
+private:
+	struct Entry
+	{
+		uint32_t key;
+		HashPosting posting;
+	};
+	std::vector<Entry> m_entries;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CHashSegment
+// Reads a segment image in place: Attach checks the header,the array
+// bounds and that the buckets and starts ascend within them, lookups are
+// a bucket step and a binary search over that bucket's keys. The memory must outlive the segment. Packed lists are
+// decoded into a buffer of the segment on each FindHash.
+//////////////////////////////////////////////////////////////////////
+class CHashSegment:public IHashSource
+{
+public:
+	CHashSegment();
+
+	//false if data is not a segment of this version or is cut short
+	bool Attach(const void *data,size_t size);
+	void Detach();
+	bool IsAttached() const { return m_keys!=nullptr; }
+	bool IsPacked() const { return m_packed; }
+	size_t KeyCount() const { return m_keyCount; }
+	size_t PostingCount() const { return m_postingCount; }
+
+	size_t FindHash(uint32_t key,const HashPosting **postings);
+	//keys in ascending order with their postings,for walking a whole segment
+	uint32_t Key(size_t k) const { return m_keys[k]; }
+	size_t KeyPostings(size_t k,const HashPosting **postings);
+private:
+	const uint32_t *m_buckets;
+	const uint32_t *m_keys;
+	const uint32_t *m_starts;
+	const HashPosting *m_postings;
+	const uint8_t *m_packedPostings;
+	size_t m_keyCount;
+	size_t m_postingCount;
+	bool m_packed;
+	std::vector<HashPosting> m_decoded;
+};
@@ -0,0 +1,169 @@
+#include "IngestPipeline.h"
+#include <chrono>
+#include <string.h>
+#include "HashIndex.h"
+#include "../WavSink/StftEngine.h"
+
+CIngestPipeline::CIngestPipeline(size_t threads):m_pool(threads),m_stages(nullptr),m_finished(0),m_dropped(0)
+{
+}
+
+void CIngestPipeline::Run(size_t files,const std::vector<Stage> &stages,const Writer &write,IngestPipelineStats &stats)
+{
+	memset(&stats,0,sizeof(stats));
+	stats.files=files;
+	if(!files || stages.empty())
+		return;
+	auto start=std::chrono::steady_clock::now();
+	size_t steals=m_pool.Steals();
+	m_stages=&stages;
+	m_finished=0;
+	m_dropped=0;
+	//dealt round the threads last first,so each runs its share in list
+	//order and thieves take from the end of the list
+	for(size_t i=files;i--;)
+	{
+		IngestItem *item=new IngestItem;
+		item->index=i;
+		m_pool.Push(i,[this,item](size_t slot)
+		{
+			RunStage(slot,item,0);
+		});
+	}
+
+	IngestBatch batch;
+	std::unique_lock<std::mutex> lock(m_lock);
+	for(;;)
+	{
+		m_ready.wait(lock,[this,files]()
+		{
+			return !m_done.empty() || m_finished==files;
+		});
+		if(m_done.empty())
+			break;
+		batch.swap(m_done);
+		lock.unlock();
+		stats.batches++;
+		stats.written+=batch.size();
+		if(batch.size()>stats.maxBatch)
+			stats.maxBatch=batch.size();
+		auto writeStart=std::chrono::steady_clock::now();
+		write(batch);
+		stats.writeSeconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-writeStart).count();
+		batch.clear();
+		lock.lock();
+	}
+	stats.dropped=m_dropped;
+	lock.unlock();
+	//the last tasks may still be returning
+	m_pool.Wait();
+	m_stages=nullptr;
+	stats.steals=m_pool.Steals()-steals;
+	stats.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+void CIngestPipeline::RunStage(size_t slot,IngestItem *item,size_t stage)
+{
+	if(!(*m_stages)[stage](*item))
+	{
+		delete item;
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_dropped++;
+		m_finished++;
+		m_ready.notify_one();
+		return;
+	}
+	if(stage+1<m_stages->size())
+	{
+		m_pool.Push(slot,[this,item,stage](size_t next)
+		{
+			RunStage(next,item,stage+1);
+		});
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_done.push_back(std::unique_ptr<IngestItem>(item));
+	m_finished++;
+	m_ready.notify_one();
+}
+
+void WavIngestStages(const std::vector<std::string> &files,const AnalysisParams &params,
+	std::vector<CIngestPipeline::Stage> &stages)
+{
+	stages.clear();
+	stages.push_back([&files](IngestItem &item)
+	{
+		return ReadWavFile(files[item.index].c_str(),item.wav) && !item.wav.samples.empty();
+	});
+	stages.push_back([params](IngestItem &item)
+	{
+		CStftEngine stft(params.frameSize,params.frameSize,&item.dataline);
+		stft.Push(&item.wav.samples[0],item.wav.samples.size());
+		std::vector<short>().swap(item.wav.samples);
+		return !item.dataline.empty();
+	});
+	stages.push_back([params](IngestItem &item)
+	{
+		ExtractPeaks(item.dataline,params,item.freqinfos);
+		SpectrumLines().swap(item.dataline);
+		return true;
+	});
+}
+
+static void AddToTable(CHashTable &table,const IngestItem &item)
+{
+	std::vector<FingerprintHash> hashes;
+	GenerateHashes(item.freqinfos,HashMaxFanout,hashes);
+	table.AddSong((int)item.index+1,hashes);
+}
+
+void BenchIngestPipeline(const std::vector<std::string> &files,const std::vector<size_t> &threads,
+	const AnalysisParams &params,std::vector<IngestBenchRun> &runs)
+{
+	runs.clear();
+	std::vector<CIngestPipeline::Stage> stages;
+	WavIngestStages(files,params,stages);
+
+	for(size_t r=0;r<=threads.size();r++)
+	{
+		IngestBenchRun run;
+		memset(&run,0,sizeof(run));
+		run.threads=r?threads[r-1]:0;
+		CHashTable table;
+		auto start=std::chrono::steady_clock::now();
+		if(!r)
+		{
+			for(size_t i=0;i<files.size();i++)
+			{
+				IngestItem item;
+				item.index=i;
+				bool kept=true;
+				for(auto s=stages.begin();s!=stages.end() && kept;++s)
+					kept=(*s)(item);
+				if(!kept)
+					continue;
+				AddToTable(table,item);
+				run.files++;
+			}
+		}
+		else
+		{
+			CIngestPipeline pipeline(run.threads);
+			IngestPipelineStats stats;
+			pipeline.Run(files.size(),stages,[&table](IngestBatch &batch)
+			{
+				for(auto i=batch.begin();i!=batch.end();++i)
+					AddToTable(table,**i);
+			},stats);
+			run.files=stats.written;
+			run.steals=stats.steals;
+			run.batches=stats.batches;
+		}
+		run.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+		run.filesPerMinute=run.seconds>0?run.files*60/run.seconds:0;
+		const CHashTable::PostingMap &postings=table.Postings();
+		for(auto i=postings.begin();i!=postings.end();++i)
+			run.postings+=i->second.size();
+		runs.push_back(run);
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "FreqAnalysis.h"
+#include "WavFileSource.h"
+#include "WorkStealingPool.h"
+
+//a file on its way through the pipeline
+struct IngestItem
+{
+	IngestItem():index(0),contentHash(0),cached(false) {}
+
+	//position in the file list; the stages look the file up by it
+	size_t index;
+	//0 until hashed
+	uint64_t contentHash;
+	//freqinfos came from an analysis cache; the stages after it pass the file on
+	bool cached;
+	//handed from one stage to the next; a stage frees what it used up
+	WavData wav;
+	SpectrumLines dataline;
+	std::vector<FreqInfo> freqinfos;
+};
+typedef std::vector<std::unique_ptr<IngestItem> > IngestBatch;
+
+struct IngestPipelineStats
+{
+	size_t files;
+	size_t written;
+	//files a stage gave up on
+	size_t dropped;
+	size_t batches;
+	size_t maxBatch;
+	size_t steals;
+	double seconds;
+	//of seconds,the time spent in the writer
+	double writeSeconds;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CIngestPipeline
+// Files run through a list of stages (decode,spectrum,peaks) on a
+// CWorkStealingPool: a file's next stage is pushed to the thread that
+// ran the last one,and threads that run out of files steal from the
+// others,so one long track doesn't hold the rest up. Files that come
+// out of the last stage are handed in batches,in the order they finish,
+// to a single writer on the calling thread; it takes whatever finished
+// while it wrote the last batch.
+// Stages run on several files at once and must not share state. Items
+// only carry their index,so the pipeline does not care how the caller
+// names its files.
+//////////////////////////////////////////////////////////////////////
+class CIngestPipeline
+{
+public:
+	//false drops the file
+	typedef std::function<bool(IngestItem &item)> Stage;
+	typedef std::function<void(IngestBatch &batch)> Writer;
+
+	//0 uses every core
+	explicit CIngestPipeline(size_t threads=0);
+
+	size_t Threads() const { return m_pool.Threads(); }
+	//items 0 to files-1 through the stages
+	void Run(size_t files,const std::vector<Stage> &stages,const Writer &write,IngestPipelineStats &stats);
+private:
+	void RunStage(size_t slot,IngestItem *item,size_t stage);
+	void Finish(IngestItem *item);
+
+	CWorkStealingPool m_pool;
+	const std::vector<Stage> *m_stages;
+	std::mutex m_lock;
+	std::condition_variable m_ready;
+	IngestBatch m_done;
+	size_t m_finished;
+	size_t m_dropped;
+};
+
+//the stages of files[item.index],a wav file: ReadWavFile,the spectrum and
+//ExtractPeaks; files must outlive the run
+void WavIngestStages(const std::vector<std::string> &files,const AnalysisParams &params,
+	std::vector<CIngestPipeline::Stage> &stages);
+
+//////////////////////////////////////////////////////////////////////
+// BenchIngestPipeline
+// The wav files ingested into a fresh CHashTable,once one file at a time
+// on the calling thread as OnRunFolder used to,then through the pipeline
+// with each thread count. Song ids follow the file list,so every run
+// must end up with the same postings. The table stands in for the
+// database and the live index,so the runs time decoding and analysis,
+// not disk writes.
+//////////////////////////////////////////////////////////////////////
+struct IngestBenchRun
+{
+	//0 for the run without the pipeline
+	size_t threads;
+	size_t files;
+	double seconds;
+	double filesPerMinute;
+	size_t steals;
+	size_t batches;
+	uint64_t postings;
+};
+void BenchIngestPipeline(const std::vector<std::string> &files,const std::vector<size_t> &threads,
+	const AnalysisParams &params,std::vector<IngestBenchRun> &runs);
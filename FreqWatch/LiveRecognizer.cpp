@@ -0,0 +1,157 @@
+#include "LiveRecognizer.h"
+#include "../WavSink/StftEngine.h"
+#include <chrono>
+
+CLiveRecognizer::CLiveRecognizer(IAnchorSource *source,int minScore):m_source(source),m_minScore(minScore)
+{
+	Reset();
+}
+
+void CLiveRecognizer::Reset()
+{
+	m_pending.clear();
+	m_votes.clear();
+	m_anchorsChecked=0;
+	m_voteCount=0;
+	m_matched=false;
+	m_match.song_id=0;
+	m_match.offset=0;
+	m_match.score=0;
+	m_match.query_time=0;
+}
+
+bool CLiveRecognizer::AddPeak(const FreqInfo &peak)
+{
+	if(peak.freq<=QueryMinFreq || peak.freq>=QueryMaxFreq)
+		return false;
+	bool wasMatched=m_matched;
+	while(!m_pending.empty() && m_pending.front().peak.time+AnchorMaxTimeOffset<peak.time)
+		m_pending.pop_front();
+
+	//the new peak as a target of every earlier query anchor it falls behind
+	for(auto i=m_pending.begin();i!=m_pending.end();++i)
+	{
+		if(!InTargetZone(i->peak,peak))
+			continue;
+		int time_offset=peak.time-i->peak.time;
+		for(auto c=i->candidates.begin();c!=i->candidates.end();++c)
+		{
+			int before=c->matches;
+			c->matches+=CountCheckMatches(c->checks,c->checkCount,peak.freq,time_offset);
+			if(before<AnchorMinMatches && c->matches>=AnchorMinMatches)
+				Vote(c->anchor.song_id,c->anchor.time-i->peak.time,peak.time);
+		}
+	}
+
+	//and as an anchor for the peaks still to come
+	PendingAnchor pending;
+	pending.peak=peak;
+	const AnchorRef *anchors=nullptr;
+	size_t count=m_source->FindAnchors(peak.freq,&anchors);
+	pending.candidates.reserve(count);
+	for(size_t i=0;i<count;i++)
+	{
+		Candidate c;
+		c.anchor=anchors[i];
+		c.matches=0;
+		c.checkCount=m_source->GetChecks(anchors[i],&c.checks);
+		pending.candidates.push_back(c);
+	}
+	m_anchorsChecked+=count;
+	m_pending.push_back(std::move(pending));
+	return m_matched && !wasMatched;
+}
+
+void CLiveRecognizer::Vote(int song_id,int offset,int query_time)
+{
+	m_voteCount++;
+	m_votes[((long long)song_id<<32)|(unsigned int)offset]++;
+	if(m_matched)
+		return;
+	int score=WindowScore(song_id,offset);
+	if(score>=m_minScore)
+	{
+		m_matched=true;
+		m_match.song_id=song_id;
+		m_match.offset=offset;
+		m_match.score=score;
+		m_match.query_time=query_time;
+	}
+}
+
+int CLiveRecognizer::WindowScore(int song_id,int offset) const
+{
+	int score=0;
+	for(int fr=offset-3;fr<=offset+3;fr++)
+	{
+		auto found=m_votes.find(((long long)song_id<<32)|(unsigned int)fr);
+		if(found!=m_votes.end())
+			score+=found->second;
+	}
+	return score;
+}
+
+void ReplayLiveRecognition(const WavData &wav,IAnchorSource &source,const AnalysisParams &params,
+	int minScore,double speed,ReplayResult &result)
+{
+	SpectrumLines lines;
+	CStftEngine stft(params.frameSize,params.frameSize,&lines);
+	CStreamPeakPicker picker(params.frameSize/2,params.FreqScale(),params.TimeScale());
+	CLiveRecognizer recognizer(&source,minScore);
+	std::vector<FreqInfo> peaks;
+	size_t peakCount=0;
+	size_t pushedSamples=0;
+	size_t matchedSamples=0;
+	std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point matchedAt=start;
+	std::atomic<bool> matched(false);
+
+	size_t bufferSamples=params.frameSize/4;
+	//without pacing the whole file may be queued before the worker runs
+	size_t ringSamples=speed>0?bufferSamples*16:wav.samples.size()+bufferSamples;
+	CCaptureWorker worker(ringSamples,bufferSamples,[&](const short *pcm,size_t count)
+	{
+		stft.Push(pcm,count);
+		pushedSamples+=count;
+		for(auto line=lines.begin();line!=lines.end();++line)
+		{
+			peaks.clear();
+			picker.PushLine(*line,peaks);
+			peakCount+=peaks.size();
+			for(auto p=peaks.begin();p!=peaks.end();++p)
+			{
+				if(recognizer.AddPeak(*p))
+				{
+					matchedAt=std::chrono::steady_clock::now();
+					matchedSamples=pushedSamples;
+					matched=true;
+				}
+			}
+		}
+		lines.clear();
+	});
+	CWavFileCapture capture(wav,bufferSamples,speed);
+	worker.Start();
+	start=std::chrono::steady_clock::now();
+	capture.Start([&](const short *pcm,size_t count)
+	{
+		if(matched)
+			capture.Cancel();
+		else
+			worker.Submit(pcm,count);
+	});
+	capture.Join();
+	worker.Stop();
+
+	result.matched=recognizer.Matched();
+	result.match=recognizer.Match();
+	result.peaks=peakCount;
+	result.capture=worker.Stats();
+	result.audioSeconds=0;
+	result.wallSeconds=0;
+	if(result.matched && wav.sampleRate)
+	{
+		result.audioSeconds=(double)matchedSamples/wav.sampleRate;
+		result.wallSeconds=std::chrono::duration<double>(matchedAt-start).count();
+	}
+}
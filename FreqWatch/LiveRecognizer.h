@@ -0,0 +1,84 @@
+#pragma once
+#include <deque>
+#include <unordered_map>
+#include "AnchorIndex.h"
+#include "FreqAnalysis.h"
+#include "CaptureRing.h"
+#include "WavFileSource.h"
+
+struct LiveMatch
+{
+	int song_id;
+	//stored anchor time minus query time,as start_time_point in OnFileOpen
+	int offset;
+	//aligned votes within +-3 frames of offset
+	int score;
+	//query frame of the peak whose vote passed the threshold
+	int query_time;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CLiveRecognizer
+// OnFileOpen matching turned inside out for a stream of peaks: every
+// new peak is tested as a target against the stored anchors of the
+// earlier query peaks it falls behind, and each stored anchor votes as
+// soon as it collects AnchorMinMatches check matches. The first song
+// whose offset histogram reaches minScore is the match.
+//////////////////////////////////////////////////////////////////////
+class CLiveRecognizer
+{
+public:
+	CLiveRecognizer(IAnchorSource *source,int minScore);
+
+	//peaks must arrive in time order; true when this peak produced the match
+	bool AddPeak(const FreqInfo &peak);
+	void Reset();
+
+	bool Matched() const { return m_matched; }
+	const LiveMatch &Match() const { return m_match; }
+	size_t AnchorsChecked() const { return m_anchorsChecked; }
+	size_t Votes() const { return m_voteCount; }
+private:
+	struct Candidate
+	{
+		AnchorRef anchor;
+		const CheckPoint *checks;
+		size_t checkCount;
+		int matches;
+	};
+	struct PendingAnchor
+	{
+		FreqInfo peak;
+		std::vector<Candidate> candidates;
+	};
+	void Vote(int song_id,int offset,int query_time);
+	int WindowScore(int song_id,int offset) const;
+
+	IAnchorSource *m_source;
+	int m_minScore;
+	std::deque<PendingAnchor> m_pending;
+	//(song_id,offset) -> votes
+	std::unordered_map<long long,int> m_votes;
+	size_t m_anchorsChecked;
+	size_t m_voteCount;
+	bool m_matched;
+	LiveMatch m_match;
+};
+
+struct ReplayResult
+{
+	bool matched;
+	LiveMatch match;
+	//length of audio captured before the match was reported
+	double audioSeconds;
+	//wall clock from the first delivered buffer to the match
+	double wallSeconds;
+	size_t peaks;
+	CaptureStats capture;
+};
+
+//plays wav through CWavFileCapture into the live capture/recognition chain
+//and measures time-to-first-match; speed as in CWavFileCapture. The
+//replay ends once the match is reported
+void ReplayLiveRecognition(const WavData &wav,IAnchorSource &source,const AnalysisParams &params,
+	int minScore,double speed,ReplayResult &result);
@@ -9,6 +9,22 @@
 #include "UploadFreqData.h"
 #include "SearchBySite.h"
 #include "..\WavSink\Fourier.h"
+#include "..\WavSink\StftEngine.h"
+#include "CaptureRing.h"
+#include "LiveRecognizer.h"
+#include "SqliteAnchorSource.h"
+#include "SqliteHashSource.h"
+#include "SongIngest.h"
+#include "PackedCheckStore.h"
+#include "HashSegment.h"
+#include "MappedFile.h"
+#include "SegmentedIndex.h"
+#include "QueryBench.h"
+#include "IngestPipeline.h"
+#include "CorpusScanner.h"
+#include "AnalysisCache.h"
+
+const int WM_LIVEMATCH=WM_USER+2;
 class CMainFrame : 
 	public CFrameWindowImpl<CMainFrame>, 
 	public CUpdateUI<CMainFrame>,
@@ -20,6 +36,19 @@ public:
 	CFreqWatchView m_view;
 	CTrackBarCtrl m_trackBar;
 
+	CMainFrame():m_stft(SampleCount,SampleCount,&dataline),m_indexLoaded(false),m_anchorIndexLoadTicks(0),queryBenchRuns(5),
+		sqlSetQuery(true),hashSegmentPacked(false),runing(false),captureBufferCount(8),captureBufferSamples(SampleCount/4),liveMinScore(8),
+		stressReaders(4),stressSongs(1000),m_tombstonesLoaded(false),ingestThreads(0),
+		analysisCacheBytes((uint64_t)2<<30),m_anchorStopListLoaded(false),queryPostingBudget(4<<20)
+	{
+		queryEarlyStop.minScore=10;
+		queryEarlyStop.minMargin=6;
+		memset(&hashStopParams,0,sizeof(hashStopParams));
+		hashStopParams.maxMeanMultiple=16;
+		memset(&anchorStopParams,0,sizeof(anchorStopParams));
+		anchorStopParams.maxMeanMultiple=2;
+	}
+
 	virtual BOOL PreTranslateMessage(MSG* pMsg)
 	{
 		if(CFrameWindowImpl<CMainFrame>::PreTranslateMessage(pMsg))
@@ -44,15 +73,29 @@ public:
 		MSG_WM_SIZE(OnSize)
 		MSG_WM_HSCROLL(OnHScroll)
 		MESSAGE_HANDLER(WM_CLIENTMOUSEMOVE,OnClientMouseMove)
+		MESSAGE_HANDLER(WM_LIVEMATCH,OnLiveMatch)
 		COMMAND_ID_HANDLER(ID_APP_EXIT, OnFileExit)
 		COMMAND_ID_HANDLER(ID_FILE_NEW, OnFileNew)
 		COMMAND_ID_HANDLER(ID_FILE_SAVE,OnFileSave)
 		COMMAND_ID_HANDLER(ID_FILE_SAVE_AS,OnUploadData)
 		COMMAND_ID_HANDLER(ID_FILE_OPEN,OnFileOpen)
+		COMMAND_ID_HANDLER(ID_FILE_OPEN_HASH,OnFileOpenHash)
+		COMMAND_ID_HANDLER(ID_FILE_QUERY_BENCH,OnQueryBench)
+		COMMAND_ID_HANDLER(ID_FILE_SYNTHETIC_BENCH,OnSyntheticBench)
 		COMMAND_ID_HANDLER(ID_FILE_SEARCH_VAR_SITE,OnSearchVarSite)
 		COMMAND_ID_HANDLER(ID_VIEW_TOOLBAR, OnViewToolBar)
 		COMMAND_ID_HANDLER(ID_FILE_RECORD,OnFileRecord)
+		COMMAND_ID_HANDLER(ID_FILE_LIVE_RECOGNIZE,OnFileLiveRecognize)
 		COMMAND_ID_HANDLER(ID_FILE_RUN_FOLDER,OnRunFolder)
+		COMMAND_ID_HANDLER(ID_FILE_BATCH_QUERY,OnBatchQuery)
+		COMMAND_ID_HANDLER(ID_FILE_PACK_CHECKS,OnPackChecks)
+		COMMAND_ID_HANDLER(ID_FILE_BUILD_HASH_SEGMENT,OnBuildHashSegment)
+		COMMAND_ID_HANDLER(ID_FILE_STRESS_INDEX,OnStressIndex)
+		COMMAND_ID_HANDLER(ID_FILE_DELETE_SONG,OnDeleteSong)
+		COMMAND_ID_HANDLER(ID_FILE_COMPACT_DELETED,OnCompactDeleted)
+		COMMAND_ID_HANDLER(ID_FILE_INGEST_BENCH,OnIngestBench)
+		COMMAND_ID_HANDLER(ID_FILE_BUILD_STOP_LISTS,OnBuildStopLists)
+		COMMAND_ID_HANDLER(ID_FILE_STOP_LIST_BENCH,OnStopListBench)
 		CHAIN_MSG_MAP(CUpdateUI<CMainFrame>)
 		CHAIN_MSG_MAP(CFrameWindowImpl<CMainFrame>)
 	END_MSG_MAP()
@@ -81,11 +124,15 @@ public:
 		pLoop->AddMessageFilter(this);
 		pLoop->AddIdleHandler(this);
 
+		//once per run,so saves and queries only find the tables
+		CreateSongTables(L"D:\\freq_info.data.db");
 		return 0;
 	}
 
 	LRESULT OnDestroy(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled)
 	{
+		FinishIndexLoad();
+		m_liveIndex.Close();
 		// unregister message filtering and idle updates
 		CMessageLoop* pLoop = _Module.GetMessageLoop();
 		ATLASSERT(pLoop != NULL);
@@ -102,6 +149,7 @@ public:
 		return 0;
 	}
 	std::vector<std::vector<double>> dataline;
+	CStftEngine m_stft;
 	CDIBBitmap memimage;
 	
 	double maxStrong;
@@ -115,12 +163,28 @@ public:
 		openFileName=openfile.m_szFileName;
 		openFileName=openFileName.Right(openFileName.GetLength()-openFileName.ReverseFind('\\')-1);
 		openFileName=openFileName.Left(openFileName.Find('.'));
-		dataline= ReadMusicFrequencyData(openfile.m_szFileName);
+		DWORD start=GetTickCount();
+		//a file analysed before is read back from the cache,spectrum and all
+		AnalysisParams params={SampleCount,HashGridSampleCount};
+		AnalysisKey key={0,params,DecoderMediaFoundation};
+		bool hashed=HashFileContent(openfile.m_szFileName,key.contentHash);
+		bool cached=hashed && AnalysisCache().Lookup(key,&dataline,freqinfos);
+		if(cached)
+			BuildDarkLines(dataline,SampleCount/2,darklines);
+		else
+		{
+			dataline= ReadMusicFrequencyData(openfile.m_szFileName);
+			BuildData();
+			if(hashed && !dataline.empty())
+				AnalysisCache().Store(key,&dataline,freqinfos);
+		}
 		
 		m_trackBar.SetRangeMax(100);
 		m_trackBar.SetPos(50);
-		BuildData();
 		BuildImage();
+		CAtlString str;
+		str.Format(_T("%s: %u ms%s"),(LPCTSTR)openFileName,GetTickCount()-start,cached?_T(",from the cache"):_T(""));
+		SetWindowText(str);
 		return 0;
 	}
 	LRESULT OnFileSave(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
@@ -141,272 +205,471 @@ public:
 	}
 	void SaveMusicInfoToDb(CAtlString title)
 	{
-		CSqlite db;
-		db.Open(L"D:\\freq_info.data.db");
-		CSqliteStmt insertFileName=db.Prepare(L"insert into songlist(name) values(?1)");
-		CSqliteStmt lastFileId=db.Prepare(L"select last_insert_rowid() from songlist");
-		CSqliteStmt insertAnchor = db.Prepare(L"insert into Anchor_freq_index(freq,time,song_id) values(?1,?2,?3)");
-		CSqliteStmt lastAnchorID = db.Prepare(L"select last_insert_rowid() from Anchor_freq_index");
-		CSqliteStmt insertCheck=db.Prepare(L"insert into Check_freq_index(Anchor_id,freq,time_offset) values(?1,?2,?3)");
-
-		int song_id=0;
-		insertFileName.Bind(1,title);
-		if(SQLITE_DONE==insertFileName.Step())
+		//a load still running would miss this song and hold the database
+		FinishIndexLoad();
+		//always a new song: titles are not unique,so one of the same title
+		//is another song; OnDeleteSong removes songs by title on request
+		CSongIngest ingest(L"D:\\freq_info.data.db",false);
+		int song_id=ingest.AddSong(title,freqinfos);
+		ingest.Finish();
+		if(OpenLiveIndex())
 		{
-			if(SQLITE_ROW==lastFileId.Step())
-			{
-				song_id=lastFileId.GetInt(0);
-			}
-			lastFileId.Reset();
+			if(song_id)
+				m_liveIndex.AddSong(song_id,freqinfos);
+			m_liveIndex.Publish();
 		}
-		insertFileName.Reset();
-
-		if(song_id>0)
+		//picked up again by the next query
+		m_anchorIndex.reset();
+		m_tombstonesLoaded=false;
+	}
+	//songs deleted from the database whose points may still be in the
+	//indexes; their votes are dropped before scoring
+	CSongTombstones m_tombstones;
+	bool m_tombstonesLoaded;
+	const CSongTombstones &Tombstones()
+	{
+		if(!m_tombstonesLoaded)
 		{
-			db.Execute(L"begin transaction");
-			std::vector<FreqInfo> freqinfos_use;
-			for(auto i=freqinfos.begin();i<freqinfos.end();i++)
-			{
-				if(i->freq>40 && i->freq<600)
-				{
-					freqinfos_use.push_back(*i);
-				}
-			}
-			int ptcount=0;
-			for(auto i=freqinfos_use.begin();i<freqinfos_use.end();i++)
-			{
-				std::vector<FreqInfo> anchor_sub;
-				for(auto j=i+1;j<freqinfos_use.end();j++)
-				{
-					if(j->time>i->time+45)
-						break;
-					if(j->freq>i->freq-30 && j->freq<i->freq+30 &&
-						j->time>i->time+5)
-					{
-						anchor_sub.push_back(*j);
-					}
-				}
-				if(anchor_sub.size()>3)
-				{
-					insertAnchor.Bind(1,i->freq);
-					insertAnchor.Bind(2,i->time);
-					insertAnchor.Bind(3,song_id);
-					if(SQLITE_DONE==insertAnchor.Step())
-					{
-						insertAnchor.Reset();
-						int insert_id=0;
-						if(SQLITE_ROW==lastAnchorID.Step())
-						{
-							insert_id=lastAnchorID.GetInt(0);
-							lastAnchorID.Reset();
-						}
-						if(insert_id)
-						{
-							for(auto j=anchor_sub.begin();j!=anchor_sub.end();j++)
-							{
-								insertCheck.Bind(1,insert_id);
-								insertCheck.Bind(2,j->freq);
-								insertCheck.Bind(3,j->time-i->time);
-								insertCheck.Step();
-								insertCheck.Reset();
-							}
-						}
-					}
-				}
-			}
-			db.Execute(L"commit transaction");
+			m_tombstones.Clear();
+			m_tombstonesLoaded=LoadSongTombstones(L"D:\\freq_info.data.db",m_tombstones);
 		}
-		insertFileName.Close();
-		lastFileId.Close();
-		insertAnchor.Close();
-		lastAnchorID.Close();
-		insertCheck.Close();
-		db.Close();
+		return m_tombstones;
+	}
+	//analyses of the files opened or ingested,by content hash; opened on
+	//first use
+	CAnalysisCache m_analysisCache;
+	uint64_t analysisCacheBytes;
+	CAnalysisCache &AnalysisCache()
+	{
+		if(!m_analysisCache.IsOpen())
+			m_analysisCache.Open(L"D:\\freq_info.cache",analysisCacheBytes);
+		return m_analysisCache;
+	}
+	//Anchor_freq_index and Check_freq_index held in memory; the first query
+	//starts loading it in the background,queries run on SQLite until it is in
+	std::unique_ptr<CAnchorMemIndex> m_anchorIndex;
+	std::unique_ptr<CAnchorMemIndex> m_loadingIndex;
+	std::thread m_indexLoader;
+	std::atomic<bool> m_indexLoaded;
+	DWORD m_anchorIndexLoadTicks;
+	CQueryExecutor m_queryExecutor;
+	void StartIndexLoad()
+	{
+		if(m_anchorIndex || m_indexLoader.joinable())
+			return;
+		m_indexLoaded=false;
+		m_loadingIndex.reset(new CAnchorMemIndex);
+		m_indexLoader=std::thread([this]()
+		{
+			DWORD start=GetTickCount();
+			LoadAnchorMemIndex(L"D:\\freq_info.data.db",*m_loadingIndex);
+			m_anchorIndexLoadTicks=GetTickCount()-start;
+			m_indexLoaded=true;
+		});
+	}
+	void FinishIndexLoad()
+	{
+		if(!m_indexLoader.joinable())
+			return;
+		m_indexLoader.join();
+		m_anchorIndex=std::move(m_loadingIndex);
+	}
+	//null while the index is still loading
+	CAnchorMemIndex *ReadyAnchorIndex()
+	{
+		if(m_indexLoaded)
+			FinishIndexLoad();
+		return m_anchorIndex.get();
+	}
+	CAnchorMemIndex &AnchorIndex()
+	{
+		StartIndexLoad();
+		FinishIndexLoad();
+		return *m_anchorIndex;
+	}
+	//anchor freqs too common to look up,as OnBuildStopLists saved them
+	CKeyStopList m_anchorStopList;
+	bool m_anchorStopListLoaded;
+	const CKeyStopList &AnchorStopList()
+	{
+		if(!m_anchorStopListLoaded)
+		{
+			CMappedFile file;
+			if(!file.Open(L"D:\\freq_info.anchors.stop") || !m_anchorStopList.Load(file.Data(),file.Size()))
+				m_anchorStopList.Clear();
+			m_anchorStopListLoaded=true;
+		}
+		return m_anchorStopList;
 	}
 	LRESULT OnFileOpen(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
 	{
-		struct FreqPoint
+		StartIndexLoad();
+		CAnchorMemIndex *index=ReadyAnchorIndex();
+		std::vector<MatchVote> votes;
+		QueryProgress progress;
+		DWORD start=GetTickCount();
+		//the joined statement looks every query freq up,stopped or not,and
+		//runs to the end,so deleted songs' votes are dropped after it
+		if(index)
 		{
-			int id;
-			int freq;
-			int time;
-			int song_id;
-		};
-		struct FreqPointPicked:public FreqPoint
+			CStopListAnchorSource source(*index,AnchorStopList());
+			m_queryExecutor.MatchEarlyStop(freqinfos,source,queryEarlyStop,votes,progress,&Tombstones());
+		}
+		else if(sqlSetQuery)
 		{
-			int sample_time;
-			int match_count;
-			int start_time_point;
-		};
-		struct CheckPoint
+			progress.anchorsChecked=MatchAnchorsJoined(L"D:\\freq_info.data.db",freqinfos,votes);
+			DropDeletedVotes(Tombstones(),votes);
+		}
+		else
 		{
-			int freq;
-			int time_offset;
-		};
+			CSqliteAnchorSource sqlite(L"D:\\freq_info.data.db");
+			CStopListAnchorSource source(sqlite,AnchorStopList());
+			m_queryExecutor.MatchEarlyStop(freqinfos,source,queryEarlyStop,votes,progress,&Tombstones());
+		}
+		std::vector<SongScore> scores;
+		ScoreVotes(votes,scores);
+		DWORD queryTicks=GetTickCount()-start;
 
-		CSqlite db;
-		db.Open(L"D:\\freq_info.data.db",SQLITE_OPEN_READONLY);
-		CSqliteStmt findAnchor = db.Prepare(L"select id,freq,time,song_id from Anchor_freq_index where freq=?1");
-		//CSqliteStmt findCheckPoint =db.Prepare(L"select count(*) from Check_freq_index where Anchor_id=?1 and freq>=?2 and freq<=?3 and time_offset>=?4 and time_offset<=?5");
-		CSqliteStmt getCheckOfAnchor =db.Prepare(L"select freq,time_offset from Check_freq_index where Anchor_id=?1");
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("all Anchor checked:%u\n"),progress.anchorsChecked);
+		if(!AnchorStopList().Empty() && (index || !sqlSetQuery))
+			resinfo.AppendFormat(_T("%u anchor freqs on the stop list not looked up\n"),AnchorStopList().Count());
+		if(progress.stopped)
+		{
+			resinfo.AppendFormat(_T("stopped after %u of %u peaks (song %d leads %d to %d)\n"),
+				progress.peaksUsed,progress.peaks,progress.leader,progress.leaderScore,progress.runnerScore);
+		}
+		if(index)
+		{
+			resinfo.AppendFormat(_T("query %u ms on %u threads,%u anchors in memory (loaded in %u ms)\n"),
+				queryTicks,m_queryExecutor.Threads(),index->AnchorCount(),m_anchorIndexLoadTicks);
+		}
+		else if(sqlSetQuery)
+			resinfo.AppendFormat(_T("query %u ms on sqlite in one joined statement while the index loads\n"),queryTicks);
+		else
+		{
+			CheckCacheStats cache=SharedCheckListCache().Stats();
+			resinfo.AppendFormat(_T("query %u ms on sqlite while the index loads,check list cache %I64u hits %I64u misses\n"),
+				queryTicks,cache.hits,cache.misses);
+		}
+		for(auto i=scores.begin();i!=scores.end();++i)
+		{
+			resinfo.AppendFormat(_T("found song:%d (%d time,startMatch %d)\n"),i->song_id,i->count,i->starttimeMaxCount);
+		}
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//the anchor query against the database one freq at a time, as OnFileOpen
+	//used to run it, as a single joined statement, and against the in-memory index
+	int queryBenchRuns;
+	//OnFileOpen stops once the leading song is this far ahead
+	EarlyStop queryEarlyStop;
+	//before the index is loaded,OnFileOpen asks sqlite with MatchAnchorsJoined
+	//rather than one statement per peak
+	bool sqlSetQuery;
+	LRESULT OnQueryBench(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		std::vector<std::vector<FreqInfo> > queries(queryBenchRuns,freqinfos);
+		CheckCacheStats cacheStart=SharedCheckListCache().Stats();
+		LatencyStats before;
+		std::vector<double> ms;
+		for(auto q=queries.begin();q!=queries.end();++q)
+		{
+			LARGE_INTEGER freq,t0,t1;
+			QueryPerformanceFrequency(&freq);
+			QueryPerformanceCounter(&t0);
+			CSqliteAnchorSource source(L"D:\\freq_info.data.db");
+			std::vector<MatchVote> votes;
+			MatchAnchors(*q,source,votes);
+			std::vector<SongScore> scores;
+			ScoreVotes(votes,scores);
+			QueryPerformanceCounter(&t1);
+			ms.push_back((t1.QuadPart-t0.QuadPart)*1000.0/freq.QuadPart);
+		}
+		SummarizeLatency(ms,before);
+		//the first run is the one that finds the check list cache cold
+		double beforeFirstMs=ms.empty()?0:ms[0];
+		CheckCacheStats cacheEnd=SharedCheckListCache().Stats();
+		LatencyStats joined;
+		ms.clear();
+		for(auto q=queries.begin();q!=queries.end();++q)
+		{
+			LARGE_INTEGER freq,t0,t1;
+			QueryPerformanceFrequency(&freq);
+			QueryPerformanceCounter(&t0);
+			std::vector<MatchVote> votes;
+			MatchAnchorsJoined(L"D:\\freq_info.data.db",*q,votes);
+			std::vector<SongScore> scores;
+			ScoreVotes(votes,scores);
+			QueryPerformanceCounter(&t1);
+			ms.push_back((t1.QuadPart-t0.QuadPart)*1000.0/freq.QuadPart);
+		}
+		SummarizeLatency(ms,joined);
+		LatencyStats after;
+		BenchAnchorQueries(queries,AnchorIndex(),after);
+		LatencyStats parallel;
+		BenchAnchorQueries(queries,AnchorIndex(),m_queryExecutor,parallel);
+		EarlyStopReport early;
+		BenchEarlyStop(queries,AnchorIndex(),m_queryExecutor,queryEarlyStop,early);
 
-		std::vector<FreqInfo> freqinfos_use;
-		for(auto i=freqinfos.begin();i<freqinfos.end();i++)
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("sqlite: mean %.1f ms,p50 %.1f ms,max %.1f ms,first run %.1f ms\n"),
+			before.meanMs,before.p50Ms,before.maxMs,beforeFirstMs);
+		resinfo.AppendFormat(_T("check list cache: %I64u hits,%I64u misses,%u lists held\n"),
+			cacheEnd.hits-cacheStart.hits,cacheEnd.misses-cacheStart.misses,cacheEnd.entries);
+		resinfo.AppendFormat(_T("sqlite joined: mean %.1f ms,p50 %.1f ms,max %.1f ms\n"),joined.meanMs,joined.p50Ms,joined.maxMs);
+		resinfo.AppendFormat(_T("memory: mean %.1f ms,p50 %.1f ms,max %.1f ms\n"),after.meanMs,after.p50Ms,after.maxMs);
+		resinfo.AppendFormat(_T("memory,%u threads: mean %.1f ms,p50 %.1f ms,max %.1f ms\n"),
+			m_queryExecutor.Threads(),parallel.meanMs,parallel.p50Ms,parallel.maxMs);
+		resinfo.AppendFormat(_T("early stop: mean %.1f ms,p50 %.1f ms,max %.1f ms,%.0f%% of anchor lookups saved\n"),
+			early.early.meanMs,early.early.p50Ms,early.early.maxMs,early.anchorsSaved*100);
+		resinfo.AppendFormat(_T("index: %u anchors,%u checks,%u KB,loaded in %u ms\n"),
+			m_anchorIndex->AnchorCount(),m_anchorIndex->CheckCount(),(UINT)(m_anchorIndex->MemorySize()>>10),m_anchorIndexLoadTicks);
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//the same comparison on a synthetic library of 10k songs written to a scratch
+	//database: per-peak sqlite lookups against the memory index loaded from it
+	LRESULT OnSyntheticBench(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		SyntheticLibrary library={10000,300,2,60};
+		SyntheticLibraryReport report;
+		if(!BenchSyntheticLibrary(L"D:\\freq_info.synthetic.db",library,20,200,report))
 		{
-			if(i->freq>20 && i->freq<400)
-			{
-				freqinfos_use.push_back(*i);
-			}
+			MessageBox(_T("can not write D:\\freq_info.synthetic.db"));
+			return S_OK;
 		}
-		int ptcount=0;
-		size_t maybecount=0;
-		vector<FreqPointPicked> checkres;
-		std::map<int,std::vector<CheckPoint> > AnchorMap;
-		for(auto i=freqinfos_use.begin();i<freqinfos_use.end();i++)
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("%d songs: %u anchors,%u checks,written in %u ms\n"),library.songs,report.anchors,
+			report.checks,report.writeTicks);
+		resinfo.AppendFormat(_T("sqlite: mean %.1f ms,p50 %.1f ms,p99 %.1f ms,%u of %u right\n"),report.sqlite.meanMs,
+			report.sqlite.p50Ms,report.sqlite.p99Ms,report.sqliteRight,report.sqlite.runs);
+		resinfo.AppendFormat(_T("memory: mean %.1f ms,p50 %.1f ms,p99 %.1f ms,%u of %u right\n"),report.memory.meanMs,
+			report.memory.p50Ms,report.memory.p99Ms,report.memoryRight,report.memory.runs);
+		resinfo.AppendFormat(_T("index: %u KB,loaded in %u ms\n"),(UINT)(report.memoryBytes>>10),report.loadTicks);
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//Hash_freq_index written out as a hash segment and mapped; used by
+	//OnFileOpenHash when the file is there,rebuilt by OnBuildHashSegment
+	CMappedFile m_hashSegmentFile;
+	CHashSegment m_hashSegment;
+	//OnBuildHashSegment writes the postings as packed lists: a third of the
+	//mapped size,but every lookup decodes its list
+	bool hashSegmentPacked;
+	//hashes of the songs OnRunFolder adds,kept as segments that merge in the
+	//background; OnFileOpenHash asks it first once it holds anything
+	CSegmentedHashIndex m_liveIndex;
+	bool OpenLiveIndex()
+	{
+		if(m_liveIndex.IsOpen())
+			return true;
+		if(!m_liveIndex.Open(L"D:\\freq_info.segments"))
+			return false;
+		//a key is stopped as soon as it is as common as OnBuildStopLists would find it
+		m_liveIndex.SetHotKeyLimits(hashStopParams);
+		return true;
+	}
+	//postings a hash query may read by the live index's sketch before its
+	//dearest keys are dropped,0 for no limit
+	uint64_t queryPostingBudget;
+	bool OpenHashSegment()
+	{
+		if(m_hashSegment.IsAttached())
+			return true;
+		if(m_hashSegmentFile.Open(L"D:\\freq_info.hashes.seg") &&
+			m_hashSegment.Attach(m_hashSegmentFile.Data(),m_hashSegmentFile.Size()))
+			return true;
+		m_hashSegmentFile.Close();
+		return false;
+	}
+	LRESULT OnFileOpenHash(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		std::vector<FingerprintHash> query;
+		GenerateHashes(freqinfos,0,query);
+		//keys on the live index's stop list are skipped whichever source answers
+		bool liveOpen=OpenLiveIndex();
+		size_t stopped=RemoveStoppedHashes(m_liveIndex.StopList(),query);
+
+		std::vector<MatchVote> votes;
+		DWORD start=GetTickCount();
+		std::unique_ptr<CHashIndexSnapshot> live;
+		if(liveOpen)
 		{
-			vector<FreqPoint> maybeid;
-			findAnchor.Bind(1,i->freq);
-			while(SQLITE_ROW==findAnchor.Step())
-			{
-				FreqPoint fpoint;
-				fpoint.id=findAnchor.GetInt(0);
-				fpoint.freq=findAnchor.GetInt(1);
-				fpoint.time=findAnchor.GetInt(2);
-				fpoint.song_id=findAnchor.GetInt(3);
-				maybeid.push_back(fpoint);
-			}
-			findAnchor.Reset();
-			
-			if(maybeid.empty())
-				continue;
-			maybecount+=maybeid.size();
-			for(auto maybe=maybeid.begin();maybe!=maybeid.end();maybe++)
+			SegmentedIndexStats liveStats=m_liveIndex.Stats();
+			if(liveStats.segments || liveStats.memPostings)
+				live=m_liveIndex.Snapshot();
+		}
+		//the sketch only counts what the live index holds
+		HashQueryPlan plan;
+		memset(&plan,0,sizeof(plan));
+		if(live)
+			PlanHashQuery(m_liveIndex.Sketch(),queryPostingBudget,query,plan);
+		bool segment=!live && OpenHashSegment();
+		if(live)
+			live->Match(query,votes);
+		else
+		{
+			if(segment)
+				MatchHashes(query,m_hashSegment,votes);
+			else
 			{
-				auto checks=AnchorMap.find(maybe->id);
-				if(checks==AnchorMap.end())
-				{
-					getCheckOfAnchor.Bind(1,maybe->id);
-					vector<CheckPoint> ptlist;
-					while(SQLITE_ROW==getCheckOfAnchor.Step())
-					{
-						CheckPoint pt;
-						pt.freq=getCheckOfAnchor.GetInt(0);
-						pt.time_offset=getCheckOfAnchor.GetInt(1);
-						ptlist.push_back(pt);
-					}
-					getCheckOfAnchor.Reset();
-					checks=AnchorMap.insert(std::map<int,std::vector<CheckPoint> >::value_type(maybe->id,std::move(ptlist))).first;
-				}
-				int match_count=0;
-				for(auto j=i+1;j<freqinfos_use.end();j++)
-				{
-					if(j->time>i->time+45)
-						break;
-					if(j->freq>i->freq-30 && j->freq<i->freq+30 &&
-						j->time>i->time+5)
-					{
-						int time_offset=j->time-i->time;
-						for(auto cp=checks->second.begin();cp!=checks->second.end();cp++)
-						{
-							if(cp->freq>=j->freq-1 && cp->freq<=j->freq+1 &&
-								cp->time_offset>=time_offset-1 && cp->time_offset<=time_offset+1)
-							{
-								match_count++;
-							}
-						}
-					}
-				}
-				/*
-				for(auto j=i+1;j<freqinfos_use.end();j++)
-				{
-					if(j->time>i->time+45)
-						break;
-					if(j->freq>i->freq-30 && j->freq<i->freq+30 &&
-						j->time>i->time+5)
-					{
-						findCheckPoint.Bind(1,maybe->id);
-						findCheckPoint.Bind(2,j->freq-1);
-						findCheckPoint.Bind(3,j->freq+1);
-						findCheckPoint.Bind(4,j->time-i->time-1);
-						findCheckPoint.Bind(5,j->time-i->time+1);
-						if(SQLITE_ROW==findCheckPoint.Step())
-						{
-							int count=findCheckPoint.GetInt(0);
-							if(count)
-							{
-								match_count++;
-							}
-						}
-						findCheckPoint.Reset();
-					}
-				}*/
-				if(match_count>=2)
-				{
-					FreqPointPicked picked;
-					picked.id=maybe->id;
-					picked.freq=maybe->freq;
-					picked.time=maybe->time;
-					picked.song_id=maybe->song_id;
-					picked.match_count=match_count;
-					picked.sample_time=i->time;
-					picked.start_time_point=picked.time-picked.sample_time;
-					checkres.push_back(picked);
-				}
+				CSqliteHashSource source(L"D:\\freq_info.data.db");
+				MatchHashes(query,source,votes);
 			}
+			DropDeletedVotes(Tombstones(),votes);
 		}
-
-		getCheckOfAnchor.Close();
-		findAnchor.Close();
-		//findCheckPoint.Close();
-		db.Close();
+		std::vector<SongScore> scores;
+		ScoreVotes(votes,scores);
+		DWORD queryTicks=GetTickCount()-start;
 
 		CAtlString resinfo;
-		resinfo.AppendFormat(_T("all Anchor checked:%u\n"),maybecount);
-		struct MatchInfo
+		resinfo.AppendFormat(_T("query hashes:%u (%u on the stop list) votes:%u\n"),query.size(),stopped,votes.size());
+		if(live)
+			resinfo.AppendFormat(_T("%u keys estimated at %I64u postings,%u dearer keys (%u hashes,%I64u postings) dropped\n"),
+				plan.keys,plan.postings,plan.droppedKeys,plan.droppedHashes,plan.droppedPostings);
+		resinfo.AppendFormat(_T("query %u ms on %s\n"),queryTicks,
+			live?_T("the live index"):segment?_T("the hash segment"):_T("sqlite"));
+		for(auto i=scores.begin();i!=scores.end();++i)
 		{
-			int count;
-			int starttimeMaxCount;
-			std::map<int,int> timematch;
-			MatchInfo()
-			{
-				count=0;
-				starttimeMaxCount=0;
-			}
-		};
-		std::map<int,MatchInfo> matchcountor;
-		for(auto i=checkres.begin();i!=checkres.end();i++)
+			resinfo.AppendFormat(_T("found song:%d (%d time,startMatch %d)\n"),i->song_id,i->count,i->starttimeMaxCount);
+		}
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	LRESULT OnBuildHashSegment(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		DWORD start=GetTickCount();
+		CHashSegmentBuilder builder;
 		{
-			auto& countor=matchcountor[i->song_id];
-			countor.count++;
-			countor.timematch[i->start_time_point]++;
+			CSqlite db;
+			db.Open(L"D:\\freq_info.data.db",SQLITE_OPEN_READONLY);
+			CSqliteStmt allHashes=db.Prepare(L"select hash,time,song_id from Hash_freq_index");
+			while(SQLITE_ROW==allHashes.Step())
+				builder.AddPosting((uint32_t)allHashes.GetInt(0),allHashes.GetInt(2),allHashes.GetInt(1));
+			allHashes.Close();
+			db.Close();
 		}
+		std::vector<uint8_t> image;
+		size_t rawPostingBytes=builder.PostingCount()*sizeof(HashPosting);
+		builder.Build(image,hashSegmentPacked);
+		builder.Clear();
+		DWORD buildTicks=GetTickCount()-start;
 
-		
-		for(auto countor=matchcountor.begin();countor!=matchcountor.end();countor++)
+		//the mapping goes before the file it views is replaced
+		m_hashSegment.Detach();
+		m_hashSegmentFile.Close();
+		if(!WriteWholeFile(L"D:\\freq_info.hashes.seg",&image[0],image.size()))
 		{
-			int maxpos=0;
-			int maxcount=0;
-			for(auto j=countor->second.timematch.begin();
-				j!=countor->second.timematch.end();
-				j++)
-			{
-				if(j->second>maxcount)
-				{
-					maxcount=j->second;
-					maxpos=j->first;
-				}
-			}
-			maxcount=0;
-			for(int fr=maxpos-3;fr<=maxpos+3;fr++)
-			{
-				maxcount+=countor->second.timematch[fr];
-			}
-			countor->second.starttimeMaxCount=maxcount;
+			MessageBox(_T("can not write D:\\freq_info.hashes.seg"));
+			return S_OK;
+		}
+		start=GetTickCount();
+		bool opened=OpenHashSegment();
+		DWORD openTicks=GetTickCount()-start;
+
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("%u postings,%u keys,%u KB built in %u ms\n"),
+			m_hashSegment.PostingCount(),m_hashSegment.KeyCount(),(UINT)(image.size()>>10),buildTicks);
+		if(hashSegmentPacked)
+			resinfo.AppendFormat(_T("postings packed,%u KB unpacked\n"),(UINT)(rawPostingBytes>>10));
+		resinfo.AppendFormat(opened?_T("mapped in %u ms\n"):_T("could not map the segment (%u ms)\n"),openTicks);
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//synthetic songs added to a scratch index while reader threads query it
+	size_t stressReaders;
+	size_t stressSongs;
+	LRESULT OnStressIndex(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		IndexStressReport report;
+		StressSegmentedIndex(L"D:\\freq_info.stress",stressReaders,stressSongs,report);
+
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("%u songs added,%.1f songs/s,with %u readers\n"),report.songs,report.songsPerSecond,stressReaders);
+		resinfo.AppendFormat(_T("%u queries,%u wrong: mean %.1f ms,p99 %.1f ms,max %.1f ms\n"),report.queries,report.wrong,
+			report.latency.meanMs,report.latency.p99Ms,report.latency.maxMs);
+		resinfo.AppendFormat(_T("%u segments,%u flushes,%u merges%s\n"),report.index.segments,report.index.flushes,
+			report.index.merges,report.index.failed?_T(",writing failed"):_T(""));
+		resinfo.AppendFormat(_T("%u versions retired,%u reclaimed,at most %u waiting on readers\n"),
+			report.epochs.retired,report.epochs.reclaimed,report.epochs.maxPending);
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//deletes the songs titled as the open file; their points stay until
+	//OnCompactDeleted. The ingest checkpoint forgets their files,so the
+	//next folder run adds them again
+	LRESULT OnDeleteSong(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		FinishIndexLoad();
+		CSongIngest ingest(L"D:\\freq_info.data.db",false);
+		std::vector<int> ids;
+		ingest.FindSongs(openFileName,ids);
+		CAtlString resinfo;
+		if(ids.empty())
+		{
+			ingest.Finish();
+			resinfo.Format(_T("no song titled %s"),(LPCTSTR)openFileName);
+			MessageBox(resinfo);
+			return S_OK;
+		}
+		resinfo.Format(_T("delete %u songs titled %s?"),ids.size(),(LPCTSTR)openFileName);
+		if(IDOK!=MessageBox(resinfo,NULL,MB_OKCANCEL))
+		{
+			ingest.Finish();
+			return S_OK;
+		}
+		bool live=OpenLiveIndex();
+		std::vector<int> deleted;
+		for(auto i=ids.begin();i!=ids.end();++i)
+		{
+			if(!ingest.DeleteSong(*i))
+				continue;
+			deleted.push_back(*i);
+			if(live)
+				m_liveIndex.DeleteSong(*i);
+		}
+		ingest.Finish();
+		m_tombstonesLoaded=false;
+		size_t forgotten=0;
+		CIngestCheckpoint checkpoint;
+		if(checkpoint.Open(L"D:\\freq_info.ingest.log"))
+			forgotten=checkpoint.ForgetSongs(deleted);
+		resinfo.Format(_T("%u songs deleted,%u files to ingest again\n"),deleted.size(),forgotten);
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//drops the points of deleted songs from the database and the live index
+	LRESULT OnCompactDeleted(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		FinishIndexLoad();
+		CompactStats stats;
+		bool compacted=CompactDeletedSongs(L"D:\\freq_info.data.db",stats);
+		m_anchorIndex.reset();
+		//the cached lists of deleted anchors would only hold memory
+		SharedCheckListCache().Clear();
+		bool live=OpenLiveIndex();
+		DWORD start=GetTickCount();
+		if(live)
+		{
+			m_liveIndex.Compact();
+			m_liveIndex.WaitIdle();
 		}
+		DWORD liveTicks=GetTickCount()-start;
 
-		for(auto i=matchcountor.begin();i!=matchcountor.end();++i)
+		CAtlString resinfo;
+		if(!compacted)
+			resinfo.Append(_T("could not compact D:\\freq_info.data.db\n"));
+		else
 		{
-			resinfo.AppendFormat(_T("found song:%d (%d time,startMatch %d)\n"),i->first,i->second.count,i->second.starttimeMaxCount);
+			resinfo.AppendFormat(_T("%u deleted songs: %u anchors,%u check points,%u hashes removed in %u ms\n"),
+				stats.songs,stats.anchors,stats.checks,stats.hashes,stats.ticks);
+		}
+		if(live)
+		{
+			SegmentedIndexStats liveStats=m_liveIndex.Stats();
+			resinfo.AppendFormat(_T("live index: %u segments,%u KB,%I64u postings dropped in %u ms%s\n"),liveStats.segments,
+				(UINT)(liveStats.segmentBytes>>10),liveStats.droppedPostings,liveTicks,liveStats.failed?_T(",writing failed"):_T(""));
 		}
 		MessageBox(resinfo);
 		return S_OK;
@@ -431,14 +694,21 @@ public:
 		}
 		return S_OK;
 	}
-	LRESULT OnRunFolder(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	bool PickFolder(CAtlString &path)
 	{
 		CFolderDialog dlg;
 		dlg.m_bExpandInitialSelection=TRUE;
 		if(IDOK!=dlg.DoModal())
-			return S_OK;
-		CAtlString path=dlg.m_szFolderPath;
-		std::vector<CAtlString> files;
+			return false;
+		path=dlg.m_szFolderPath;
+		path.TrimRight(L'\\');
+		return true;
+	}
+	bool PickFolderFiles(std::vector<CAtlString> &files)
+	{
+		CAtlString path;
+		if(!PickFolder(path))
+			return false;
 		CFindFile ff;
 		if(ff.FindFile(path+L"\\*"))
 		{
@@ -450,6 +720,297 @@ public:
 			}
 			while(ff.FindNextFile());
 		}
+		return true;
+	}
+	//threads OnRunFolder scans,decodes and analyses files on,0 for every core
+	size_t ingestThreads;
+	//the audio files under a folder and its subfolders,less those the
+	//checkpoint has as done and unchanged; a song is titled by its path
+	//under the folder
+	LRESULT OnRunFolder(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		CAtlString root;
+		if(!PickFolder(root))
+			return S_OK;
+		CIngestCheckpoint checkpoint;
+		if(!checkpoint.Open(L"D:\\freq_info.ingest.log"))
+		{
+			MessageBox(_T("can not open D:\\freq_info.ingest.log"));
+			return S_OK;
+		}
+		std::vector<CorpusFile> corpus;
+		CorpusScanStats scanStats;
+		ScanCorpus(root,&checkpoint,ingestThreads,corpus,scanStats);
+		FinishIndexLoad();
+		//indexes are built once after the last file instead of kept up per row
+		CSongIngest ingest(L"D:\\freq_info.data.db",true);
+		bool live=OpenLiveIndex();
+		//the media session decodes and transforms,the peaks are picked after
+		AnalysisParams params={SampleCount,HashGridSampleCount};
+		std::vector<CIngestPipeline::Stage> stages;
+		CAnalysisCache &cache=AnalysisCache();
+		//each item has a corpus entry of its own; a file analysed before
+		//skips decoding and the peaks
+		stages.push_back([&corpus,&cache,params](IngestItem &item)
+		{
+			CorpusFile &file=corpus[item.index];
+			if(!file.contentHash && !HashFileContent(file.path,file.contentHash))
+				return false;
+			item.contentHash=file.contentHash;
+			AnalysisKey key={item.contentHash,params,DecoderMediaFoundation};
+			item.cached=cache.Lookup(key,nullptr,item.freqinfos);
+			return true;
+		});
+		stages.push_back([&corpus](IngestItem &item)
+		{
+			if(item.cached)
+				return true;
+			HRESULT hr=CoInitializeEx(NULL,COINIT_MULTITHREADED);
+			item.dataline=ReadMusicFrequencyData(corpus[item.index].path);
+			if(SUCCEEDED(hr))
+				CoUninitialize();
+			return !item.dataline.empty();
+		});
+		stages.push_back([&cache,params](IngestItem &item)
+		{
+			if(item.cached)
+				return true;
+			ExtractPeaks(item.dataline,params,item.freqinfos);
+			SpectrumLines().swap(item.dataline);
+			//the peaks only; a spectrum per file would soon fill the cache
+			AnalysisKey key={item.contentHash,params,DecoderMediaFoundation};
+			cache.Store(key,nullptr,item.freqinfos);
+			return true;
+		});
+		AnalysisCacheStats cacheBefore=cache.Stats();
+		CIngestPipeline pipeline(ingestThreads);
+		IngestPipelineStats pipelineStats;
+		pipeline.Run(corpus.size(),stages,[&](IngestBatch &batch)
+		{
+			for(auto i=batch.begin();i!=batch.end();++i)
+			{
+				const CorpusFile &file=corpus[(*i)->index];
+				CAtlString title=file.path.Mid(root.GetLength()+1);
+				int dot=title.Find('.',title.ReverseFind('\\')+1);
+				if(dot>=0)
+					title=title.Left(dot);
+				//a file changed since its last ingest replaces the song read
+				//from that same path,never another one of the same title
+				const CheckpointEntry *last=checkpoint.Find(file.path);
+				int replaced=last?last->song_id:0;
+				int song_id=ingest.ReplaceSong(replaced,title,(*i)->freqinfos);
+				//recorded once the song is committed,so a file is only
+				//skipped next time if it is in the database
+				if(song_id)
+				{
+					CheckpointEntry entry={file.size,file.modified,file.contentHash,song_id};
+					checkpoint.Record(file.path,entry);
+				}
+				if(!live || !song_id)
+					continue;
+				m_liveIndex.AddSong(song_id,(*i)->freqinfos);
+				if(replaced)
+					m_liveIndex.DeleteSong(replaced);
+			}
+		},pipelineStats);
+		ingest.Finish();
+		m_anchorIndex.reset();
+		m_tombstonesLoaded=false;
+		//the rest is written as a segment in the background
+		m_liveIndex.Flush();
+
+		const IngestStats &stats=ingest.Stats();
+		DWORD ticks=stats.insertTicks+stats.indexTicks;
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("scanned %u folders in %.1f s: %u audio files,%u others\n"),
+			scanStats.directories,scanStats.seconds,scanStats.files,scanStats.notAudio);
+		resinfo.AppendFormat(_T("%u done before,%u of them touched but unchanged,%u to do (%I64u MB)\n"),
+			scanStats.unchanged+scanStats.touched,scanStats.touched,scanStats.todo,scanStats.todoBytes>>20);
+		resinfo.AppendFormat(_T("%u of %u files in %.1f s on %u threads,%.1f files/min,%u steals\n"),
+			pipelineStats.written,pipelineStats.files,pipelineStats.seconds,pipeline.Threads(),
+			pipelineStats.seconds>0?pipelineStats.written*60/pipelineStats.seconds:0.0,pipelineStats.steals);
+		resinfo.AppendFormat(_T("writer busy %.1f s in %u batches of up to %u files\n"),
+			pipelineStats.writeSeconds,pipelineStats.batches,pipelineStats.maxBatch);
+		AnalysisCacheStats cacheStats=cache.Stats();
+		resinfo.AppendFormat(_T("analysis cache: %u hits,%u misses,%u evicted,%u entries,%I64u of %I64u MB\n"),
+			cacheStats.hits-cacheBefore.hits,cacheStats.misses-cacheBefore.misses,
+			cacheStats.evictions-cacheBefore.evictions,cacheStats.entries,cacheStats.bytes>>20,cacheStats.maxBytes>>20);
+		resinfo.AppendFormat(_T("%u songs,%u rows in %u ms (%u ms building indexes)\n"),
+			stats.songs,stats.rows,ticks,stats.indexTicks);
+		resinfo.AppendFormat(_T("%.0f rows/s inserting,%.0f rows/s with the indexes\n"),
+			stats.insertTicks?stats.rows*1000.0/stats.insertTicks:0.0,ticks?stats.rows*1000.0/ticks:0.0);
+		if(live)
+		{
+			SegmentedIndexStats liveStats=m_liveIndex.Stats();
+			resinfo.AppendFormat(_T("live index: %u segments,%u KB,%u merges%s\n"),liveStats.segments,
+				(UINT)(liveStats.segmentBytes>>10),liveStats.merges,liveStats.failed?_T(",writing failed"):_T(""));
+			resinfo.AppendFormat(_T("key sketch: %I64u postings over about %.0f keys,%u hot keys stopped while adding\n"),
+				liveStats.sketchPostings,liveStats.sketchKeys,liveStats.hotKeys);
+		}
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//the wav files of a folder ingested into a hash table,one at a time
+	//and through the pipeline on 1,2,4.. threads up to every core
+	LRESULT OnIngestBench(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		CFolderDialog dlg;
+		dlg.m_bExpandInitialSelection=TRUE;
+		if(IDOK!=dlg.DoModal())
+			return S_OK;
+		std::vector<size_t> threads;
+		size_t cores=std::thread::hardware_concurrency();
+		for(size_t t=1;t<cores;t*=2)
+			threads.push_back(t);
+		threads.push_back(cores?cores:1);
+		std::vector<std::string> files;
+		if(!ListWavFiles(CW2A(dlg.m_szFolderPath),files))
+		{
+			MessageBox(_T("can not list the folder"));
+			return S_OK;
+		}
+		AnalysisParams params={SampleCount,HashGridSampleCount};
+		std::vector<IngestBenchRun> runs;
+		BenchIngestPipeline(files,threads,params,runs);
+
+		CAtlString resinfo;
+		for(auto i=runs.begin();i!=runs.end();++i)
+		{
+			if(i->threads)
+				resinfo.AppendFormat(_T("%u threads: "),i->threads);
+			else
+				resinfo.Append(_T("one at a time: "));
+			resinfo.AppendFormat(_T("%u files in %.1f s,%.1f files/min,%u steals,%u batches,%I64u postings\n"),
+				i->files,i->seconds,i->filesPerMinute,i->steals,i->batches,i->postings);
+		}
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//how common a key may get before OnBuildStopLists stops it: hash keys
+	//in the live index,anchor freqs in the anchor index. The live index
+	//also stops hash keys by these as it adds songs
+	StopListParams hashStopParams;
+	StopListParams anchorStopParams;
+	//stop lists from the key frequencies of the live index and the anchor
+	//index; the live index keeps its own and adds no postings under it
+	//from then on,OnFileOpen reads D:\freq_info.anchors.stop
+	LRESULT OnBuildStopLists(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		DWORD start=GetTickCount();
+		CKeyFrequencyCounter hashCounter;
+		bool live=OpenLiveIndex();
+		if(live)
+		{
+			//so the songs added since the last publish are counted
+			m_liveIndex.Publish();
+			m_liveIndex.Snapshot()->CountKeys(hashCounter);
+		}
+		CKeyFrequencyCounter anchorCounter;
+		anchorCounter.AddAnchors(AnchorIndex());
+		DWORD countTicks=GetTickCount()-start;
+
+		std::vector<KeyFrequency> keys;
+		hashCounter.Frequencies(keys);
+		CKeyStopList hashStop;
+		hashStop.Build(keys,hashCounter.Songs(),hashStopParams);
+		bool hashSaved=live && m_liveIndex.SetStopList(hashStop);
+		anchorCounter.Frequencies(keys);
+		CKeyStopList anchorStop;
+		anchorStop.Build(keys,anchorCounter.Songs(),anchorStopParams);
+		std::vector<uint8_t> image;
+		anchorStop.Save(image);
+		bool anchorSaved=WriteWholeFile(L"D:\\freq_info.anchors.stop",&image[0],image.size());
+		m_anchorStopList=anchorStop;
+		m_anchorStopListLoaded=true;
+
+		KeyFrequencySummary hashSummary;
+		KeyFrequencySummary anchorSummary;
+		hashCounter.Summarize(hashSummary);
+		anchorCounter.Summarize(anchorSummary);
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("counted in %u ms\n"),countTicks);
+		resinfo.AppendFormat(_T("hashes: %u songs,%u keys,%I64u postings,%.1f a key,longest %u,top 1%% of keys hold %.1f%%\n"),
+			hashSummary.songs,hashSummary.keys,hashSummary.postings,hashSummary.meanPostings,hashSummary.maxPostings,
+			hashSummary.topShare*100);
+		resinfo.AppendFormat(_T("%u hash keys stopped,%.1f%% of the postings%s\n"),hashStop.Count(),
+			hashSummary.postings?hashStop.StoppedPostings()*100.0/hashSummary.postings:0.0,hashSaved?_T(""):_T(",not saved"));
+		resinfo.AppendFormat(_T("anchors: %u songs,%u freqs,%I64u anchors,%.1f a freq,longest %u,top 1%% of freqs hold %.1f%%\n"),
+			anchorSummary.songs,anchorSummary.keys,anchorSummary.postings,anchorSummary.meanPostings,anchorSummary.maxPostings,
+			anchorSummary.topShare*100);
+		resinfo.AppendFormat(_T("%u anchor freqs stopped,%.1f%% of the anchors%s\n"),anchorStop.Count(),
+			anchorSummary.postings?anchorStop.StoppedPostings()*100.0/anchorSummary.postings:0.0,anchorSaved?_T(""):_T(",not saved"));
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//the songs of a folder searched by clips of themselves,with no stop
+	//lists,with hashStopParams/anchorStopParams,and with them halved and
+	//made four times looser
+	LRESULT OnStopListBench(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		std::vector<CAtlString> files;
+		if(!PickFolderFiles(files))
+			return S_OK;
+		AnalysisParams params={SampleCount,HashGridSampleCount};
+		std::vector<std::vector<FreqInfo> > songs;
+		for(auto i=files.begin();i!=files.end();++i)
+		{
+			std::vector<FreqInfo> peaks;
+			AnalysisKey key={0,params,DecoderMediaFoundation};
+			bool hashed=HashFileContent(*i,key.contentHash);
+			if(!hashed || !AnalysisCache().Lookup(key,nullptr,peaks))
+			{
+				SpectrumLines lines=ReadMusicFrequencyData(*i);
+				if(lines.empty())
+					continue;
+				ExtractPeaks(lines,params,peaks);
+				if(hashed)
+					AnalysisCache().Store(key,nullptr,peaks);
+			}
+			songs.push_back(peaks);
+		}
+		std::vector<StopListRun> runs(4);
+		memset(&runs[0],0,runs.size()*sizeof(runs[0]));
+		double scales[]={0,1,0.5,4};
+		for(size_t r=1;r<runs.size();r++)
+		{
+			runs[r].hashParams=hashStopParams;
+			runs[r].anchorParams=anchorStopParams;
+			StopListParams *both[]={&runs[r].hashParams,&runs[r].anchorParams};
+			for(int p=0;p<2;p++)
+			{
+				both[p]->maxPostings=(size_t)(both[p]->maxPostings*scales[r]);
+				both[p]->maxMeanMultiple*=scales[r];
+				both[p]->maxSongShare*=scales[r];
+			}
+		}
+		KeyFrequencySummary hashSummary;
+		KeyFrequencySummary anchorSummary;
+		//20 s clips,four a song
+		BenchStopLists(songs,4,(int)(20*44100/HashGridSampleCount),runs,hashSummary,anchorSummary);
+
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("%u songs,%u keys,%I64u postings,top 1%% of keys hold %.1f%%\n"),
+			hashSummary.songs,hashSummary.keys,hashSummary.postings,hashSummary.topShare*100);
+		for(auto r=runs.begin();r!=runs.end();++r)
+		{
+			resinfo.AppendFormat(_T("hashes over %u,%.1fx mean,%.0f%% of songs: %u keys (%.1f%%),p50 %.2f ms,p99 %.2f ms,%.0f votes,%u/%u right\n"),
+				r->hashParams.maxPostings,r->hashParams.maxMeanMultiple,r->hashParams.maxSongShare*100,r->hashKeys,
+				r->hashShare*100,r->hashLatency.p50Ms,r->hashLatency.p99Ms,r->hashVotes,r->hashRight,r->queries);
+			resinfo.AppendFormat(_T("anchors over %u,%.1fx mean,%.0f%% of songs: %u freqs (%.1f%%),p50 %.2f ms,p99 %.2f ms,%.0f checked,%u/%u right\n"),
+				r->anchorParams.maxPostings,r->anchorParams.maxMeanMultiple,r->anchorParams.maxSongShare*100,r->anchorFreqs,
+				r->anchorShare*100,r->anchorLatency.p50Ms,r->anchorLatency.p99Ms,r->anchorsChecked,r->anchorRight,r->queries);
+		}
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//every file of a folder identified in one BatchMatchAnchors pass
+	LRESULT OnBatchQuery(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		std::vector<CAtlString> files;
+		if(!PickFolderFiles(files))
+			return S_OK;
+		std::vector<CAtlString> names;
+		std::vector<std::vector<FreqInfo> > queries;
 		for(auto i=files.begin();i!=files.end();i++)
 		{
 			dataline= ReadMusicFrequencyData(*i);
@@ -458,22 +1019,94 @@ public:
 			BuildData();
 			CAtlString fileName=*i;
 			fileName=fileName.Right(fileName.GetLength()-fileName.ReverseFind('\\')-1);
-			fileName=fileName.Left(fileName.Find('.'));
-			SaveMusicInfoToDb(fileName);
+			names.push_back(fileName);
+			queries.push_back(freqinfos);
+		}
+
+		std::vector<std::vector<MatchVote> > votes;
+		BatchStats stats;
+		CAnchorMemIndex &index=AnchorIndex();
+		DWORD start=GetTickCount();
+		BatchMatchAnchors(queries,index,votes,stats,&Tombstones());
+		DWORD queryTicks=GetTickCount()-start;
+
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("%u queries in %u ms,%u anchor lookups (%u one by one)\n"),
+			queries.size(),queryTicks,stats.lookups,stats.singleLookups);
+		//the same queries timed again,looping MatchAnchors against one batch
+		BatchReport bench;
+		BenchBatchQueries(queries,index,bench);
+		resinfo.AppendFormat(_T("%.1f qps one by one,%.1f qps batched,%u of %u scored the same\n"),
+			bench.singleQps,bench.batchQps,bench.sameScores,queries.size());
+		std::vector<SongScore> scores;
+		for(size_t q=0;q<queries.size();q++)
+		{
+			ScoreVotes(votes[q],scores);
+			int best=0;
+			int bestScore=0;
+			for(auto i=scores.begin();i!=scores.end();++i)
+			{
+				if(i->starttimeMaxCount>bestScore)
+				{
+					bestScore=i->starttimeMaxCount;
+					best=i->song_id;
+				}
+			}
+			resinfo.AppendFormat(_T("%s: song %d (startMatch %d)\n"),(LPCTSTR)names[q],best,bestScore);
+		}
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	//writes a copy of the database with each anchor's check points packed
+	//into its row,then loads the check lists of every 8th query freq from both
+	LRESULT OnPackChecks(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		FinishIndexLoad();
+		CheckMigrateStats stats;
+		if(!MigrateToPackedChecks(L"D:\\freq_info.data.db",L"D:\\freq_info.packed.db",stats))
+		{
+			MessageBox(_T("can not write D:\\freq_info.packed.db from D:\\freq_info.data.db"));
+			return S_OK;
+		}
+		size_t rowPoints=0;
+		size_t packedPoints=0;
+		double rowMs;
+		double packedMs;
+		{
+			CSqliteAnchorSource source(L"D:\\freq_info.data.db",nullptr);
+			rowMs=BenchCheckListLoad(source,8,rowPoints);
+		}
+		{
+			CPackedAnchorSource source(L"D:\\freq_info.packed.db",nullptr);
+			packedMs=BenchCheckListLoad(source,8,packedPoints);
 		}
+
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("%u songs,%u anchors,%u checks packed in %u ms\n"),
+			stats.songs,stats.anchors,stats.checks,stats.ticks);
+		resinfo.AppendFormat(_T("database %I64u KB -> %I64u KB\n"),stats.sourceBytes>>10,stats.packedBytes>>10);
+		resinfo.AppendFormat(_T("check lists: %u points in %.1f ms by row,%u points in %.1f ms packed\n"),
+			rowPoints,rowMs,packedPoints,packedMs);
+		MessageBox(resinfo);
 		return S_OK;
 	}
 	
 	bool runing;
-	LRESULT OnFileRecord(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	//buffers queued on the device and their length; the callback only copies
+	//them into m_capture's ring so the worker has all of them as slack
+	int captureBufferCount;
+	int captureBufferSamples;
+	std::unique_ptr<CCaptureWorker> m_capture;
+	HWAVEIN m_hwi;
+	std::vector<WAVEHDR> m_whdrs;
+	std::vector<short> m_outsamples;
+	bool StartCapture(const CCaptureWorker::Consumer &consumer)
 	{
 		MMRESULT mmres;
-		HWAVEIN hwi;
-		WAVEHDR whdr,whdr1;
 		UINT devId;
 		WAVEFORMATEX wFormatEx;
-		short outsample1[SampleCount];
-		short outsample2[SampleCount];
+		m_whdrs.resize(captureBufferCount);
+		m_outsamples.resize(captureBufferCount*captureBufferSamples);
 
 		wFormatEx.wFormatTag = WAVE_FORMAT_PCM;
 		wFormatEx.nChannels = 1;
@@ -485,7 +1118,7 @@ public:
 		// Open audio device
 		debugstring(_T("\nwave in num %d\n"),waveInGetNumDevs());
 		for (devId = 0; devId < waveInGetNumDevs(); devId++) {
-			mmres = waveInOpen(&hwi, devId, &wFormatEx, (DWORD_PTR)CMainFrame::waveInProc,
+			mmres = waveInOpen(&m_hwi, devId, &wFormatEx, (DWORD_PTR)CMainFrame::waveInProc,
 				(DWORD_PTR)this, CALLBACK_FUNCTION);
 			if (mmres == MMSYSERR_NOERROR) {
 				break;
@@ -494,43 +1127,59 @@ public:
 		if (mmres != MMSYSERR_NOERROR)
 		{
 			debugstring(_T("1-%d"),mmres);
-			return S_FALSE;
+			return false;
 		}
 
-		ZeroMemory(&whdr, sizeof(WAVEHDR));
-		whdr.lpData = (LPSTR)outsample1;
-		whdr.dwBufferLength = sizeof(outsample1);
-
-		ZeroMemory(&whdr1, sizeof(WAVEHDR));
-		whdr1.lpData = (LPSTR)outsample2;
-		whdr1.dwBufferLength = sizeof(outsample2);
-
-		mmres = waveInPrepareHeader(hwi, &whdr, sizeof(WAVEHDR));
-		if (mmres != MMSYSERR_NOERROR)
+		for(int i=0;i<captureBufferCount;i++)
 		{
-			return FALSE;
-		}
+			WAVEHDR &whdr=m_whdrs[i];
+			ZeroMemory(&whdr, sizeof(WAVEHDR));
+			whdr.lpData = (LPSTR)&m_outsamples[i*captureBufferSamples];
+			whdr.dwBufferLength = captureBufferSamples*sizeof(short);
 
-		mmres = waveInPrepareHeader(hwi, &whdr1, sizeof(WAVEHDR));
-		if (mmres != MMSYSERR_NOERROR)
-		{
-			return FALSE;
+			mmres = waveInPrepareHeader(m_hwi, &whdr, sizeof(WAVEHDR));
+			if (mmres != MMSYSERR_NOERROR)
+			{
+				waveInClose(m_hwi);
+				return false;
+			}
 		}
-		
-		mmres=waveInAddBuffer(hwi,&whdr,sizeof(WAVEHDR));
-		mmres=waveInAddBuffer(hwi,&whdr1,sizeof(WAVEHDR));
+
+		m_capture.reset(new CCaptureWorker(captureBufferCount*captureBufferSamples*2,captureBufferSamples,consumer));
+		m_capture->Start();
+		for(int i=0;i<captureBufferCount;i++)
+			mmres=waveInAddBuffer(m_hwi,&m_whdrs[i],sizeof(WAVEHDR));
 		runing=true;
+		mmres=waveInStart(m_hwi);
+		return true;
+	}
+	void StopCapture()
+	{
+		MMRESULT mmres;
+		runing=false;
+		mmres=waveInStop(m_hwi);
+		mmres=waveInReset(m_hwi);
+		for(int i=0;i<captureBufferCount;i++)
+			mmres=waveInUnprepareHeader(m_hwi,&m_whdrs[i], sizeof(WAVEHDR));
+		mmres=waveInClose(m_hwi);
+		m_capture->Stop();
+
+		CaptureStats stats=m_capture->Stats();
+		CAtlString str;
+		str.Format(_T("record blocks:%I64u overruns:%I64u dropped samples:%I64u max fill:%u"),
+			stats.blocks,stats.overruns,stats.droppedSamples,(UINT)stats.maxFill);
+		SetWindowText(str);
+	}
+	LRESULT OnFileRecord(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
 		dataline.clear();
-		mmres=waveInStart(hwi);
+		m_stft.Reset();
+		if(!StartCapture([this](const short *pcm,size_t count){ ProcessBuffer(pcm,(int)count); }))
+			return S_FALSE;
 
 		MessageBox(_T("ȷֹͣ¼"));
 
-		runing=false;
-		mmres=waveInStop(hwi);
-		mmres=waveInReset(hwi);
-		mmres=waveInUnprepareHeader(hwi,&whdr, sizeof(WAVEHDR));
-		mmres=waveInUnprepareHeader(hwi,&whdr1, sizeof(WAVEHDR));
-		mmres=waveInClose(hwi);
+		StopCapture();
 
 		m_trackBar.SetRangeMax(100);
 		m_trackBar.SetPos(50);
@@ -538,6 +1187,61 @@ public:
 		this->BuildImage();
 		return S_OK;
 	}
+	//aligned votes a song needs before continuous recognition reports it
+	int liveMinScore;
+	LiveMatch m_liveMatch;
+	DWORD m_liveMatchTicks;
+	LRESULT OnFileLiveRecognize(WORD /*wNotifyCode*/, WORD /*wID*/, HWND /*hWndCtl*/, BOOL& /*bHandled*/)
+	{
+		CAnchorMemIndex &source=AnchorIndex();
+		SpectrumLines lines;
+		CStftEngine stft(SampleCount,SampleCount,&lines);
+		CStreamPeakPicker picker(SampleCount/2,(double)HashGridSampleCount/SampleCount,(double)SampleCount/HashGridSampleCount);
+		CLiveRecognizer recognizer(&source,liveMinScore);
+		std::vector<FreqInfo> peaks;
+		DWORD start=GetTickCount();
+		if(!StartCapture([&](const short *pcm,size_t count)
+		{
+			stft.Push(pcm,count);
+			for(auto line=lines.begin();line!=lines.end();++line)
+			{
+				peaks.clear();
+				picker.PushLine(*line,peaks);
+				for(auto p=peaks.begin();p!=peaks.end();++p)
+				{
+					if(recognizer.AddPeak(*p))
+					{
+						m_liveMatch=recognizer.Match();
+						m_liveMatchTicks=GetTickCount()-start;
+						PostMessage(WM_LIVEMATCH);
+					}
+				}
+			}
+			lines.clear();
+		}))
+			return S_FALSE;
+
+		MessageBox(_T("ȷֹͣ¼"));
+
+		StopCapture();
+
+		CAtlString resinfo;
+		resinfo.AppendFormat(_T("all Anchor checked:%u votes:%u\n"),recognizer.AnchorsChecked(),recognizer.Votes());
+		if(recognizer.Matched())
+		{
+			resinfo.AppendFormat(_T("found song:%d (startMatch %d,offset %d) after %u ms\n"),
+				m_liveMatch.song_id,m_liveMatch.score,m_liveMatch.offset,m_liveMatchTicks);
+		}
+		MessageBox(resinfo);
+		return S_OK;
+	}
+	LRESULT OnLiveMatch(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& /*bHandled*/)
+	{
+		CAtlString str;
+		str.Format(_T("found song:%d (startMatch %d) after %u ms"),m_liveMatch.song_id,m_liveMatch.score,m_liveMatchTicks);
+		SetWindowText(str);
+		return S_OK;
+	}
 	static void CALLBACK waveInProc(
 		HWAVEIN hwi,
 		UINT uMsg,
@@ -550,7 +1254,7 @@ public:
 		if(view->runing && WIM_DATA==uMsg)
 		{
 			WAVEHDR *hdr=(WAVEHDR *)dwParam1;
-			view->ProcessBuffer((short*)hdr->lpData,hdr->dwBytesRecorded/sizeof(short));
+			view->m_capture->Submit((short*)hdr->lpData,hdr->dwBytesRecorded/sizeof(short));
 			MMRESULT mmres;
 			hdr->dwFlags&=~WHDR_DONE;
 			mmres = waveInAddBuffer(hwi, hdr, sizeof(WAVEHDR));
@@ -560,133 +1264,19 @@ public:
 			}
 		}
 	}
-	void ProcessBuffer(short *buffer,int count)
+	void ProcessBuffer(const short *buffer,int count)
 	{
-		if(count!=SampleCount)
-			return;
-		std::vector<double> line;
-		for(int i=0;i<count;i++)
-			line.push_back(*(buffer+i));
-		std::vector<double> outR(SampleCount),outI(SampleCount);
-		fft_double(SampleCount,false,&line[0],nullptr,&outR[0],&outI[0]);
-		std::vector<double> freqRes(SampleCount/2);
-		for(int i=0;i<SampleCount/2;i++)
-		{
-			freqRes[i]=sqrt(outR[i]*outR[i]+outI[i]*outI[i]);
-		}
-		dataline.push_back(freqRes);
+		m_stft.Push(buffer,count);
 	}
 	
 	std::vector<std::vector<double>> darklines;
 	std::vector<FreqInfo> freqinfos;
 	void BuildData()
 	{
-		darklines.clear();
-		const int checkR=2;
-		for(size_t i=checkR;i!=dataline.size()-checkR;i++)
-		{
-			std::vector<double> line(SampleCount/2);
-			for(size_t j=checkR;j<SampleCount/2-checkR;j++)
-			{
-					/*const double core1[3][3]={
-						{-1,0,1},
-						{-2,0,2},
-						{-1,0,1}
-					};
-					const double core2[3][3]={
-						{1,2,1},
-						{0,0,0},
-						{-1,-2,-1}
-					};
-					double gx=0;
-					double gy=0;
-					for(int testi=-checkR;testi<checkR;testi++)
-					{
-						for(int testj=-checkR;testj<checkR;testj++)
-						{
-							double v=dataline[i+testi][j+testj];
-							gx+=v*core1[testi+1][testj+1];
-							gy+=v*core2[testi+1][testj+1];
-						}
-					}
-					double gpoint=sqrt(gx*gx+gy*gy);
-					line[j]=gpoint;*/
-				const double core1[5][5]={
-					{0,-0.5,-1,-0.5,0},
-					{-0.5,-1,-2,-1,-0.5},
-					{-1,-2,21,-2,-1},
-					{-0.5,-1,-2,-1,-0.5},
-					{0,-0.5,-1,-0.5,0}
-				};
-				double gx=0;
-				for(int testi=-checkR;testi<checkR;testi++)
-				{
-					for(int testj=-checkR;testj<checkR;testj++)
-					{
-						double v=dataline[i+testi][j+testj];
-						gx+=v*core1[testi+checkR][testj+checkR];
-					}
-				}
-				if(gx>0)
-					line[j]=sqrt(gx);
-			}
-			darklines.push_back(std::move(line));
-		}
-		//darklines=dataline;
-		double darkmax=0,darkmin=1e20;
-		for(int i=1;i!=darklines.size()-1;i++)
-		{
-			for(size_t j=1;j<SampleCount/2-1;j++)
-			{
-				double v=darklines[i][j];
-				darkmax=max(darkmax,v);
-				darkmin=min(darkmin,v);
-			}
-		}
-		double darkspan=darkmax-darkmin;
-		for(int i=1;i!=darklines.size()-1;i++)
-		{
-			for(size_t j=1;j<SampleCount/2-1;j++)
-			{
-				double &v=darklines[i][j];
-				v=(v-darkmin)/darkspan;
-			}
-		}
-		
-		freqinfos.clear();
-		const int area=5;
-		for(int i=area;i!=darklines.size()-area;i++)
-		{
-			for(size_t j=area;j<SampleCount/2-area;j++)
-			{
-				double strong=darklines[i][j];
-				if(strong>0.35)
-				{
-					double maxstrong=strong;
-					for(int x=-area;x<=area;x++)
-					{
-						for(int y=-area;y<=area;y++)
-						{
-							if(!(x==0 && y==0))
-							{
-								double other=darklines[i+x][j+y];
-								if(other>strong)
-								{
-									goto NEXT;
-								}
-							}
-						}
-					}
-					FreqInfo info;
-					info.freq=j;
-					info.time=i;
-					info.strong=strong;
-					freqinfos.push_back(info);
-NEXT:;
-				}
-				//NEXT:;
-			}
-		}
+		BuildDarkLines(dataline,SampleCount/2,darklines);
+		PickPeaks(darklines,SampleCount/2,freqinfos);
+		InterpolatePeaks(darklines,freqinfos);
+		QuantizePeaks(freqinfos,(double)HashGridSampleCount/SampleCount,(double)SampleCount/HashGridSampleCount);
 	}
 	
 	void BuildImage()
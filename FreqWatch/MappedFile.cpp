@@ -0,0 +1,79 @@
+#include "StdAfx.h"
+#include "MappedFile.h"
+
+
+CMappedFile::CMappedFile():m_file(INVALID_HANDLE_VALUE),m_mapping(NULL),m_view(nullptr),m_size(0)
+{
+}
+
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+bool CMappedFile::Open(LPCWSTR path)
+{
+	Close();
+	m_file=CreateFileW(path,GENERIC_READ,FILE_SHARE_READ|FILE_SHARE_DELETE,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if(m_file==INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	//an empty file can't be mapped
+	if(!GetFileSizeEx(m_file,&size) || size.QuadPart==0 || (uint64_t)size.QuadPart>(size_t)-1)
+	{
+		Close();
+		return false;
+	}
+	m_mapping=CreateFileMappingW(m_file,NULL,PAGE_READONLY,0,0,NULL);
+	if(m_mapping)
+		m_view=MapViewOfFile(m_mapping,FILE_MAP_READ,0,0,0);
+	if(!m_view)
+	{
+		Close();
+		return false;
+	}
+	m_size=(size_t)size.QuadPart;
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if(m_view)
+		UnmapViewOfFile(m_view);
+	if(m_mapping)
+		CloseHandle(m_mapping);
+	if(m_file!=INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_file=INVALID_HANDLE_VALUE;
+	m_mapping=NULL;
+	m_view=nullptr;
+	m_size=0;
+}
+
+bool WriteWholeFile(LPCWSTR path,const void *data,size_t size)
+{
+	CAtlString temp(path);
+	temp+=L".tmp";
+	HANDLE file=CreateFileW(temp,GENERIC_WRITE,0,NULL,CREATE_ALWAYS,FILE_ATTRIBUTE_NORMAL,NULL);
+	if(file==INVALID_HANDLE_VALUE)
+		return false;
+	const char *pos=(const char*)data;
+	bool written=true;
+	while(size && written)
+	{
+		DWORD chunk=size>(1u<<30)?(1u<<30):(DWORD)size;
+		DWORD done=0;
+		written=WriteFile(file,pos,chunk,&done,NULL) && done==chunk;
+		pos+=chunk;
+		size-=chunk;
+	}
+	written=written && FlushFileBuffers(file);
+	CloseHandle(file);
+	if(!written || !MoveFileExW(temp,path,MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH))
+	{
+		DeleteFileW(temp);
+		return false;
+	}
+	return true;
+}
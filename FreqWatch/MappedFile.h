@@ -0,0 +1,32 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+// CMappedFile
+// A whole file mapped read only. The file is opened with delete sharing,
+// so WriteWholeFile can replace it while it is mapped; the view keeps
+// the old contents until Close.
+//////////////////////////////////////////////////////////////////////
+class CMappedFile
+{
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	bool Open(LPCWSTR path);
+	void Close();
+	bool IsOpen() const { return m_view!=nullptr; }
+	const void *Data() const { return m_view; }
+	size_t Size() const { return m_size; }
+private:
+	CMappedFile(const CMappedFile&);
+	CMappedFile &operator=(const CMappedFile&);
+
+	HANDLE m_file;
+	HANDLE m_mapping;
+	const void *m_view;
+	size_t m_size;
+};
+
+//writes data to a temporary file next to path and renames it over path,
+//so a reader opening path sees either the old file or the whole new one
+bool WriteWholeFile(LPCWSTR path,const void *data,size_t size);
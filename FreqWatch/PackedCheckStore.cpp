@@ -0,0 +1,223 @@
+#include "StdAfx.h"
+#include "PackedCheckStore.h"
+#include <algorithm>
+
+static uint64_t DatabaseBytes(sqlite3 *db,const char *schema)
+{
+	uint64_t size[2]={0,0};
+	const char *pragmas[2]={"page_count","page_size"};
+	for(int p=0;p<2;p++)
+	{
+		char sql[64];
+		sprintf_s(sql,"pragma %s.%s",schema,pragmas[p]);
+		sqlite3_stmt *stmt=nullptr;
+		if(SQLITE_OK==sqlite3_prepare_v2(db,sql,-1,&stmt,nullptr) && SQLITE_ROW==sqlite3_step(stmt))
+			size[p]=(uint64_t)sqlite3_column_int64(stmt,0);
+		sqlite3_finalize(stmt);
+	}
+	return size[0]*size[1];
+}
+
+static bool Exec(sqlite3 *db,const char *sql)
+{
+	return SQLITE_OK==sqlite3_exec(db,sql,nullptr,nullptr,nullptr);
+}
+
+static bool AttachSource(sqlite3 *db,LPCWSTR sourcePath)
+{
+	sqlite3_stmt *attach=nullptr;
+	int res=sqlite3_prepare_v2(db,"attach database ?1 as src",-1,&attach,nullptr);
+	if(SQLITE_OK==res)
+	{
+		sqlite3_bind_text16(attach,1,sourcePath,-1,SQLITE_STATIC);
+		res=sqlite3_step(attach);
+	}
+	sqlite3_finalize(attach);
+	return SQLITE_DONE==res;
+}
+
+static bool SourceHasTable(sqlite3 *db,const char *table)
+{
+	sqlite3_stmt *find=nullptr;
+	bool found=false;
+	if(SQLITE_OK==sqlite3_prepare_v2(db,"select 1 from src.sqlite_master where type='table' and name=?1",-1,&find,nullptr))
+	{
+		sqlite3_bind_text(find,1,table,-1,SQLITE_STATIC);
+		found=SQLITE_ROW==sqlite3_step(find);
+	}
+	sqlite3_finalize(find);
+	return found;
+}
+
+static bool WritePackedAnchor(sqlite3_stmt *insert,const AnchorRef &anchor,std::vector<CheckPoint> &checks,std::vector<uint8_t> &blob)
+{
+	std::sort(checks.begin(),checks.end(),CheckPointLess);
+	PackCheckPoints(checks.empty()?nullptr:&checks[0],checks.size(),blob);
+	sqlite3_bind_int(insert,1,anchor.id);
+	sqlite3_bind_int(insert,2,anchor.freq);
+	sqlite3_bind_int(insert,3,anchor.time);
+	sqlite3_bind_int(insert,4,anchor.song_id);
+	sqlite3_bind_blob(insert,5,&blob[0],(int)blob.size(),SQLITE_STATIC);
+	int res=sqlite3_step(insert);
+	sqlite3_reset(insert);
+	return SQLITE_DONE==res;
+}
+
+//fills Anchor_packed_index from the attached source in one merge pass; false
+//as soon as a read or a write fails
+static bool CopyPackedAnchors(sqlite3 *db,CheckMigrateStats &stats)
+{
+	//both sides in anchor id order,so one merge pass pairs them up
+	sqlite3_stmt *anchors=nullptr;
+	sqlite3_stmt *checks=nullptr;
+	sqlite3_stmt *insert=nullptr;
+	bool ok=SQLITE_OK==sqlite3_prepare_v2(db,"select id,freq,time,song_id from src.Anchor_freq_index order by id",-1,&anchors,nullptr) &&
+		SQLITE_OK==sqlite3_prepare_v2(db,"select Anchor_id,freq,time_offset from src.Check_freq_index order by Anchor_id",-1,&checks,nullptr) &&
+		SQLITE_OK==sqlite3_prepare_v2(db,"insert into Anchor_packed_index(id,freq,time,song_id,checks) values(?1,?2,?3,?4,?5)",-1,&insert,nullptr);
+	int anchorRes=SQLITE_DONE;
+	int checkRes=ok?sqlite3_step(checks):SQLITE_DONE;
+	std::vector<CheckPoint> points;
+	std::vector<uint8_t> blob;
+	while(ok && SQLITE_ROW==(anchorRes=sqlite3_step(anchors)))
+	{
+		AnchorRef anchor;
+		anchor.id=sqlite3_column_int(anchors,0);
+		anchor.freq=sqlite3_column_int(anchors,1);
+		anchor.time=sqlite3_column_int(anchors,2);
+		anchor.song_id=sqlite3_column_int(anchors,3);
+		//checks of anchors that no longer exist are dropped
+		while(SQLITE_ROW==checkRes && sqlite3_column_int(checks,0)<anchor.id)
+			checkRes=sqlite3_step(checks);
+		points.clear();
+		while(SQLITE_ROW==checkRes && sqlite3_column_int(checks,0)==anchor.id)
+		{
+			CheckPoint pt;
+			pt.freq=sqlite3_column_int(checks,1);
+			pt.time_offset=sqlite3_column_int(checks,2);
+			points.push_back(pt);
+			checkRes=sqlite3_step(checks);
+		}
+		ok=(SQLITE_ROW==checkRes || SQLITE_DONE==checkRes) && WritePackedAnchor(insert,anchor,points,blob);
+		stats.anchors++;
+		stats.checks+=points.size();
+	}
+	ok=ok && SQLITE_DONE==anchorRes;
+	sqlite3_finalize(anchors);
+	sqlite3_finalize(checks);
+	sqlite3_finalize(insert);
+	return ok;
+}
+
+bool MigrateToPackedChecks(LPCWSTR sourcePath,LPCWSTR packedPath,CheckMigrateStats &stats)
+{
+	memset(&stats,0,sizeof(stats));
+	DWORD start=GetTickCount();
+	DeleteFileW(packedPath);
+	sqlite3 *db=nullptr;
+	if(SQLITE_OK!=sqlite3_open16(packedPath,&db))
+	{
+		sqlite3_close(db);
+		DeleteFileW(packedPath);
+		return false;
+	}
+	//a half written file is simply made again,so no journal is kept
+	bool ok=AttachSource(db,sourcePath) && Exec(db,"pragma main.journal_mode=OFF;pragma main.synchronous=OFF;begin;"
+		"create table songlist(id INTEGER PRIMARY KEY,name TEXT);"
+		"insert into songlist(id,name) select id,name from src.songlist;"
+		"create table Hash_freq_index(hash INTEGER,time INTEGER,song_id INTEGER);"
+		"create table Anchor_packed_index(id INTEGER PRIMARY KEY,freq INTEGER,time INTEGER,song_id INTEGER,checks BLOB)");
+	//older databases have no hash table
+	if(ok && SourceHasTable(db,"Hash_freq_index"))
+		ok=Exec(db,"insert into Hash_freq_index select hash,time,song_id from src.Hash_freq_index");
+	ok=ok && CopyPackedAnchors(db,stats) && Exec(db,"create index Anchor_packed_index_freq on Anchor_packed_index(freq);"
+		"create index Hash_freq_index_hash on Hash_freq_index(hash);commit");
+	if(ok)
+	{
+		sqlite3_stmt *songs=nullptr;
+		sqlite3_prepare_v2(db,"select count(*) from songlist",-1,&songs,nullptr);
+		if(SQLITE_ROW==sqlite3_step(songs))
+			stats.songs=(size_t)sqlite3_column_int(songs,0);
+		sqlite3_finalize(songs);
+		stats.sourceBytes=DatabaseBytes(db,"src");
+		stats.packedBytes=DatabaseBytes(db,"main");
+	}
+	sqlite3_exec(db,"detach database src",nullptr,nullptr,nullptr);
+	sqlite3_close(db);
+	//there is no journal to roll back,so a failed migration leaves no file
+	if(!ok)
+	{
+		DeleteFileW(packedPath);
+		return false;
+	}
+	stats.ticks=GetTickCount()-start;
+	return true;
+}
+
+CPackedAnchorSource::CPackedAnchorSource(LPCWSTR dbPath,CCheckListCache *checkCache):m_db(nullptr),m_findAnchor(nullptr),m_cache(checkCache)
+{
+	if(SQLITE_OK==sqlite3_open_v2(CW2A(dbPath,CP_UTF8),&m_db,SQLITE_OPEN_READONLY,nullptr))
+		sqlite3_prepare_v2(m_db,"select id,freq,time,song_id,checks from Anchor_packed_index where freq=?1",-1,&m_findAnchor,nullptr);
+}
+
+
+CPackedAnchorSource::~CPackedAnchorSource(void)
+{
+	sqlite3_finalize(m_findAnchor);
+	sqlite3_close(m_db);
+}
+
+size_t CPackedAnchorSource::FindAnchors(int freq,const AnchorRef **result)
+{
+	m_anchors.clear();
+	m_blobs.clear();
+	m_blobStart.assign(1,0);
+	if(m_findAnchor)
+	{
+		sqlite3_bind_int(m_findAnchor,1,freq);
+		while(SQLITE_ROW==sqlite3_step(m_findAnchor))
+		{
+			AnchorRef fpoint;
+			fpoint.id=sqlite3_column_int(m_findAnchor,0);
+			fpoint.freq=sqlite3_column_int(m_findAnchor,1);
+			fpoint.time=sqlite3_column_int(m_findAnchor,2);
+			fpoint.song_id=sqlite3_column_int(m_findAnchor,3);
+			m_anchors.push_back(fpoint);
+			const uint8_t *blob=(const uint8_t*)sqlite3_column_blob(m_findAnchor,4);
+			m_blobs.insert(m_blobs.end(),blob,blob+sqlite3_column_bytes(m_findAnchor,4));
+			m_blobStart.push_back(m_blobs.size());
+		}
+		sqlite3_reset(m_findAnchor);
+	}
+	*result=m_anchors.empty()?nullptr:&m_anchors[0];
+	return m_anchors.size();
+}
+
+size_t CPackedAnchorSource::GetChecks(const AnchorRef &anchor,const CheckPoint **checks)
+{
+	auto found=m_checkLists.find(anchor.id);
+	if(found==m_checkLists.end())
+	{
+		CheckListPtr ptlist;
+		if(m_cache)
+			ptlist=m_cache->Find(anchor.id);
+		if(!ptlist)
+		{
+			std::shared_ptr<std::vector<CheckPoint> > loaded(new std::vector<CheckPoint>);
+			//anchors are handed out from m_anchors by the last FindAnchors
+			if(!m_anchors.empty() && &anchor>=&m_anchors[0] && &anchor<&m_anchors[0]+m_anchors.size())
+			{
+				size_t pos=&anchor-&m_anchors[0];
+				size_t begin=m_blobStart[pos];
+				size_t end=m_blobStart[pos+1];
+				if(begin<end)
+					UnpackCheckPoints(&m_blobs[begin],end-begin,*loaded);
+			}
+			ptlist=loaded;
+			if(m_cache)
+				m_cache->Insert(anchor.id,ptlist);
+		}
+		found=m_checkLists.insert(std::map<int,CheckListPtr>::value_type(anchor.id,ptlist)).first;
+	}
+	*checks=found->second->empty()?nullptr:&(*found->second)[0];
+	return found->second->size();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "AnchorMemIndex.h"
+#include "CheckListCache.h"
+#include "CheckPack.h"
+
+//Packed schema: Anchor_packed_index(id,freq,time,song_id,checks BLOB) with
+//each anchor's check points inline as PackCheckPoints bytes, replacing the
+//one row per point of Check_freq_index. songlist and Hash_freq_index are
+//kept as they are. CSqlite has no blob calls,so this file talks to
+//sqlite3 directly.
+//The packed file is a copy made for OnPackChecks to measure; ingest and
+//every query path still use the row per point database.
+
+struct CheckMigrateStats
+{
+	size_t songs;
+	size_t anchors;
+	size_t checks;
+	//page_count*page_size of each database
+	uint64_t sourceBytes;
+	uint64_t packedBytes;
+	DWORD ticks;
+};
+
+//writes a new packed database at packedPath (replacing any file there) from
+//the row per point database at sourcePath; false if either can't be opened
+//or any statement fails,and the half written file is deleted
+bool MigrateToPackedChecks(LPCWSTR sourcePath,LPCWSTR packedPath,CheckMigrateStats &stats);
+
+//////////////////////////////////////////////////////////////////////
+// CPackedAnchorSource
+// Anchors of a packed database by frequency. The check blobs of the
+// anchors found are kept with them and only unpacked when GetChecks
+// asks for an anchor; unpacked lists live as long as the source and
+// go to the cache as CSqliteAnchorSource's do.
+//////////////////////////////////////////////////////////////////////
+class CPackedAnchorSource:public IAnchorSource
+{
+public:
+	//cache may be null
+	CPackedAnchorSource(LPCWSTR dbPath,CCheckListCache *checkCache=&SharedCheckListCache());
+	~CPackedAnchorSource(void);
+
+	size_t FindAnchors(int freq,const AnchorRef **result);
+	size_t GetChecks(const AnchorRef &anchor,const CheckPoint **checks);
+private:
+	sqlite3 *m_db;
+	sqlite3_stmt *m_findAnchor;
+	std::vector<AnchorRef> m_anchors;
+	//blob of m_anchors[i] is m_blobs[m_blobStart[i]..m_blobStart[i+1])
+	std::vector<uint8_t> m_blobs;
+	std::vector<size_t> m_blobStart;
+	std::map<int,CheckListPtr> m_checkLists;
+	CCheckListCache *m_cache;
+};
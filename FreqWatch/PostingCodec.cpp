@@ -0,0 +1,354 @@
+#include "PostingCodec.h"
+#include "CheckPack.h"
+#include <algorithm>
+#include <string.h>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define POSTING_SSE2
+#endif
+
+static int BitWidth(uint32_t value)
+{
+	int bits=0;
+	while(value)
+	{
+		bits++;
+		value>>=1;
+	}
+	return bits;
+}
+
+static void PutU32(std::vector<uint8_t> &out,uint32_t value)
+{
+	for(int b=0;b<4;b++)
+		out.push_back((uint8_t)(value>>(b*8)));
+}
+
+static void SetU32(uint8_t *pos,uint32_t value)
+{
+	for(int b=0;b<4;b++)
+		pos[b]=(uint8_t)(value>>(b*8));
+}
+
+static uint32_t GetU32(const uint8_t *pos)
+{
+	return pos[0]|((uint32_t)pos[1]<<8)|((uint32_t)pos[2]<<16)|((uint32_t)pos[3]<<24);
+}
+
+void PackBlock(const uint32_t *values,int bits,uint8_t *out)
+{
+	//word w of lane l is words[w*4+l]
+	uint32_t words[PostingBlockSize];
+	memset(words,0,bits*16);
+	for(size_t k=0;k<PostingBlockSize;k++)
+	{
+		size_t lane=k&3;
+		size_t bit=(k>>2)*bits;
+		size_t word=bit>>5;
+		size_t offset=bit&31;
+		words[word*4+lane]|=values[k]<<offset;
+		if(offset+bits>32)
+			words[(word+1)*4+lane]|=values[k]>>(32-offset);
+	}
+	for(int w=0;w<bits*4;w++)
+		SetU32(out+w*4,words[w]);
+}
+
+void UnpackBlock(const uint8_t *in,int bits,uint32_t *values)
+{
+	if(!bits)
+	{
+		memset(values,0,PostingBlockSize*sizeof(uint32_t));
+		return;
+	}
+#ifdef POSTING_SSE2
+	const __m128i *src=(const __m128i*)in;
+	__m128i mask=_mm_set1_epi32(bits==32?-1:(int)((1u<<bits)-1));
+	__m128i word=_mm_loadu_si128(src++);
+	int shift=0;
+	for(int i=0;i<32;i++)
+	{
+		__m128i v=_mm_srl_epi32(word,_mm_cvtsi32_si128(shift));
+		shift+=bits;
+		//a lane holds exactly bits words,so the last value never starts a new one
+		if(shift>=32 && i<31)
+		{
+			shift-=32;
+			word=_mm_loadu_si128(src++);
+			if(shift)
+				v=_mm_or_si128(v,_mm_sll_epi32(word,_mm_cvtsi32_si128(bits-shift)));
+		}
+		_mm_storeu_si128((__m128i*)(values+i*4),_mm_and_si128(v,mask));
+	}
+#else
+	uint32_t mask=bits==32?0xffffffffu:(1u<<bits)-1;
+	for(size_t k=0;k<PostingBlockSize;k++)
+	{
+		size_t lane=k&3;
+		size_t bit=(k>>2)*bits;
+		size_t word=bit>>5;
+		size_t offset=bit&31;
+		uint32_t v=GetU32(in+(word*4+lane)*4)>>offset;
+		if(offset+bits>32)
+			v|=GetU32(in+((word+1)*4+lane)*4)<<(32-offset);
+		values[k]=v&mask;
+	}
+#endif
+}
+
+//a short segment: n pairs of song step and time step in one bit stream,
+//low bits first,padded to a whole byte
+static size_t PairBytes(int pairBits,size_t n)
+{
+	return (pairBits*n+7)/8;
+}
+
+static void PackPairs(const uint32_t *songSteps,int songBits,const uint32_t *timeSteps,int timeBits,size_t n,
+	std::vector<uint8_t> &out)
+{
+	uint64_t bits=0;
+	int used=0;
+	for(size_t i=0;i<n;i++)
+	{
+		bits|=(uint64_t)songSteps[i]<<used;
+		used+=songBits;
+		while(used>=8)
+		{
+			out.push_back((uint8_t)bits);
+			bits>>=8;
+			used-=8;
+		}
+		bits|=(uint64_t)timeSteps[i]<<used;
+		used+=timeBits;
+		while(used>=8)
+		{
+			out.push_back((uint8_t)bits);
+			bits>>=8;
+			used-=8;
+		}
+	}
+	if(used)
+		out.push_back((uint8_t)bits);
+}
+
+static void UnpackPairs(const uint8_t *in,int songBits,int timeBits,size_t n,uint32_t &song,uint32_t &time,HashPosting *out)
+{
+	const uint8_t *end=in+PairBytes(songBits+timeBits,n);
+	uint64_t songMask=((uint64_t)1<<songBits)-1;
+	uint64_t timeMask=((uint64_t)1<<timeBits)-1;
+	uint64_t bits=0;
+	int have=0;
+	for(size_t i=0;i<n;i++)
+	{
+		//up to 64 bits held,a pair takes at most 64
+		while(have<=56 && in!=end)
+		{
+			bits|=(uint64_t)*in++<<have;
+			have+=8;
+		}
+		uint32_t songStep=(uint32_t)(bits&songMask);
+		bits>>=songBits;
+		have-=songBits;
+		if(have<timeBits)
+		{
+			//only when both widths are near 32
+			while(have<=56 && in!=end)
+			{
+				bits|=(uint64_t)*in++<<have;
+				have+=8;
+			}
+		}
+		uint32_t timeStep=(uint32_t)(bits&timeMask);
+		bits>>=timeBits;
+		have-=timeBits;
+		song+=songStep;
+		time+=(uint32_t)UnZigZag(timeStep);
+		out[i].song_id=(int)song;
+		out[i].time=(int)time;
+	}
+}
+
+//song steps and zigzag time steps of a block turned back into postings
+static void RestoreBlock(const uint32_t *songSteps,const uint32_t *timeSteps,uint32_t &song,uint32_t &time,HashPosting *out)
+{
+#ifdef POSTING_SSE2
+	__m128i songRun=_mm_set1_epi32((int)song);
+	__m128i timeRun=_mm_set1_epi32((int)time);
+	__m128i one=_mm_set1_epi32(1);
+	__m128i zero=_mm_setzero_si128();
+	for(size_t i=0;i<PostingBlockSize;i+=4)
+	{
+		__m128i s=_mm_loadu_si128((const __m128i*)(songSteps+i));
+		s=_mm_add_epi32(s,_mm_slli_si128(s,4));
+		s=_mm_add_epi32(s,_mm_slli_si128(s,8));
+		s=_mm_add_epi32(s,songRun);
+		songRun=_mm_shuffle_epi32(s,0xff);
+
+		__m128i t=_mm_loadu_si128((const __m128i*)(timeSteps+i));
+		t=_mm_xor_si128(_mm_srli_epi32(t,1),_mm_sub_epi32(zero,_mm_and_si128(t,one)));
+		t=_mm_add_epi32(t,_mm_slli_si128(t,4));
+		t=_mm_add_epi32(t,_mm_slli_si128(t,8));
+		t=_mm_add_epi32(t,timeRun);
+		timeRun=_mm_shuffle_epi32(t,0xff);
+
+		_mm_storeu_si128((__m128i*)(out+i),_mm_unpacklo_epi32(s,t));
+		_mm_storeu_si128((__m128i*)(out+i+2),_mm_unpackhi_epi32(s,t));
+	}
+	song=(uint32_t)_mm_cvtsi128_si32(songRun);
+	time=(uint32_t)_mm_cvtsi128_si32(timeRun);
+#else
+	for(size_t i=0;i<PostingBlockSize;i++)
+	{
+		song+=songSteps[i];
+		time+=(uint32_t)UnZigZag(timeSteps[i]);
+		out[i].song_id=(int)song;
+		out[i].time=(int)time;
+	}
+#endif
+}
+
+void EncodePostings(const HashPosting *postings,size_t count,std::vector<uint8_t> &out)
+{
+	PutVarint(out,(uint32_t)count);
+	size_t segments=(count+PostingBlockSize-1)/PostingBlockSize;
+	size_t skip=0;
+	if(segments>1)
+	{
+		PutU32(out,(uint32_t)postings[count-1].song_id);
+		skip=out.size();
+		out.resize(out.size()+segments*12);
+	}
+	size_t dataStart=out.size();
+	uint32_t song=0;
+	uint32_t time=0;
+	uint32_t songSteps[PostingBlockSize];
+	uint32_t timeSteps[PostingBlockSize];
+	for(size_t s=0;s<segments;s++)
+	{
+		if(segments>1)
+		{
+			uint8_t *entry=&out[skip+s*12];
+			SetU32(entry,song);
+			SetU32(entry+4,time);
+			SetU32(entry+8,(uint32_t)(out.size()-dataStart));
+		}
+		const HashPosting *p=postings+s*PostingBlockSize;
+		size_t n=std::min(PostingBlockSize,count-s*PostingBlockSize);
+		uint32_t songMax=0;
+		uint32_t timeMax=0;
+		for(size_t i=0;i<n;i++)
+		{
+			songSteps[i]=(uint32_t)p[i].song_id-song;
+			timeSteps[i]=ZigZag((int)((uint32_t)p[i].time-time));
+			song=(uint32_t)p[i].song_id;
+			time=(uint32_t)p[i].time;
+			songMax|=songSteps[i];
+			timeMax|=timeSteps[i];
+		}
+		int songBits=BitWidth(songMax);
+		int timeBits=BitWidth(timeMax);
+		if(n<PostingBlockSize)
+		{
+			out.push_back((uint8_t)songBits);
+			out.push_back((uint8_t)timeBits);
+			PackPairs(songSteps,songBits,timeSteps,timeBits,n,out);
+			continue;
+		}
+		size_t at=out.size();
+		out.resize(at+2+16*(songBits+timeBits));
+		out[at]=(uint8_t)songBits;
+		out[at+1]=(uint8_t)timeBits;
+		PackBlock(songSteps,songBits,&out[at+2]);
+		PackBlock(timeSteps,timeBits,&out[at+2+16*songBits]);
+	}
+}
+
+size_t PostingListCount(const uint8_t *data,size_t size)
+{
+	uint32_t count;
+	if(!GetVarint(data,data+size,count))
+		return 0;
+	return count;
+}
+
+bool DecodePostings(const uint8_t *data,size_t size,std::vector<HashPosting> &postings,int minSong)
+{
+	postings.clear();
+	const uint8_t *pos=data;
+	const uint8_t *end=data+size;
+	uint32_t count;
+	if(!GetVarint(pos,end,count))
+		return false;
+	size_t segments=(count+PostingBlockSize-1)/PostingBlockSize;
+	size_t first=0;
+	uint32_t song=0;
+	uint32_t time=0;
+	if(segments>1)
+	{
+		if((size_t)(end-pos)<4+segments*12)
+			return false;
+		int lastSong=(int)GetU32(pos);
+		const uint8_t *skip=pos+4;
+		const uint8_t *dataStart=skip+segments*12;
+		if(lastSong<minSong)
+			return true;
+		//the last song of a segment is the base of the next one
+		while(first+1<segments && (int)GetU32(skip+(first+1)*12)<minSong)
+			first++;
+		song=GetU32(skip+first*12);
+		time=GetU32(skip+first*12+4);
+		uint32_t offset=GetU32(skip+first*12+8);
+		if(offset>(size_t)(end-dataStart))
+			return false;
+		pos=dataStart+offset;
+	}
+	postings.resize(count-first*PostingBlockSize);
+	HashPosting *out=postings.empty()?nullptr:&postings[0];
+	uint32_t songSteps[PostingBlockSize];
+	uint32_t timeSteps[PostingBlockSize];
+	for(size_t s=first;s<segments;s++)
+	{
+		size_t n=std::min(PostingBlockSize,(size_t)count-s*PostingBlockSize);
+		if(n==PostingBlockSize)
+		{
+			if(end-pos<2 || pos[0]>32 || pos[1]>32 || (size_t)(end-pos)<2+16*(size_t)(pos[0]+pos[1]))
+			{
+				postings.clear();
+				return false;
+			}
+			int songBits=pos[0];
+			int timeBits=pos[1];
+			UnpackBlock(pos+2,songBits,songSteps);
+			UnpackBlock(pos+2+16*songBits,timeBits,timeSteps);
+			RestoreBlock(songSteps,timeSteps,song,time,out);
+			pos+=2+16*(songBits+timeBits);
+		}
+		else
+		{
+			if(end-pos<2 || pos[0]>32 || pos[1]>32 || (size_t)(end-pos)<2+PairBytes(pos[0]+pos[1],n))
+			{
+				postings.clear();
+				return false;
+			}
+			int songBits=pos[0];
+			int timeBits=pos[1];
+			UnpackPairs(pos+2,songBits,timeBits,n,song,time,out);
+			pos+=2+PairBytes(songBits+timeBits,n);
+		}
+		out+=n;
+	}
+	if(pos!=end)
+	{
+		postings.clear();
+		return false;
+	}
+	if(minSong!=INT_MIN)
+	{
+		auto keep=std::lower_bound(postings.begin(),postings.end(),minSong,[](const HashPosting &p,int song)
+		{
+			return p.song_id<song;
+		});
+		postings.erase(postings.begin(),keep);
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "HashIndex.h"
+
+//Packed posting list,for postings sorted by song_id then time:
+//  varint count
+//  when there is more than one segment:
+//    uint32 lastSong,then a skip entry per segment of
+//    uint32 baseSong,baseTime,offset   (the posting before it,its byte offset)
+//  segments of PostingBlockSize postings,the last one may be shorter
+//A full segment is a bit-packed block: a byte each for the bit widths of the
+//song steps and of the zigzag time steps,then the two 128 value arrays packed
+//in 4 lanes of 32 bit words (value k in lane k%4), so SSE2 unpacks 4 values
+//per instruction. A short segment has the same two width bytes and then
+//the pairs of steps packed one after another in a single bit stream.
+//Steps are taken in 32 bit wrapping arithmetic,so any values round-trip.
+const size_t PostingBlockSize=128;
+
+void EncodePostings(const HashPosting *postings,size_t count,std::vector<uint8_t> &out);
+//postings of the list at data with song_id minSong or more; the segments
+//that end before minSong are passed over by their skip entries. The
+//segment reader wants whole lists and leaves minSong at its default.
+//false on a malformed list,leaving postings empty
+bool DecodePostings(const uint8_t *data,size_t size,std::vector<HashPosting> &postings,int minSong=INT_MIN);
+//the count at the head of a list,0 if it can't be read
+size_t PostingListCount(const uint8_t *data,size_t size);
+
+//block level routines,exposed for the benchmarks: 128 values of width bits
+//packed in 16*bits bytes, and back
+void PackBlock(const uint32_t *values,int bits,uint8_t *out);
+void UnpackBlock(const uint8_t *in,int bits,uint32_t *values);
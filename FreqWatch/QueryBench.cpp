@@ -0,0 +1,662 @@
+#include "QueryBench.h"
+#include "AnchorMemIndex.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+
+void MakeSyntheticSong(unsigned int seed,int frames,int peaksPerFrame,std::vector<FreqInfo> &peaks)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> bin(StoreMinFreq+1,StoreMaxFreq-1);
+	peaks.clear();
+	for(int t=0;t<frames;t++)
+	{
+		size_t first=peaks.size();
+		for(int k=0;k<peaksPerFrame;k++)
+		{
+			FreqInfo info;
+			info.freq=bin(rng);
+			info.time=t;
+			info.strong=1;
+			info.exact_freq=info.freq;
+			info.exact_time=t;
+			peaks.push_back(info);
+		}
+		std::sort(peaks.begin()+first,peaks.end(),[](const FreqInfo &a,const FreqInfo &b)
+		{
+			return a.freq<b.freq;
+		});
+	}
+}
+
+void MakeQueryClip(const std::vector<FreqInfo> &song,int start,int frames,double keep,unsigned int seed,
+	std::vector<FreqInfo> &clip)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> chance(0,1);
+	std::uniform_int_distribution<int> jitter(-1,1);
+	clip.clear();
+	for(auto i=song.begin();i!=song.end();++i)
+	{
+		if(i->time<start || i->time>=start+frames)
+			continue;
+		if(chance(rng)>=keep)
+			continue;
+		FreqInfo info=*i;
+		info.freq+=jitter(rng);
+		info.time-=start;
+		info.exact_freq=info.freq;
+		info.exact_time=info.time;
+		clip.push_back(info);
+	}
+}
+
+void SummarizeLatency(std::vector<double> ms,LatencyStats &stats)
+{
+	stats.runs=ms.size();
+	stats.meanMs=stats.p50Ms=stats.p99Ms=stats.maxMs=0;
+	if(ms.empty())
+		return;
+	std::sort(ms.begin(),ms.end());
+	double sum=0;
+	for(auto i=ms.begin();i!=ms.end();++i)
+		sum+=*i;
+	stats.meanMs=sum/ms.size();
+	stats.p50Ms=ms[ms.size()/2];
+	stats.p99Ms=ms[(ms.size()*99)/100];
+	stats.maxMs=ms.back();
+}
+
+void BenchAnchorQueries(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,LatencyStats &stats)
+{
+	CQueryExecutor executor(1);
+	BenchAnchorQueries(queries,source,executor,stats);
+}
+
+void BenchAnchorQueries(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,CQueryExecutor &executor,
+	LatencyStats &stats)
+{
+	std::vector<double> ms;
+	std::vector<MatchVote> votes;
+	CVoteScorer scorer;
+	std::vector<SongScore> scores;
+	for(auto q=queries.begin();q!=queries.end();++q)
+	{
+		auto start=std::chrono::steady_clock::now();
+		executor.Match(*q,source,votes);
+		scorer.Score(votes,scores);
+		ms.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+	}
+	SummarizeLatency(ms,stats);
+}
+
+static int BestSong(const std::vector<SongScore> &scores)
+{
+	int best=0;
+	int bestScore=0;
+	for(auto i=scores.begin();i!=scores.end();++i)
+	{
+		if(i->starttimeMaxCount>bestScore)
+		{
+			bestScore=i->starttimeMaxCount;
+			best=i->song_id;
+		}
+	}
+	return best;
+}
+
+void MakeSyntheticClips(const SyntheticLibrary &library,size_t count,unsigned int seed,
+	std::vector<std::vector<FreqInfo> > &clips,std::vector<int> &owners)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> song(1,library.songs);
+	std::uniform_int_distribution<int> start(0,std::max(library.frames-library.clipFrames,0));
+	clips.assign(count,std::vector<FreqInfo>());
+	owners.resize(count);
+	std::vector<FreqInfo> peaks;
+	for(size_t c=0;c<count;c++)
+	{
+		owners[c]=song(rng);
+		MakeSyntheticSong((unsigned int)owners[c],library.frames,library.peaksPerFrame,peaks);
+		MakeQueryClip(peaks,start(rng),library.clipFrames,0.8,(unsigned int)rng(),clips[c]);
+	}
+}
+
+void BuildSyntheticAnchorIndex(const SyntheticLibrary &library,CAnchorMemIndex &index)
+{
+	std::vector<FreqInfo> peaks;
+	std::vector<SongAnchor> anchors;
+	for(int s=1;s<=library.songs;s++)
+	{
+		MakeSyntheticSong((unsigned int)s,library.frames,library.peaksPerFrame,peaks);
+		BuildSongAnchors(peaks,anchors);
+		index.AddSong(s,anchors);
+	}
+	index.Finish();
+}
+
+size_t BenchClipQueries(const std::vector<std::vector<FreqInfo> > &clips,const std::vector<int> &owners,
+	const ClipMatcher &match,LatencyStats &stats)
+{
+	std::vector<double> ms;
+	std::vector<MatchVote> votes;
+	CVoteScorer scorer;
+	std::vector<SongScore> scores;
+	size_t right=0;
+	for(size_t c=0;c<clips.size();c++)
+	{
+		auto start=std::chrono::steady_clock::now();
+		match(clips[c],votes);
+		scorer.Score(votes,scores);
+		ms.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+		if(BestSong(scores)==owners[c])
+			right++;
+	}
+	SummarizeLatency(ms,stats);
+	return right;
+}
+
+void BenchEarlyStop(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,CQueryExecutor &executor,
+	const EarlyStop &stop,EarlyStopReport &report)
+{
+	std::vector<double> fullMs;
+	std::vector<double> earlyMs;
+	std::vector<MatchVote> votes;
+	std::vector<SongScore> scores;
+	CVoteScorer scorer;
+	size_t peaks=0,peaksUsed=0,anchors=0,anchorsUsed=0;
+	report.stopped=0;
+	report.sameBest=0;
+	for(auto q=queries.begin();q!=queries.end();++q)
+	{
+		auto start=std::chrono::steady_clock::now();
+		anchors+=executor.Match(*q,source,votes);
+		scorer.Score(votes,scores);
+		fullMs.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+		int fullBest=BestSong(scores);
+
+		QueryProgress progress;
+		start=std::chrono::steady_clock::now();
+		executor.MatchEarlyStop(*q,source,stop,votes,progress);
+		scorer.Score(votes,scores);
+		earlyMs.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+		peaks+=progress.peaks;
+		peaksUsed+=progress.peaksUsed;
+		anchorsUsed+=progress.anchorsChecked;
+		if(progress.stopped)
+			report.stopped++;
+		if(BestSong(scores)==fullBest)
+			report.sameBest++;
+	}
+	SummarizeLatency(fullMs,report.full);
+	SummarizeLatency(earlyMs,report.early);
+	report.peaksSaved=peaks?1-(double)peaksUsed/peaks:0;
+	report.anchorsSaved=anchors?1-(double)anchorsUsed/anchors:0;
+}
+
+static bool SameScores(const std::vector<SongScore> &a,const std::vector<SongScore> &b)
+{
+	if(a.size()!=b.size())
+		return false;
+	for(size_t i=0;i<a.size();i++)
+	{
+		if(a[i].song_id!=b[i].song_id || a[i].count!=b[i].count ||
+			a[i].starttimeMaxCount!=b[i].starttimeMaxCount || a[i].offset!=b[i].offset)
+			return false;
+	}
+	return true;
+}
+
+void BenchBatchQueries(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,BatchReport &report)
+{
+	CVoteScorer scorer;
+	std::vector<std::vector<SongScore> > singleScores(queries.size());
+	std::vector<MatchVote> votes;
+	auto start=std::chrono::steady_clock::now();
+	for(size_t q=0;q<queries.size();q++)
+	{
+		MatchAnchors(queries[q],source,votes);
+		scorer.Score(votes,singleScores[q]);
+	}
+	double singleSeconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+	std::vector<std::vector<MatchVote> > batchVotes;
+	std::vector<SongScore> scores;
+	report.sameScores=0;
+	start=std::chrono::steady_clock::now();
+	BatchMatchAnchors(queries,source,batchVotes,report.stats);
+	for(size_t q=0;q<queries.size();q++)
+	{
+		scorer.Score(batchVotes[q],scores);
+		if(SameScores(scores,singleScores[q]))
+			report.sameScores++;
+	}
+	double batchSeconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	report.singleQps=singleSeconds>0?queries.size()/singleSeconds:0;
+	report.batchQps=batchSeconds>0?queries.size()/batchSeconds:0;
+}
+
+void BenchBatchHashQueries(const std::vector<std::vector<FingerprintHash> > &queries,IHashSource &source,
+	BatchReport &report)
+{
+	CVoteScorer scorer;
+	std::vector<std::vector<SongScore> > singleScores(queries.size());
+	std::vector<MatchVote> votes;
+	auto start=std::chrono::steady_clock::now();
+	for(size_t q=0;q<queries.size();q++)
+	{
+		MatchHashes(queries[q],source,votes);
+		scorer.Score(votes,singleScores[q]);
+	}
+	double singleSeconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+	std::vector<std::vector<MatchVote> > batchVotes;
+	std::vector<SongScore> scores;
+	report.sameScores=0;
+	start=std::chrono::steady_clock::now();
+	BatchMatchHashes(queries,source,batchVotes,report.stats);
+	for(size_t q=0;q<queries.size();q++)
+	{
+		scorer.Score(batchVotes[q],scores);
+		if(SameScores(scores,singleScores[q]))
+			report.sameScores++;
+	}
+	double batchSeconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	report.singleQps=singleSeconds>0?queries.size()/singleSeconds:0;
+	report.batchQps=batchSeconds>0?queries.size()/batchSeconds:0;
+}
+
+void BenchQueryThreads(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,
+	std::vector<ThreadSweepRun> &runs)
+{
+	std::vector<std::vector<SongScore> > serialScores(queries.size());
+	std::vector<MatchVote> votes;
+	CVoteScorer scorer;
+	for(size_t q=0;q<queries.size();q++)
+	{
+		MatchAnchors(queries[q],source,votes);
+		scorer.Score(votes,serialScores[q]);
+	}
+	std::vector<SongScore> scores;
+	for(auto r=runs.begin();r!=runs.end();++r)
+	{
+		CQueryExecutor executor(r->threads);
+		BenchAnchorQueries(queries,source,executor,r->latency);
+		r->sameScores=0;
+		for(size_t q=0;q<queries.size();q++)
+		{
+			executor.Match(queries[q],source,votes);
+			scorer.Score(votes,scores);
+			if(SameScores(scores,serialScores[q]))
+				r->sameScores++;
+		}
+	}
+}
+
+//walks every list of segment; millions of postings a second
+static double WalkSegment(CHashSegment &segment)
+{
+	uint64_t sum=0;
+	size_t postings=0;
+	auto start=std::chrono::steady_clock::now();
+	for(size_t k=0;k<segment.KeyCount();k++)
+	{
+		const HashPosting *list;
+		size_t count=segment.KeyPostings(k,&list);
+		for(size_t p=0;p<count;p++)
+			sum+=list[p].song_id;
+		postings+=count;
+	}
+	double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	//keeps the walk from being optimised away
+	if(sum==1)
+		return 0;
+	return seconds>0?postings/seconds/1e6:0;
+}
+
+void BenchPostingLayouts(const SyntheticLibrary &library,size_t clips,PostingLayoutReport &report)
+{
+	CHashSegmentBuilder builder;
+	std::vector<FreqInfo> peaks;
+	for(int s=1;s<=library.songs;s++)
+	{
+		MakeSyntheticSong((unsigned int)s,library.frames,library.peaksPerFrame,peaks);
+		builder.AddSong(s,peaks);
+	}
+	std::vector<uint8_t> rawImage;
+	std::vector<uint8_t> packedImage;
+	builder.Build(rawImage,false);
+	builder.Build(packedImage,true);
+	builder.Clear();
+	CHashSegment raw;
+	CHashSegment packed;
+	raw.Attach(&rawImage[0],rawImage.size());
+	packed.Attach(&packedImage[0],packedImage.size());
+	const HashSegmentHeader *rawHeader=(const HashSegmentHeader*)&rawImage[0];
+	const HashSegmentHeader *packedHeader=(const HashSegmentHeader*)&packedImage[0];
+	report.postings=raw.PostingCount();
+	report.keys=raw.KeyCount();
+	report.rawBytes=rawHeader->size-rawHeader->postingsOffset;
+	report.packedBytes=packedHeader->size-packedHeader->postingsOffset;
+	report.rawWalkRate=WalkSegment(raw);
+	report.packedWalkRate=WalkSegment(packed);
+
+	std::vector<std::vector<FreqInfo> > clipPeaks;
+	std::vector<int> owners;
+	MakeSyntheticClips(library,clips,1,clipPeaks,owners);
+	std::vector<FingerprintHash> query;
+	std::vector<MatchVote> votes;
+	std::vector<SongScore> rawScores;
+	std::vector<SongScore> packedScores;
+	CVoteScorer scorer;
+	std::vector<double> rawMs;
+	std::vector<double> packedMs;
+	report.sameScores=0;
+	report.clips=clips;
+	for(size_t c=0;c<clips;c++)
+	{
+		GenerateHashes(clipPeaks[c],0,query);
+		auto start=std::chrono::steady_clock::now();
+		MatchHashes(query,raw,votes);
+		scorer.Score(votes,rawScores);
+		rawMs.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+		start=std::chrono::steady_clock::now();
+		MatchHashes(query,packed,votes);
+		scorer.Score(votes,packedScores);
+		packedMs.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+		if(SameScores(rawScores,packedScores))
+			report.sameScores++;
+	}
+	SummarizeLatency(rawMs,report.raw);
+	SummarizeLatency(packedMs,report.packed);
+}
+
+void MakeRandomVotes(unsigned int seed,size_t count,int songs,std::vector<MatchVote> &votes)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> song(1,songs);
+	std::uniform_int_distribution<int> offset(-2000,8000);
+	std::uniform_int_distribution<int> jitter(-1,1);
+	votes.resize(count);
+	for(size_t v=0;v<count;v++)
+	{
+		if(v%10==0)
+		{
+			votes[v].song_id=1;
+			votes[v].offset=100+jitter(rng);
+			continue;
+		}
+		votes[v].song_id=song(rng);
+		votes[v].offset=offset(rng);
+	}
+}
+
+void ScoreVotesMap(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores)
+{
+	struct MatchInfo
+	{
+		int count;
+		std::map<int,int> timematch;
+		MatchInfo()
+		{
+			count=0;
+		}
+	};
+	std::map<int,MatchInfo> matchcountor;
+	for(auto i=votes.begin();i!=votes.end();i++)
+	{
+		auto& countor=matchcountor[i->song_id];
+		countor.count++;
+		countor.timematch[i->offset]++;
+	}
+
+	scores.clear();
+	for(auto countor=matchcountor.begin();countor!=matchcountor.end();countor++)
+	{
+		int maxpos=0;
+		int maxcount=0;
+		for(auto j=countor->second.timematch.begin();j!=countor->second.timematch.end();j++)
+		{
+			if(j->second>maxcount)
+			{
+				maxcount=j->second;
+				maxpos=j->first;
+			}
+		}
+		maxcount=0;
+		for(int fr=maxpos-VoteWindow;fr<=maxpos+VoteWindow;fr++)
+		{
+			auto found=countor->second.timematch.find(fr);
+			if(found!=countor->second.timematch.end())
+				maxcount+=found->second;
+		}
+		SongScore score;
+		score.song_id=countor->first;
+		score.count=countor->second.count;
+		score.starttimeMaxCount=maxcount;
+		score.offset=maxpos;
+		scores.push_back(score);
+	}
+}
+
+bool CheckVoteLeader(const std::vector<MatchVote> &votes)
+{
+	CVoteLeader leader;
+	std::map<int,std::map<int,int> > counts;
+	for(auto v=votes.begin();v!=votes.end();++v)
+	{
+		leader.Add(*v);
+		counts[v->song_id][v->offset]++;
+		int best=0;
+		int bestSong=0;
+		int runner=0;
+		for(auto s=counts.begin();s!=counts.end();++s)
+		{
+			const std::map<int,int> &offsets=s->second;
+			int score=0;
+			for(int c=offsets.begin()->first-VoteWindow;c<=offsets.rbegin()->first+VoteWindow;c++)
+			{
+				int window=0;
+				for(auto o=offsets.lower_bound(c-VoteWindow);o!=offsets.end() && o->first<=c+VoteWindow;++o)
+					window+=o->second;
+				score=std::max(score,window);
+			}
+			if(score>best)
+			{
+				runner=best;
+				best=score;
+				bestSong=s->first;
+			}
+			else if(score>runner)
+				runner=score;
+		}
+		//a tie for the lead may go to either song
+		if(leader.LeaderScore()!=best || leader.RunnerScore()!=runner || (best>runner && leader.Leader()!=bestSong))
+			return false;
+	}
+	return true;
+}
+
+void BenchVoteScoring(const std::vector<MatchVote> &votes,int rounds,VoteScoringReport &report)
+{
+	std::vector<SongScore> expected;
+	std::vector<SongScore> scores;
+	auto start=std::chrono::steady_clock::now();
+	for(int r=0;r<rounds;r++)
+		ScoreVotesMap(votes,expected);
+	report.mapMs=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count()/rounds;
+	report.same=true;
+	VoteCounting methods[]={VoteCountSort,VoteCountHash};
+	double *ms[]={&report.sortMs,&report.hashMs};
+	for(int m=0;m<2;m++)
+	{
+		CVoteScorer scorer(methods[m]);
+		start=std::chrono::steady_clock::now();
+		for(int r=0;r<rounds;r++)
+			scorer.Score(votes,scores);
+		*ms[m]=std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count()/rounds;
+		report.same=report.same && SameScores(scores,expected);
+	}
+}
+
+int CountCheckMatchesLinear(const CheckPoint *checks,size_t count,int freq,int time_offset)
+{
+	int match_count=0;
+	for(size_t i=0;i<count;i++)
+	{
+		const CheckPoint &cp=checks[i];
+		if(cp.freq>=freq-1 && cp.freq<=freq+1 &&
+			cp.time_offset>=time_offset-1 && cp.time_offset<=time_offset+1)
+		{
+			match_count++;
+		}
+	}
+	return match_count;
+}
+
+double BenchCheckMatches(const std::vector<SongAnchor> &anchors,int rounds,CheckMatchCounter counter)
+{
+	std::vector<CheckPoint> probes;
+	std::vector<size_t> probeStart;
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> df(1-AnchorFreqSpan,AnchorFreqSpan-1);
+	std::uniform_int_distribution<int> dt(AnchorMinTimeOffset+1,AnchorMaxTimeOffset);
+	for(auto a=anchors.begin();a!=anchors.end();++a)
+	{
+		probeStart.push_back(probes.size());
+		for(auto c=a->checks.begin();c!=a->checks.end();++c)
+		{
+			probes.push_back(*c);
+			CheckPoint miss;
+			miss.freq=a->freq+df(rng);
+			miss.time_offset=dt(rng);
+			probes.push_back(miss);
+		}
+	}
+	probeStart.push_back(probes.size());
+
+	long long matches=0;
+	auto start=std::chrono::steady_clock::now();
+	for(int r=0;r<rounds;r++)
+	{
+		for(size_t a=0;a<anchors.size();a++)
+		{
+			const std::vector<CheckPoint> &checks=anchors[a].checks;
+			for(size_t p=probeStart[a];p<probeStart[a+1];p++)
+				matches+=counter(&checks[0],checks.size(),probes[p].freq,probes[p].time_offset);
+		}
+	}
+	double ns=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-start).count();
+	//keeps the calls from being optimised away
+	if(matches<0)
+		return 0;
+	return probes.empty()?0:ns/((double)probes.size()*rounds);
+}
+
+double BenchCheckListLoad(IAnchorSource &source,int freqStep,size_t &points)
+{
+	points=0;
+	auto start=std::chrono::steady_clock::now();
+	for(int freq=QueryMinFreq+1;freq<QueryMaxFreq;freq+=freqStep)
+	{
+		const AnchorRef *anchors=nullptr;
+		size_t count=source.FindAnchors(freq,&anchors);
+		for(size_t a=0;a<count;a++)
+		{
+			const CheckPoint *checks=nullptr;
+			points+=source.GetChecks(anchors[a],&checks);
+		}
+	}
+	return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+}
+
+void BenchStopLists(const std::vector<std::vector<FreqInfo> > &songs,size_t clipsPerSong,int clipFrames,
+	std::vector<StopListRun> &runs,KeyFrequencySummary &hashSummary,KeyFrequencySummary &anchorSummary)
+{
+	CHashTable hashes;
+	CAnchorMemIndex anchors;
+	CKeyFrequencyCounter hashCounter;
+	std::vector<FingerprintHash> songHashes;
+	std::vector<SongAnchor> songAnchors;
+	for(size_t s=0;s<songs.size();s++)
+	{
+		GenerateHashes(songs[s],HashMaxFanout,songHashes);
+		hashes.AddSong((int)s+1,songHashes);
+		hashCounter.AddHashes((int)s+1,songHashes);
+		BuildSongAnchors(songs[s],songAnchors);
+		anchors.AddSong((int)s+1,songAnchors);
+	}
+	anchors.Finish();
+	CKeyFrequencyCounter anchorCounter;
+	anchorCounter.AddAnchors(anchors);
+	hashCounter.Summarize(hashSummary);
+	anchorCounter.Summarize(anchorSummary);
+	std::vector<KeyFrequency> hashKeys;
+	std::vector<KeyFrequency> anchorFreqs;
+	hashCounter.Frequencies(hashKeys);
+	anchorCounter.Frequencies(anchorFreqs);
+
+	//clips from anywhere in each song,a fifth of the peaks lost
+	std::vector<std::vector<FreqInfo> > clips;
+	std::vector<int> owners;
+	std::mt19937 rng(7);
+	for(size_t s=0;s<songs.size();s++)
+	{
+		if(songs[s].empty())
+			continue;
+		int frames=songs[s].back().time+1;
+		for(size_t c=0;c<clipsPerSong;c++)
+		{
+			int start=frames>clipFrames?std::uniform_int_distribution<int>(0,frames-clipFrames)(rng):0;
+			clips.push_back(std::vector<FreqInfo>());
+			MakeQueryClip(songs[s],start,clipFrames,0.8,(unsigned int)rng(),clips.back());
+			owners.push_back((int)s+1);
+		}
+	}
+
+	std::vector<FingerprintHash> query;
+	std::vector<MatchVote> votes;
+	std::vector<SongScore> scores;
+	CVoteScorer scorer;
+	for(auto r=runs.begin();r!=runs.end();++r)
+	{
+		CKeyStopList hashStop;
+		CKeyStopList anchorStop;
+		hashStop.Build(hashKeys,hashCounter.Songs(),r->hashParams);
+		anchorStop.Build(anchorFreqs,anchorCounter.Songs(),r->anchorParams);
+		r->hashKeys=hashStop.Count();
+		r->hashShare=hashSummary.postings?(double)hashStop.StoppedPostings()/hashSummary.postings:0;
+		r->anchorFreqs=anchorStop.Count();
+		r->anchorShare=anchorSummary.postings?(double)anchorStop.StoppedPostings()/anchorSummary.postings:0;
+		r->queries=clips.size();
+		r->hashRight=r->anchorRight=0;
+		CStopListAnchorSource anchorSource(anchors,anchorStop);
+		std::vector<double> hashMs;
+		std::vector<double> anchorMs;
+		uint64_t hashVotes=0,anchorsChecked=0;
+		for(size_t q=0;q<clips.size();q++)
+		{
+			auto start=std::chrono::steady_clock::now();
+			GenerateHashes(clips[q],0,query);
+			RemoveStoppedHashes(hashStop,query);
+			MatchHashes(query,hashes,votes);
+			scorer.Score(votes,scores);
+			hashMs.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+			hashVotes+=votes.size();
+			if(BestSong(scores)==owners[q])
+				r->hashRight++;
+
+			start=std::chrono::steady_clock::now();
+			anchorsChecked+=MatchAnchors(clips[q],anchorSource,votes);
+			scorer.Score(votes,scores);
+			anchorMs.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+			if(BestSong(scores)==owners[q])
+				r->anchorRight++;
+		}
+		SummarizeLatency(hashMs,r->hashLatency);
+		SummarizeLatency(anchorMs,r->anchorLatency);
+		r->hashVotes=clips.empty()?0:(double)hashVotes/clips.size();
+		r->anchorsChecked=clips.empty()?0:(double)anchorsChecked/clips.size();
+	}
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "AnchorIndex.h"
+#include "QueryExecutor.h"
+#include "BatchQuery.h"
+#include "StopList.h"
+
+class CAnchorMemIndex;
+
+//random peak lists standing in for analysed songs,for query timing on
+//libraries larger than the songs at hand; peaksPerFrame peaks spread over
+//the StoreMinFreq..StoreMaxFreq band each frame
+void MakeSyntheticSong(unsigned int seed,int frames,int peaksPerFrame,std::vector<FreqInfo> &peaks);
+//frames start..start+frames of song moved to time 0,keeping each peak with
+//probability keep and moving the kept ones up to one bin
+void MakeQueryClip(const std::vector<FreqInfo> &song,int start,int frames,double keep,unsigned int seed,
+	std::vector<FreqInfo> &clip);
+
+struct LatencyStats
+{
+	size_t runs;
+	double meanMs;
+	double p50Ms;
+	double p99Ms;
+	double maxMs;
+};
+void SummarizeLatency(std::vector<double> ms,LatencyStats &stats);
+
+//////////////////////////////////////////////////////////////////////
+// SyntheticLibrary
+// Song s of 1..songs is MakeSyntheticSong(s,frames,peaksPerFrame);
+// clips of clipFrames frames come from songs picked at random,through
+// MakeQueryClip with a fifth of the peaks lost. Times queries on a
+// library larger than the songs at hand.
+//////////////////////////////////////////////////////////////////////
+struct SyntheticLibrary
+{
+	int songs;
+	int frames;
+	int peaksPerFrame;
+	int clipFrames;
+};
+//owners is the song each clip was cut from
+void MakeSyntheticClips(const SyntheticLibrary &library,size_t count,unsigned int seed,
+	std::vector<std::vector<FreqInfo> > &clips,std::vector<int> &owners);
+//the library's songs as anchors,song ids 1..songs; index is finished
+void BuildSyntheticAnchorIndex(const SyntheticLibrary &library,CAnchorMemIndex &index);
+
+//votes of one clip,from whatever source the bench compares
+typedef std::function<void(const std::vector<FreqInfo> &clip,std::vector<MatchVote> &votes)> ClipMatcher;
+//match then ScoreVotes on every clip,one latency sample per clip; returns the
+//clips whose best song by starttimeMaxCount is their owner
+size_t BenchClipQueries(const std::vector<std::vector<FreqInfo> > &clips,const std::vector<int> &owners,
+	const ClipMatcher &match,LatencyStats &stats);
+
+//MatchAnchors over every query against source,one latency sample per query
+void BenchAnchorQueries(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,LatencyStats &stats);
+//the same through executor
+void BenchAnchorQueries(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,CQueryExecutor &executor,
+	LatencyStats &stats);
+
+struct ThreadSweepRun
+{
+	size_t threads;
+	LatencyStats latency;
+	//queries scored the same as MatchAnchors on the calling thread
+	size_t sameScores;
+};
+//BenchAnchorQueries through a CQueryExecutor of each run's thread count
+void BenchQueryThreads(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,
+	std::vector<ThreadSweepRun> &runs);
+
+struct EarlyStopReport
+{
+	LatencyStats full;
+	LatencyStats early;
+	//share of query peaks and anchor lookups the early searches skipped
+	double peaksSaved;
+	double anchorsSaved;
+	//queries that ended early,and queries whose best song matched the full search
+	size_t stopped;
+	size_t sameBest;
+};
+//every query searched in full and with MatchEarlyStop; the best song is the one
+//with the largest starttimeMaxCount after ScoreVotes
+void BenchEarlyStop(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,CQueryExecutor &executor,
+	const EarlyStop &stop,EarlyStopReport &report);
+
+struct BatchReport
+{
+	//queries per second looping MatchAnchors and through BatchMatchAnchors
+	double singleQps;
+	double batchQps;
+	BatchStats stats;
+	//queries whose batch votes scored the same as their single votes
+	size_t sameScores;
+};
+void BenchBatchQueries(const std::vector<std::vector<FreqInfo> > &queries,IAnchorSource &source,BatchReport &report);
+//looping MatchHashes against BatchMatchHashes
+void BenchBatchHashQueries(const std::vector<std::vector<FingerprintHash> > &queries,IHashSource &source,
+	BatchReport &report);
+
+struct PostingLayoutReport
+{
+	size_t postings;
+	size_t keys;
+	//posting sections of the raw and the packed segment
+	uint64_t rawBytes;
+	uint64_t packedBytes;
+	//millions of postings a second walking every key's list
+	double rawWalkRate;
+	double packedWalkRate;
+	LatencyStats raw;
+	LatencyStats packed;
+	//clips whose votes scored the same on both
+	size_t sameScores;
+	size_t clips;
+};
+//the library's hashes built as a raw and as a packed CHashSegment; both are
+//walked key by key,then clips of it are matched on each with MatchHashes
+void BenchPostingLayouts(const SyntheticLibrary &library,size_t clips,PostingLayoutReport &report);
+
+//votes for songs 1..songs at random offsets,with every tenth vote for
+//song 1 within a frame of offset 100 so one song stands out
+void MakeRandomVotes(unsigned int seed,size_t count,int songs,std::vector<MatchVote> &votes);
+//ScoreVotes as it was before CVoteScorer,one std::map of offsets per song;
+//the reference the scorer is timed and checked against
+void ScoreVotesMap(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores);
+
+struct VoteScoringReport
+{
+	//milliseconds per call
+	double mapMs;
+	double sortMs;
+	double hashMs;
+	//both CVoteScorer methods gave the map's scores
+	bool same;
+};
+//every method scores votes rounds times
+void BenchVoteScoring(const std::vector<MatchVote> &votes,int rounds,VoteScoringReport &report);
+//votes fed one by one to a CVoteLeader,whose leader and runner-up scores
+//after each vote must match the best +-VoteWindow sums over every centre
+//found by brute force; true if they always did
+bool CheckVoteLeader(const std::vector<MatchVote> &votes);
+
+//a check list test: CountCheckMatches,or the reference below
+typedef int (*CheckMatchCounter)(const CheckPoint *checks,size_t count,int freq,int time_offset);
+//CountCheckMatches as it was before check lists were sorted,a scan of every point
+int CountCheckMatchesLinear(const CheckPoint *checks,size_t count,int freq,int time_offset);
+//counter on the check lists of anchors,probed with each anchor's own targets
+//and with as many points of the same zone that miss; nanoseconds per call
+double BenchCheckMatches(const std::vector<SongAnchor> &anchors,int rounds,CheckMatchCounter counter=CountCheckMatches);
+
+//FindAnchors then GetChecks on every anchor at each freqStep-th freq of the
+//query band; milliseconds taken,points is the check points handed out
+double BenchCheckListLoad(IAnchorSource &source,int freqStep,size_t &points);
+
+//////////////////////////////////////////////////////////////////////
+// BenchStopLists
+// songs indexed as hashes (a CHashTable) and as anchors (a
+// CAnchorMemIndex,stopped by freq); clipsPerSong clips of clipFrames
+// frames from each,made by MakeQueryClip,are searched in both under
+// the stop lists each run asks for,built from the key frequencies of
+// the two indexes. Runs come with their params set,zero params stop
+// nothing. A clip is right when its own song has the best
+// starttimeMaxCount. Song ids are positions in songs plus one.
+//////////////////////////////////////////////////////////////////////
+struct StopListRun
+{
+	StopListParams hashParams;
+	StopListParams anchorParams;
+	//stopped keys and the share of the postings they held
+	size_t hashKeys;
+	double hashShare;
+	size_t anchorFreqs;
+	double anchorShare;
+	LatencyStats hashLatency;
+	LatencyStats anchorLatency;
+	//per query: votes cast by the hash lookups,stored anchors examined
+	double hashVotes;
+	double anchorsChecked;
+	size_t queries;
+	size_t hashRight;
+	size_t anchorRight;
+};
+void BenchStopLists(const std::vector<std::vector<FreqInfo> > &songs,size_t clipsPerSong,int clipFrames,
+	std::vector<StopListRun> &runs,KeyFrequencySummary &hashSummary,KeyFrequencySummary &anchorSummary);
@@ -0,0 +1,86 @@
+#include "QueryExecutor.h"
+
+CQueryExecutor::CQueryExecutor(size_t threads):m_pool(threads)
+{
+	m_workers.resize(m_pool.Threads());
+}
+
+void CQueryExecutor::RunChunks(size_t begin,size_t end,IAnchorSource &source)
+{
+	for(auto i=m_workers.begin();i!=m_workers.end();++i)
+	{
+		i->votes.clear();
+		i->anchorsChecked=0;
+	}
+	auto matchChunk=[&](size_t slot,size_t chunk)
+	{
+		size_t first=(begin+chunk)*QueryChunkPeaks;
+		size_t last=first+QueryChunkPeaks<m_peaks.size()?first+QueryChunkPeaks:m_peaks.size();
+		WorkerVotes &worker=m_workers[slot];
+		worker.anchorsChecked+=MatchAnchorPeaks(m_peaks,first,last,source,worker.votes);
+	};
+	if(source.SharedReads())
+		m_pool.Run(end-begin,matchChunk);
+	else
+	{
+		for(size_t chunk=0;chunk<end-begin;chunk++)
+			matchChunk(0,chunk);
+	}
+}
+
+size_t CQueryExecutor::Match(const std::vector<FreqInfo> &freqinfos,IAnchorSource &source,std::vector<MatchVote> &votes)
+{
+	if(!source.SharedReads() || m_pool.Threads()==1)
+		return MatchAnchors(freqinfos,source,votes);
+
+	SelectQueryPeaks(freqinfos,m_peaks);
+	RunChunks(0,(m_peaks.size()+QueryChunkPeaks-1)/QueryChunkPeaks,source);
+
+	size_t total=0;
+	size_t maybecount=0;
+	for(auto i=m_workers.begin();i!=m_workers.end();++i)
+	{
+		total+=i->votes.size();
+		maybecount+=i->anchorsChecked;
+	}
+	votes.clear();
+	votes.reserve(total);
+	for(auto i=m_workers.begin();i!=m_workers.end();++i)
+		votes.insert(votes.end(),i->votes.begin(),i->votes.end());
+	return maybecount;
+}
+
+void CQueryExecutor::MatchEarlyStop(const std::vector<FreqInfo> &freqinfos,IAnchorSource &source,const EarlyStop &stop,
+	std::vector<MatchVote> &votes,QueryProgress &progress,const CSongTombstones *deleted)
+{
+	SelectQueryPeaks(freqinfos,m_peaks);
+	m_leader.Reset();
+	votes.clear();
+	progress.peaks=m_peaks.size();
+	progress.peaksUsed=0;
+	progress.anchorsChecked=0;
+	progress.stopped=false;
+
+	size_t chunks=(m_peaks.size()+QueryChunkPeaks-1)/QueryChunkPeaks;
+	size_t round=source.SharedReads()?m_pool.Threads():1;
+	for(size_t begin=0;begin<chunks && !progress.stopped;begin+=round)
+	{
+		size_t end=begin+round<chunks?begin+round:chunks;
+		RunChunks(begin,end,source);
+		for(auto i=m_workers.begin();i!=m_workers.end();++i)
+		{
+			progress.anchorsChecked+=i->anchorsChecked;
+			if(deleted && !deleted->Empty())
+				DropDeletedVotes(*deleted,i->votes);
+			for(auto v=i->votes.begin();v!=i->votes.end();++v)
+				m_leader.Add(*v);
+			votes.insert(votes.end(),i->votes.begin(),i->votes.end());
+		}
+		progress.peaksUsed=end*QueryChunkPeaks<m_peaks.size()?end*QueryChunkPeaks:m_peaks.size();
+		progress.stopped=stop.minScore>0 && progress.peaksUsed<m_peaks.size() &&
+			m_leader.LeaderScore()>=stop.minScore && m_leader.LeaderScore()-m_leader.RunnerScore()>=stop.minMargin;
+	}
+	progress.leader=m_leader.Leader();
+	progress.leaderScore=m_leader.LeaderScore();
+	progress.runnerScore=m_leader.RunnerScore();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "AnchorIndex.h"
+#include "SongTombstones.h"
+#include "WorkerPool.h"
+
+//query peaks handed to a worker at a time
+const size_t QueryChunkPeaks=4;
+
+struct EarlyStop
+{
+	//aligned votes (see CVoteLeader) the leading song needs; 0 never stops early
+	int minScore;
+	//and its lead over the second song
+	int minMargin;
+};
+
+struct QueryProgress
+{
+	//query peaks in the band,and those matched before the search ended
+	size_t peaks;
+	size_t peaksUsed;
+	size_t anchorsChecked;
+	bool stopped;
+	int leader;
+	int leaderScore;
+	int runnerScore;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CQueryExecutor
+// MatchAnchors spread over a worker pool. The query peaks are cut into
+// chunks of QueryChunkPeaks; each worker votes into its own buffer and
+// the buffers are joined once all chunks are done. Sources without
+// SharedReads run on the calling thread alone.
+//////////////////////////////////////////////////////////////////////
+class CQueryExecutor
+{
+public:
+	//threads as for CWorkerPool
+	explicit CQueryExecutor(size_t threads=0);
+
+	size_t Threads() const { return m_pool.Threads(); }
+	//same votes as MatchAnchors,in a different order
+	size_t Match(const std::vector<FreqInfo> &freqinfos,IAnchorSource &source,std::vector<MatchVote> &votes);
+	//the peaks in time order,one round of Threads() chunks at a time; after each
+	//round the search ends if the leading song satisfies stop,and votes holds
+	//the votes of the peaks matched so far. Votes for deleted songs are dropped
+	//before they reach the leader,so a deleted song never ends the search
+	void MatchEarlyStop(const std::vector<FreqInfo> &freqinfos,IAnchorSource &source,const EarlyStop &stop,
+		std::vector<MatchVote> &votes,QueryProgress &progress,const CSongTombstones *deleted=nullptr);
+private:
+	//chunks [begin,end) of m_peaks into the worker buffers
+	void RunChunks(size_t begin,size_t end,IAnchorSource &source);
+
+	struct WorkerVotes
+	{
+		std::vector<MatchVote> votes;
+		size_t anchorsChecked;
+		//keeps the slots of two workers off one cache line
+		char pad[64];
+	};
+	CWorkerPool m_pool;
+	std::vector<FreqInfo> m_peaks;
+	std::vector<WorkerVotes> m_workers;
+	CVoteLeader m_leader;
+};
@@ -0,0 +1,767 @@
+#include "StdAfx.h"
+#include "SegmentedIndex.h"
+#include <algorithm>
+#include <chrono>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static const char ManifestTag[]="FWSI";
+//starts the deleted song ids in the manifest
+static const char ManifestDead[]="dead";
+
+//size tier of a segment,0 for what one memtable flush makes
+static int SegmentTier(uint64_t postings)
+{
+	int tier=0;
+	for(uint64_t limit=MemtableFlushPostings;postings>limit;limit*=SegmentMergeFanIn)
+		tier++;
+	return tier;
+}
+
+IndexSegment::~IndexSegment()
+{
+	file.Close();
+	if(obsolete)
+		DeleteFileW(path);
+}
+
+CHashIndexSnapshot::CHashIndexSnapshot(CEpochManager &epochs,const CRcuCell<IndexVersion> &version):m_guard(epochs),
+	m_tombstones(nullptr)
+{
+	const IndexVersion *current=version.Read();
+	if(!current)
+		return;
+	m_tombstones=current->tombstones.get();
+	//a reader of each segment,since packed ones decode into their reader
+	m_readers.resize(current->segments.size()+current->memtables.size());
+	size_t r=0;
+	for(auto i=current->segments.begin();i!=current->segments.end();++i)
+		m_readers[r++].Attach((*i)->Data(),(*i)->Size());
+	for(auto i=current->memtables.begin();i!=current->memtables.end();++i)
+		m_readers[r++].Attach((*i)->Data(),(*i)->Size());
+}
+
+size_t CHashIndexSnapshot::FindHash(uint32_t key,const HashPosting **postings)
+{
+	//a key found in a single segment is handed back without a copy
+	const HashPosting *only=nullptr;
+	size_t onlyCount=0;
+	m_found.clear();
+	for(auto i=m_readers.begin();i!=m_readers.end();++i)
+	{
+		const HashPosting *found=nullptr;
+		size_t count=i->FindHash(key,&found);
+		if(!count)
+			continue;
+		if(!only && m_found.empty())
+		{
+			only=found;
+			onlyCount=count;
+			continue;
+		}
+		if(only)
+		{
+			m_found.assign(only,only+onlyCount);
+			only=nullptr;
+		}
+		m_found.insert(m_found.end(),found,found+count);
+	}
+	if(only)
+	{
+		*postings=only;
+		return onlyCount;
+	}
+	*postings=m_found.empty()?nullptr:&m_found[0];
+	return m_found.size();
+}
+
+void CHashIndexSnapshot::Match(const std::vector<FingerprintHash> &query,std::vector<MatchVote> &votes)
+{
+	MatchHashes(query,*this,votes);
+	if(m_tombstones)
+		DropDeletedVotes(*m_tombstones,votes);
+}
+
+void CHashIndexSnapshot::CountKeys(CKeyFrequencyCounter &counter)
+{
+	for(auto i=m_readers.begin();i!=m_readers.end();++i)
+		counter.AddSegment(*i,m_tombstones);
+}
+
+CSegmentedHashIndex::CSegmentedHashIndex():m_packed(false),m_version(m_epochs),m_memPostings(0),m_stoppedPostings(0),
+	m_hotKeys(0),m_sketchChanged(false),m_stopListChanged(false),m_nextNumber(1),
+	m_flushAsked(false),m_compactAsked(false),m_working(false),m_stop(false),m_failed(false),m_flushes(0),m_merges(0),
+	m_flushBytes(0),m_mergeBytes(0),m_droppedPostings(0)
+{
+	memset(&m_hotKeyLimits,0,sizeof(m_hotKeyLimits));
+}
+
+CSegmentedHashIndex::~CSegmentedHashIndex()
+{
+	Close();
+}
+
+CAtlString CSegmentedHashIndex::SegmentPath(uint32_t number) const
+{
+	CAtlString path;
+	path.Format(_T("%s\\%08u.seg"),(LPCTSTR)m_dir,number);
+	return path;
+}
+
+bool CSegmentedHashIndex::Open(LPCWSTR dir,bool packed)
+{
+	if(IsOpen())
+		return true;
+	m_dir=dir;
+	m_packed=packed;
+	CreateDirectoryW(dir,NULL);
+
+	//manifest: the tag,the segment numbers oldest first,then ManifestDead
+	//and the deleted song ids
+	std::vector<uint32_t> numbers;
+	std::shared_ptr<CSongTombstones> tombstones=std::make_shared<CSongTombstones>();
+	bool listed=false;
+	{
+		CMappedFile manifest;
+		if(manifest.Open(m_dir+L"\\manifest"))
+		{
+			listed=true;
+			std::string text((const char*)manifest.Data(),manifest.Size());
+			if(text.compare(0,sizeof(ManifestTag)-1,ManifestTag))
+				return false;
+			const char *pos=text.c_str()+sizeof(ManifestTag)-1;
+			bool dead=false;
+			for(;;)
+			{
+				while(*pos=='\n' || *pos=='\r' || *pos==' ')
+					pos++;
+				if(!strncmp(pos,ManifestDead,sizeof(ManifestDead)-1))
+				{
+					dead=true;
+					pos+=sizeof(ManifestDead)-1;
+					continue;
+				}
+				char *next;
+				unsigned long number=strtoul(pos,&next,10);
+				if(next==pos)
+					break;
+				if(dead)
+					tombstones->Add((int)number);
+				else
+					numbers.push_back((uint32_t)number);
+				pos=next;
+			}
+		}
+	}
+	IndexVersion *version=new IndexVersion;
+	version->tombstones=tombstones;
+	uint32_t nextNumber=1;
+	for(auto i=numbers.begin();i!=numbers.end();++i)
+	{
+		std::shared_ptr<IndexSegment> segment=std::make_shared<IndexSegment>();
+		segment->number=*i;
+		segment->path=SegmentPath(*i);
+		CHashSegment reader;
+		if(!segment->file.Open(segment->path) || !reader.Attach(segment->file.Data(),segment->file.Size()))
+		{
+			delete version;
+			return false;
+		}
+		segment->postings=reader.PostingCount();
+		version->segments.push_back(segment);
+		nextNumber=std::max(nextNumber,*i+1);
+	}
+	//segment files the manifest doesn't list were cut short by a crash or
+	//merged away while a snapshot still had them
+	WIN32_FIND_DATAW found;
+	HANDLE find=FindFirstFileW(m_dir+L"\\*.seg",&found);
+	if(find!=INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			uint32_t number=(uint32_t)wcstoul(found.cFileName,nullptr,10);
+			if(std::find(numbers.begin(),numbers.end(),number)==numbers.end())
+				DeleteFileW(m_dir+L"\\"+found.cFileName);
+			nextNumber=std::max(nextNumber,number+1);
+		}
+		while(FindNextFileW(find,&found));
+		FindClose(find);
+	}
+
+	{
+		CMappedFile stopList;
+		if(!stopList.Open(m_dir+L"\\stoplist") || !m_stopList.Load(stopList.Data(),stopList.Size()))
+			m_stopList.Clear();
+	}
+	//a sketch left without a manifest counted segments that are gone
+	{
+		CMappedFile sketch;
+		bool loaded=listed && sketch.Open(m_dir+L"\\sketch") && m_sketch.Load(sketch.Data(),sketch.Size());
+		if(!loaded)
+		{
+			m_sketch.Clear();
+			for(auto i=version->segments.begin();i!=version->segments.end();++i)
+			{
+				CHashSegment reader;
+				reader.Attach((*i)->Data(),(*i)->Size());
+				for(size_t k=0;k<reader.KeyCount();k++)
+				{
+					const HashPosting *postings=nullptr;
+					m_sketch.Add(reader.Key(k),(uint32_t)reader.KeyPostings(k,&postings));
+				}
+			}
+		}
+		m_sketchChanged=!loaded;
+	}
+
+	m_version.Publish(version);
+	m_memtable=CHashTable();
+	m_memPostings=0;
+	m_stoppedPostings=0;
+	memset(&m_hotKeyLimits,0,sizeof(m_hotKeyLimits));
+	m_hotKeys=0;
+	m_stopListChanged=false;
+	m_nextNumber=nextNumber;
+	m_flushAsked=false;
+	m_compactAsked=false;
+	m_working=false;
+	m_stop=false;
+	m_failed=false;
+	m_flushes=0;
+	m_merges=0;
+	m_flushBytes=0;
+	m_mergeBytes=0;
+	m_droppedPostings=0;
+	m_thread=std::thread(&CSegmentedHashIndex::Run,this);
+	return true;
+}
+
+void CSegmentedHashIndex::Close()
+{
+	if(!IsOpen())
+		return;
+	Flush();
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop=true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+	//no snapshot is left,so the last version goes at once
+	m_version.Publish(nullptr);
+	m_epochs.Reclaim();
+}
+
+void CSegmentedHashIndex::AddSong(int song_id,const std::vector<FreqInfo> &freqinfos)
+{
+	std::vector<FingerprintHash> hashes;
+	GenerateHashes(freqinfos,HashMaxFanout,hashes);
+	AddHashes(song_id,hashes);
+}
+
+void CSegmentedHashIndex::AddHashes(int song_id,const std::vector<FingerprintHash> &hashes)
+{
+	if(!IsOpen())
+		return;
+	//a key's hashes come together,as GenerateHashes sorts them by key
+	double limit=0;
+	if(m_hotKeyLimits.maxMeanMultiple>0 && m_sketch.Total()>=MemtablePublishPostings)
+		limit=m_sketch.MeanCount()*m_hotKeyLimits.maxMeanMultiple;
+	if(m_hotKeyLimits.maxPostings && (!limit || m_hotKeyLimits.maxPostings<limit))
+		limit=(double)m_hotKeyLimits.maxPostings;
+	for(auto i=hashes.begin();i!=hashes.end();)
+	{
+		auto next=i+1;
+		while(next!=hashes.end() && next->key==i->key)
+			++next;
+		m_sketch.Add(i->key,(uint32_t)(next-i));
+		if(limit>0)
+		{
+			uint32_t estimate=m_sketch.Estimate(i->key);
+			if(estimate>limit && m_stopList.Insert(i->key,estimate))
+			{
+				m_hotKeys++;
+				m_stopListChanged=true;
+			}
+		}
+		i=next;
+	}
+	m_sketchChanged=m_sketchChanged || !hashes.empty();
+	if(!m_stopList.Empty())
+	{
+		std::vector<FingerprintHash> kept(hashes);
+		m_stoppedPostings+=RemoveStoppedHashes(m_stopList,kept);
+		m_memtable.AddSong(song_id,kept);
+		m_memPostings+=kept.size();
+	}
+	else
+	{
+		m_memtable.AddSong(song_id,hashes);
+		m_memPostings+=hashes.size();
+	}
+	if(m_memPostings>=MemtablePublishPostings)
+		Publish();
+}
+
+void CSegmentedHashIndex::Publish()
+{
+	if(!IsOpen() || !m_memPostings)
+		return;
+	CHashSegmentBuilder builder;
+	const CHashTable::PostingMap &postings=m_memtable.Postings();
+	for(auto i=postings.begin();i!=postings.end();++i)
+	{
+		for(auto p=i->second.begin();p!=i->second.end();++p)
+			builder.AddPosting(i->first,p->song_id,p->time);
+	}
+	std::shared_ptr<IndexSegment> memtable=std::make_shared<IndexSegment>();
+	builder.Build(memtable->image);
+	memtable->postings=m_memPostings;
+	m_memtable=CHashTable();
+	m_memPostings=0;
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		//the writer is behind; holding the adder back bounds the memory
+		m_idle.wait(lock,[this]()
+		{
+			return m_version.Read()->memPostings<MaxMemtablePostings || m_failed;
+		});
+		IndexVersion *next=new IndexVersion(*m_version.Read());
+		next->memtables.push_back(memtable);
+		next->memPostings+=memtable->postings;
+		m_version.Publish(next);
+		if(next->memPostings>=MemtableFlushPostings)
+			m_wake.notify_one();
+	}
+	m_epochs.Reclaim();
+}
+
+void CSegmentedHashIndex::Flush()
+{
+	if(!IsOpen())
+		return;
+	Publish();
+	SaveKeyCounts();
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_flushAsked=true;
+	}
+	m_wake.notify_one();
+}
+
+void CSegmentedHashIndex::SaveKeyCounts()
+{
+	//saved ahead of the memtables they count; a crash before those are
+	//written leaves estimates high,never low
+	std::vector<uint8_t> image;
+	if(m_sketchChanged)
+	{
+		m_sketch.Save(image);
+		m_sketchChanged=!WriteWholeFile(m_dir+L"\\sketch",&image[0],image.size());
+	}
+	if(m_stopListChanged)
+	{
+		m_stopList.Save(image);
+		m_stopListChanged=!WriteWholeFile(m_dir+L"\\stoplist",&image[0],image.size());
+	}
+}
+
+bool CSegmentedHashIndex::DeleteSong(int song_id)
+{
+	if(!IsOpen())
+		return false;
+	bool written;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		const IndexVersion *current=m_version.Read();
+		if(current->tombstones->Contains(song_id))
+			return true;
+		std::shared_ptr<CSongTombstones> tombstones=std::make_shared<CSongTombstones>(*current->tombstones);
+		tombstones->Add(song_id);
+		IndexVersion *next=new IndexVersion(*current);
+		next->tombstones=tombstones;
+		written=WriteManifest(*next);
+		m_version.Publish(next);
+	}
+	m_epochs.Reclaim();
+	return written;
+}
+
+bool CSegmentedHashIndex::SetStopList(const CKeyStopList &stop)
+{
+	if(!IsOpen())
+		return false;
+	m_stopList=stop;
+	m_stopListChanged=false;
+	CAtlString path=m_dir+L"\\stoplist";
+	if(stop.Empty())
+	{
+		DeleteFileW(path);
+		return true;
+	}
+	std::vector<uint8_t> image;
+	stop.Save(image);
+	return WriteWholeFile(path,&image[0],image.size());
+}
+
+void CSegmentedHashIndex::Compact()
+{
+	if(!IsOpen())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_compactAsked=true;
+	}
+	m_wake.notify_one();
+}
+
+void CSegmentedHashIndex::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_idle.wait(lock,[this]()
+	{
+		return (!m_working && !m_flushAsked && !m_compactAsked) || m_failed;
+	});
+}
+
+std::unique_ptr<CHashIndexSnapshot> CSegmentedHashIndex::Snapshot()
+{
+	return std::unique_ptr<CHashIndexSnapshot>(new CHashIndexSnapshot(m_epochs,m_version));
+}
+
+SegmentedIndexStats CSegmentedHashIndex::Stats()
+{
+	SegmentedIndexStats stats;
+	memset(&stats,0,sizeof(stats));
+	size_t own=m_memPostings;
+	stats.memtables=own?1:0;
+	stats.memPostings=own;
+	std::lock_guard<std::mutex> lock(m_lock);
+	const IndexVersion *version=m_version.Read();
+	if(version)
+	{
+		stats.segments=version->segments.size();
+		for(auto i=version->segments.begin();i!=version->segments.end();++i)
+		{
+			stats.segmentPostings+=(*i)->postings;
+			stats.segmentBytes+=(*i)->Size();
+		}
+		stats.memtables+=version->memtables.size();
+		stats.memPostings+=(size_t)version->memPostings;
+		stats.deletedSongs=version->tombstones->Count();
+	}
+	stats.failed=m_failed;
+	stats.flushes=m_flushes;
+	stats.merges=m_merges;
+	stats.flushBytes=m_flushBytes;
+	stats.mergeBytes=m_mergeBytes;
+	stats.droppedPostings=m_droppedPostings;
+	stats.stoppedKeys=m_stopList.Count();
+	stats.stoppedPostings=m_stoppedPostings;
+	stats.hotKeys=m_hotKeys;
+	stats.sketchPostings=m_sketch.Total();
+	stats.sketchKeys=m_sketch.DistinctKeys();
+	return stats;
+}
+
+std::vector<std::shared_ptr<IndexSegment> > CSegmentedHashIndex::PickMerge(const IndexVersion &version) const
+{
+	std::vector<std::shared_ptr<IndexSegment> > merge;
+	int best=INT_MAX;
+	std::vector<size_t> counts;
+	for(auto i=version.segments.begin();i!=version.segments.end();++i)
+	{
+		size_t tier=(size_t)SegmentTier((*i)->postings);
+		if(tier>=counts.size())
+			counts.resize(tier+1,0);
+		if(++counts[tier]>=SegmentMergeFanIn && (int)tier<best)
+			best=(int)tier;
+	}
+	if(best==INT_MAX)
+		return merge;
+	for(auto i=version.segments.begin();i!=version.segments.end() && merge.size()<SegmentMergeFanIn;++i)
+	{
+		if(SegmentTier((*i)->postings)==best)
+			merge.push_back(*i);
+	}
+	return merge;
+}
+
+std::shared_ptr<IndexSegment> CSegmentedHashIndex::WriteSegment(CHashSegmentBuilder &builder,uint64_t &bytes)
+{
+	std::vector<uint8_t> image;
+	builder.Build(image,m_packed);
+	builder.Clear();
+	bytes=image.size();
+	std::shared_ptr<IndexSegment> segment=std::make_shared<IndexSegment>();
+	segment->number=m_nextNumber++;
+	segment->path=SegmentPath(segment->number);
+	if(!WriteWholeFile(segment->path,&image[0],image.size()))
+		return nullptr;
+	//a file written but not listed is removed by the next Open
+	segment->obsolete=true;
+	CHashSegment reader;
+	if(!segment->file.Open(segment->path) || !reader.Attach(segment->file.Data(),segment->file.Size()))
+		return nullptr;
+	segment->postings=reader.PostingCount();
+	segment->obsolete=false;
+	return segment;
+}
+
+bool CSegmentedHashIndex::WriteManifest(const IndexVersion &version)
+{
+	std::string text(ManifestTag);
+	char number[16];
+	for(auto i=version.segments.begin();i!=version.segments.end();++i)
+	{
+		sprintf_s(number,"\n%u",(*i)->number);
+		text+=number;
+	}
+	std::vector<int> dead;
+	version.tombstones->Ids(dead);
+	if(!dead.empty())
+	{
+		text+="\n";
+		text+=ManifestDead;
+	}
+	for(auto i=dead.begin();i!=dead.end();++i)
+	{
+		sprintf_s(number,"\n%d",*i);
+		text+=number;
+	}
+	text+="\n";
+	return WriteWholeFile(m_dir+L"\\manifest",text.c_str(),text.size());
+}
+
+void CSegmentedHashIndex::Run()
+{
+	for(;;)
+	{
+		//the published memtables to write out,or the segment files to merge
+		std::vector<std::shared_ptr<IndexSegment> > flush;
+		std::vector<std::shared_ptr<IndexSegment> > merge;
+		std::shared_ptr<const CSongTombstones> tombstones;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			for(;;)
+			{
+				//versions only change under the lock,so this one stays put
+				const IndexVersion *version=m_version.Read();
+				tombstones=version->tombstones;
+				if(!version->memtables.empty() &&
+					(m_flushAsked || m_stop || version->memPostings>=MemtableFlushPostings))
+				{
+					flush=version->memtables;
+					m_flushAsked=false;
+					break;
+				}
+				m_flushAsked=false;
+				//merges are left for the next Open once closing
+				if(!m_stop && m_compactAsked &&
+					(version->segments.size()>1 || (!version->segments.empty() && !version->tombstones->Empty())))
+					merge=version->segments;
+				else if(!m_stop)
+					merge=PickMerge(*version);
+				m_compactAsked=false;
+				if(!merge.empty())
+					break;
+				m_working=false;
+				m_idle.notify_all();
+				if(m_stop)
+					return;
+				m_wake.wait(lock);
+			}
+			m_working=true;
+		}
+
+		CHashSegmentBuilder builder;
+		uint64_t dropped=0;
+		const std::vector<std::shared_ptr<IndexSegment> > &inputs=flush.empty()?merge:flush;
+		for(auto i=inputs.begin();i!=inputs.end();++i)
+		{
+			CHashSegment reader;
+			reader.Attach((*i)->Data(),(*i)->Size());
+			for(size_t k=0;k<reader.KeyCount();k++)
+			{
+				const HashPosting *postings=nullptr;
+				size_t count=reader.KeyPostings(k,&postings);
+				for(size_t p=0;p<count;p++)
+				{
+					if(tombstones->Contains(postings[p].song_id))
+						dropped++;
+					else
+						builder.AddPosting(reader.Key(k),postings[p].song_id,postings[p].time);
+				}
+			}
+		}
+		//nothing is written when every posting belonged to a deleted song
+		uint64_t bytes=0;
+		bool written=true;
+		std::shared_ptr<IndexSegment> segment;
+		if(builder.PostingCount())
+		{
+			segment=WriteSegment(builder,bytes);
+			written=segment!=nullptr;
+		}
+
+		std::unique_lock<std::mutex> lock(m_lock);
+		IndexVersion *next=nullptr;
+		if(written)
+		{
+			//only this thread changes the segment files of a version,and
+			//publishers only append memtables,so the flushed ones are the oldest
+			next=new IndexVersion(*m_version.Read());
+			std::vector<std::shared_ptr<IndexSegment> > &segments=next->segments;
+			segments.erase(std::remove_if(segments.begin(),segments.end(),[&merge](const std::shared_ptr<IndexSegment> &s)
+			{
+				return std::find(merge.begin(),merge.end(),s)!=merge.end();
+			}),segments.end());
+			if(segment)
+				segments.push_back(segment);
+			for(auto i=flush.begin();i!=flush.end();++i)
+				next->memPostings-=(*i)->postings;
+			next->memtables.erase(next->memtables.begin(),next->memtables.begin()+flush.size());
+			if(!WriteManifest(*next))
+			{
+				delete next;
+				next=nullptr;
+			}
+		}
+		if(!next)
+		{
+			//the memtables stay published and queried; nothing more is
+			//written until the index is opened again
+			if(segment)
+				segment->obsolete=true;
+			m_working=false;
+			m_failed=true;
+			m_idle.notify_all();
+			m_wake.wait(lock,[this]()
+			{
+				return m_stop;
+			});
+			return;
+		}
+		for(auto i=merge.begin();i!=merge.end();++i)
+			(*i)->obsolete=true;
+		m_version.Publish(next);
+		if(!flush.empty())
+		{
+			m_flushes++;
+			m_flushBytes+=bytes;
+		}
+		else
+		{
+			m_merges++;
+			m_mergeBytes+=bytes;
+		}
+		m_droppedPostings+=dropped;
+		m_idle.notify_all();
+		lock.unlock();
+		flush.clear();
+		merge.clear();
+		m_epochs.Reclaim();
+	}
+}
+
+void StressSegmentedIndex(LPCWSTR dir,size_t readers,size_t songs,IndexStressReport &report)
+{
+	const int frames=600;
+	memset(&report,0,sizeof(report));
+	//without a manifest Open removes every segment file left there
+	CAtlString manifest(dir);
+	manifest+=L"\\manifest";
+	DeleteFileW(manifest);
+	CSegmentedHashIndex index;
+	if(!index.Open(dir))
+		return;
+
+	//songs up to this id are published
+	std::atomic<int> visible(0);
+	std::atomic<bool> done(false);
+	std::vector<std::vector<double> > ms(readers);
+	std::vector<size_t> wrong(readers,0);
+	std::vector<std::thread> threads;
+	for(size_t r=0;r<readers;r++)
+	{
+		threads.push_back(std::thread([&,r]()
+		{
+			std::vector<FreqInfo> song;
+			std::vector<FreqInfo> clip;
+			std::vector<FingerprintHash> query;
+			std::vector<MatchVote> votes;
+			CVoteScorer scorer;
+			std::vector<SongScore> scores;
+			unsigned int seed=(unsigned int)r*7919+1;
+			while(!done)
+			{
+				int last=visible;
+				if(!last)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				int song_id=1+(int)(seed%(unsigned int)last);
+				MakeSyntheticSong(song_id,frames,2,song);
+				MakeQueryClip(song,frames/3,100,0.8,seed,clip);
+				GenerateHashes(clip,0,query);
+				auto start=std::chrono::steady_clock::now();
+				{
+					std::unique_ptr<CHashIndexSnapshot> snapshot=index.Snapshot();
+					MatchHashes(query,*snapshot,votes);
+				}
+				scorer.Score(votes,scores);
+				ms[r].push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count());
+				int best=0;
+				int bestScore=0;
+				for(auto i=scores.begin();i!=scores.end();++i)
+				{
+					if(i->starttimeMaxCount>bestScore)
+					{
+						bestScore=i->starttimeMaxCount;
+						best=i->song_id;
+					}
+				}
+				if(best!=song_id)
+					wrong[r]++;
+				seed=seed*1103515245+12345;
+			}
+		}));
+	}
+
+	auto start=std::chrono::steady_clock::now();
+	std::vector<FreqInfo> song;
+	for(size_t s=1;s<=songs;s++)
+	{
+		MakeSyntheticSong((unsigned int)s,frames,2,song);
+		index.AddSong((int)s,song);
+		//a few songs at a time,so readers see a moving library
+		if(s%8==0 || s==songs)
+		{
+			index.Publish();
+			visible=(int)s;
+		}
+	}
+	index.Flush();
+	index.WaitIdle();
+	double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	done=true;
+	for(auto i=threads.begin();i!=threads.end();++i)
+		i->join();
+
+	std::vector<double> all;
+	for(size_t r=0;r<readers;r++)
+	{
+		all.insert(all.end(),ms[r].begin(),ms[r].end());
+		report.wrong+=wrong[r];
+	}
+	report.songs=songs;
+	report.songsPerSecond=seconds>0?songs/seconds:0;
+	report.queries=all.size();
+	SummarizeLatency(all,report.latency);
+	report.index=index.Stats();
+	report.epochs=index.Epochs();
+	index.Close();
+}
@@ -0,0 +1,243 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CountMinSketch.h"
+#include "Epoch.h"
+#include "HashSegment.h"
+#include "MappedFile.h"
+#include "QueryBench.h"
+#include "SongTombstones.h"
+#include "StopList.h"
+
+//postings the adding thread gathers before publishing them to new snapshots
+const size_t MemtablePublishPostings=1<<16;
+//published postings written out together as one segment
+const size_t MemtableFlushPostings=1<<20;
+//published postings not written yet before AddSong holds back
+const size_t MaxMemtablePostings=2*MemtableFlushPostings;
+//a tier is merged into one segment once it holds this many; tier t takes
+//segments up to MemtableFlushPostings*SegmentMergeFanIn^t postings
+const size_t SegmentMergeFanIn=4;
+
+struct SegmentedIndexStats
+{
+	size_t segments;
+	//the adding thread's memtable and the published ones not written yet
+	size_t memtables;
+	size_t memPostings;
+	uint64_t segmentPostings;
+	uint64_t segmentBytes;
+	size_t flushes;
+	size_t merges;
+	//bytes written by flushes and by merges,their ratio is the write amplification
+	uint64_t flushBytes;
+	uint64_t mergeBytes;
+	//a segment or the manifest could not be written; the writer has stopped
+	bool failed;
+	size_t deletedSongs;
+	//postings of deleted songs left out by flushes and merges
+	uint64_t droppedPostings;
+	//keys on the stop list,and the postings under them AddHashes left out
+	size_t stoppedKeys;
+	uint64_t stoppedPostings;
+	//keys AddHashes put on the stop list as they passed the hot key limits
+	size_t hotKeys;
+	//postings counted by the sketch and the distinct keys it estimates
+	uint64_t sketchPostings;
+	double sketchKeys;
+};
+
+//a segment of the index: a file,or a published memtable held in memory
+//as an unpacked segment image. A file is deleted once a merge has
+//replaced it and the last version listing it is reclaimed
+struct IndexSegment
+{
+	IndexSegment():number(0),postings(0),obsolete(false){}
+	~IndexSegment();
+
+	const void *Data() const { return image.empty()?file.Data():&image[0]; }
+	size_t Size() const { return image.empty()?file.Size():image.size(); }
+
+	CAtlString path;
+	//0 for a memtable
+	uint32_t number;
+	CMappedFile file;
+	std::vector<uint8_t> image;
+	uint64_t postings;
+	bool obsolete;
+};
+
+//the segments a snapshot sees; a published version is never changed,
+//the next one is a changed copy
+struct IndexVersion
+{
+	IndexVersion():memPostings(0){}
+
+	//segment files,oldest first
+	std::vector<std::shared_ptr<IndexSegment> > segments;
+	//published memtables not written yet,oldest first
+	std::vector<std::shared_ptr<IndexSegment> > memtables;
+	uint64_t memPostings;
+	//songs deleted since their postings were written
+	std::shared_ptr<const CSongTombstones> tombstones;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CHashIndexSnapshot
+// The version published when it was taken,queried as one source:
+// FindHash gathers a key's postings from each segment,Match also drops
+// the votes of songs deleted by then. It holds an epoch
+// slot for its life,so nothing it sees is freed,and takes no lock. A
+// snapshot is used by one thread at a time and must be gone before its
+// index is closed.
+//////////////////////////////////////////////////////////////////////
+class CHashIndexSnapshot:public IHashSource
+{
+public:
+	CHashIndexSnapshot(CEpochManager &epochs,const CRcuCell<IndexVersion> &version);
+
+	size_t SegmentCount() const { return m_readers.size(); }
+	size_t FindHash(uint32_t key,const HashPosting **postings);
+	//MatchHashes without the votes of deleted songs
+	void Match(const std::vector<FingerprintHash> &query,std::vector<MatchVote> &votes);
+	//the keys of every segment,less the postings of deleted songs
+	void CountKeys(CKeyFrequencyCounter &counter);
+private:
+	CEpochGuard m_guard;
+	const CSongTombstones *m_tombstones;
+	std::vector<CHashSegment> m_readers;
+	std::vector<HashPosting> m_found;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CSegmentedHashIndex
+// Hash postings kept as immutable segment files plus memtables. The
+// adding thread gathers postings in a table of its own and publishes
+// them every MemtablePublishPostings as an in-memory segment. A
+// background writer turns the published memtables into a segment file
+// and merges files of the same size tier SegmentMergeFanIn at a time, so
+// a query fans out over a number of segments that grows with the log of
+// the library. The segment list and the deleted songs are kept in a
+// manifest file next to the segments, rewritten whole after each flush,
+// merge or delete. A deleted song's postings are left out of the next
+// flush or merge that reads them; Compact merges everything to drop all.
+// Every change publishes a new IndexVersion through an RCU cell; the
+// old one is reclaimed by epoch once no snapshot can still hold it.
+// Readers never lock. AddSong,Publish and Flush are called from one
+// thread; the publishers and the writer serialize on a lock of their own.
+// Keys on the stop list (saved as "stoplist" in dir) are not added;
+// postings already written under them stay until queries skip them.
+// Every key AddHashes is given is counted in a count-min sketch (saved as
+// "sketch" by Flush,rebuilt from the segments if missing),stopped keys
+// and deleted songs included,so its estimates only ever run high. With
+// hot key limits set,a key whose estimate passes them goes on the stop
+// list there and then instead of waiting for the next stop list build.
+//////////////////////////////////////////////////////////////////////
+class CSegmentedHashIndex
+{
+public:
+	CSegmentedHashIndex();
+	~CSegmentedHashIndex();
+
+	//maps the segments of dir (created if missing) and starts the writer;
+	//packed segments store their postings with EncodePostings,about a third
+	//of the size but decoded on every lookup,so raw is the default
+	bool Open(LPCWSTR dir,bool packed=false);
+	//writes the memtables out; merges still due wait for the next Open
+	void Close();
+	bool IsOpen() const { return m_thread.joinable(); }
+
+	void AddSong(int song_id,const std::vector<FreqInfo> &freqinfos);
+	void AddHashes(int song_id,const std::vector<FingerprintHash> &hashes);
+	//makes the songs added so far visible to new snapshots
+	void Publish();
+	//publishes and has the writer write every memtable out
+	void Flush();
+	//returns once no flush is asked for and no tier is due a merge
+	void WaitIdle();
+	//snapshots taken from now on drop the song's votes; false if the
+	//delete could not be written to the manifest and holds until Close only
+	bool DeleteSong(int song_id);
+	//has the writer merge every segment file into one
+	void Compact();
+	//keys AddHashes leaves out from now on,an empty list stops none; saved
+	//with the index. Called from the adding thread
+	bool SetStopList(const CKeyStopList &stop);
+	const CKeyStopList &StopList() const { return m_stopList; }
+	//limits on a key's estimated postings past which AddHashes stops it:
+	//maxPostings,and maxMeanMultiple once the sketch holds
+	//MemtablePublishPostings; maxSongShare is not applied. All 0 (as
+	//after Open) stops nothing. Called from the adding thread,as are the two below
+	void SetHotKeyLimits(const StopListParams &limits) { m_hotKeyLimits=limits; }
+	uint32_t EstimatePostings(uint32_t key) const { return m_sketch.Estimate(key); }
+	const CCountMinSketch &Sketch() const { return m_sketch; }
+
+	std::unique_ptr<CHashIndexSnapshot> Snapshot();
+	SegmentedIndexStats Stats();
+	EpochStats Epochs() { return m_epochs.Stats(); }
+private:
+	void Run();
+	//the oldest SegmentMergeFanIn segments of the lowest full tier,empty if none
+	std::vector<std::shared_ptr<IndexSegment> > PickMerge(const IndexVersion &version) const;
+	std::shared_ptr<IndexSegment> WriteSegment(CHashSegmentBuilder &builder,uint64_t &bytes);
+	bool WriteManifest(const IndexVersion &version);
+	//the sketch and a stop list grown by hot keys,when changed
+	void SaveKeyCounts();
+	CAtlString SegmentPath(uint32_t number) const;
+
+	CAtlString m_dir;
+	bool m_packed;
+	std::thread m_thread;
+	CEpochManager m_epochs;
+	CRcuCell<IndexVersion> m_version;
+	//the adding thread's own until published
+	CHashTable m_memtable;
+	std::atomic<size_t> m_memPostings;
+	CKeyStopList m_stopList;
+	std::atomic<uint64_t> m_stoppedPostings;
+	CCountMinSketch m_sketch;
+	StopListParams m_hotKeyLimits;
+	std::atomic<size_t> m_hotKeys;
+	bool m_sketchChanged;
+	bool m_stopListChanged;
+	//held to publish a version and for the writer state below
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	uint32_t m_nextNumber;
+	bool m_flushAsked;
+	bool m_compactAsked;
+	bool m_working;
+	bool m_stop;
+	bool m_failed;
+	size_t m_flushes;
+	size_t m_merges;
+	uint64_t m_flushBytes;
+	uint64_t m_mergeBytes;
+	uint64_t m_droppedPostings;
+};
+
+//////////////////////////////////////////////////////////////////////
+// StressSegmentedIndex
+// readers threads query clips of published songs through snapshots
+// while the calling thread adds synthetic songs to a fresh index in dir;
+// whatever dir held is removed. A clip that doesn't find its own song
+// counts as wrong.
+//////////////////////////////////////////////////////////////////////
+struct IndexStressReport
+{
+	size_t songs;
+	double songsPerSecond;
+	size_t queries;
+	size_t wrong;
+	LatencyStats latency;
+	SegmentedIndexStats index;
+	EpochStats epochs;
+};
+void StressSegmentedIndex(LPCWSTR dir,size_t readers,size_t songs,IndexStressReport &report);
@@ -0,0 +1,339 @@
+#include "StdAfx.h"
+#include "SongIngest.h"
+#include <algorithm>
+
+
+CRowInserter::CRowInserter():m_columns(0),m_rows(0),m_failed(false)
+{
+}
+
+void CRowInserter::Prepare(CSqlite &db,LPCWSTR table,LPCWSTR columns,int columnCount)
+{
+	m_columns=columnCount;
+	m_values.clear();
+	m_rows=0;
+	m_failed=false;
+	CAtlString row(L"(?");
+	for(int c=1;c<columnCount;c++)
+		row+=L",?";
+	row+=L")";
+	CAtlString sql;
+	sql.Format(L"insert into %s(%s) values",table,columns);
+	CAtlString batch=sql;
+	for(int r=0;r<IngestRowsPerInsert;r++)
+	{
+		if(r)
+			batch+=L",";
+		batch+=row;
+	}
+	m_batch=db.Prepare(batch);
+	m_single=db.Prepare(sql+row);
+}
+
+void CRowInserter::Add(int a,int b,int c,int d)
+{
+	m_values.push_back(a);
+	m_values.push_back(b);
+	m_values.push_back(c);
+	if(m_columns>3)
+		m_values.push_back(d);
+	if(m_values.size()<(size_t)(IngestRowsPerInsert*m_columns))
+		return;
+	for(size_t i=0;i<m_values.size();i++)
+		m_batch.Bind((int)i+1,m_values[i]);
+	if(SQLITE_DONE==m_batch.Step())
+		m_rows+=IngestRowsPerInsert;
+	else
+		m_failed=true;
+	m_batch.Reset();
+	m_values.clear();
+}
+
+bool CRowInserter::Flush()
+{
+	for(size_t i=0;i<m_values.size();i+=m_columns)
+	{
+		for(int c=0;c<m_columns;c++)
+			m_single.Bind(c+1,m_values[i+c]);
+		if(SQLITE_DONE==m_single.Step())
+			m_rows++;
+		else
+			m_failed=true;
+		m_single.Reset();
+	}
+	m_values.clear();
+	bool written=!m_failed;
+	m_failed=false;
+	return written;
+}
+
+void CRowInserter::Close()
+{
+	m_batch.Close();
+	m_single.Close();
+}
+
+CSongIngest::CSongIngest(LPCWSTR dbPath,bool bulk):m_open(true)
+{
+	m_stats.songs=0;
+	m_stats.rows=0;
+	m_stats.insertTicks=0;
+	m_stats.indexTicks=0;
+	m_db.Open(dbPath);
+	CSqliteStmt deferred=m_db.Prepare(L"select sql from Deferred_index");
+	while(SQLITE_ROW==deferred.Step())
+		m_deferredIndexes.push_back(CAtlString(CA2W(deferred.GetText(0),CP_UTF8)));
+	deferred.Close();
+	if(bulk)
+	{
+		//WAL appends pages instead of copying them to a rollback journal,
+		//and NORMAL only syncs at checkpoints
+		CSqliteStmt mode=m_db.Prepare(L"pragma journal_mode");
+		if(SQLITE_ROW==mode.Step())
+			m_journalMode=CAtlString(CA2W(mode.GetText(0),CP_UTF8));
+		mode.Close();
+		m_db.Execute(L"pragma journal_mode=WAL");
+		m_db.Execute(L"pragma synchronous=NORMAL");
+		CSqliteStmt indexes=m_db.Prepare(L"select name,sql from sqlite_master where type='index' and sql is not null "
+			L"and tbl_name in ('Anchor_freq_index','Check_freq_index','Hash_freq_index')");
+		std::vector<CAtlString> names;
+		while(SQLITE_ROW==indexes.Step())
+		{
+			names.push_back(CAtlString(CA2W(indexes.GetText(0),CP_UTF8)));
+			m_deferredIndexes.push_back(CAtlString(CA2W(indexes.GetText(1),CP_UTF8)));
+		}
+		indexes.Close();
+		m_db.Execute(L"begin transaction");
+		CSqliteStmt defer=m_db.Prepare(L"insert into Deferred_index(sql) values(?1)");
+		for(size_t i=m_deferredIndexes.size()-names.size();i<m_deferredIndexes.size();i++)
+		{
+			defer.Bind(1,m_deferredIndexes[i]);
+			defer.Step();
+			defer.Reset();
+		}
+		defer.Close();
+		for(auto i=names.begin();i!=names.end();++i)
+			m_db.Execute(L"drop index if exists \""+*i+L"\"");
+		m_db.Execute(L"commit transaction");
+	}
+
+	m_nextSongId=std::max(MaxId(L"songlist"),MaxId(L"Song_tombstone"))+1;
+	//compaction deletes anchors off the top too,so the highest id ever
+	//handed out is kept apart from the table
+	m_nextAnchorId=std::max(MaxId(L"Anchor_freq_index"),MaxId(L"Anchor_high_water"))+1;
+	m_insertSong=m_db.Prepare(L"insert into songlist(id,name) values(?1,?2)");
+	m_findSongs=m_db.Prepare(L"select id from songlist where name=?1");
+	m_insertTombstone=m_db.Prepare(L"insert or ignore into Song_tombstone(id) values(?1)");
+	m_deleteSong=m_db.Prepare(L"delete from songlist where id=?1");
+	m_anchors.Prepare(m_db,L"Anchor_freq_index",L"id,freq,time,song_id",4);
+	m_checks.Prepare(m_db,L"Check_freq_index",L"Anchor_id,freq,time_offset",3);
+	m_hashes.Prepare(m_db,L"Hash_freq_index",L"hash,time,song_id",3);
+}
+
+
+CSongIngest::~CSongIngest(void)
+{
+	Finish();
+}
+
+int CSongIngest::MaxId(LPCWSTR table)
+{
+	CAtlString sql;
+	sql.Format(L"select ifnull(max(id),0) from %s",table);
+	CSqliteStmt maxId=m_db.Prepare(sql);
+	int id=0;
+	if(SQLITE_ROW==maxId.Step())
+		id=maxId.GetInt(0);
+	maxId.Close();
+	return id;
+}
+
+int CSongIngest::AddSong(const CAtlString &title,const std::vector<FreqInfo> &freqinfos)
+{
+	DWORD start=GetTickCount();
+	m_db.Execute(L"begin transaction");
+	int song_id=m_nextSongId;
+	m_insertSong.Bind(1,song_id);
+	m_insertSong.Bind(2,title);
+	bool added=SQLITE_DONE==m_insertSong.Step();
+	m_insertSong.Reset();
+	if(!added)
+	{
+		m_db.Execute(L"rollback transaction");
+		return 0;
+	}
+	m_nextSongId++;
+
+	size_t rowsBefore=m_anchors.Rows()+m_checks.Rows()+m_hashes.Rows();
+	std::vector<SongAnchor> anchors;
+	BuildSongAnchors(freqinfos,anchors);
+	for(auto i=anchors.begin();i!=anchors.end();++i)
+	{
+		int anchor_id=m_nextAnchorId++;
+		m_anchors.Add(anchor_id,i->freq,i->time,song_id);
+		for(auto j=i->checks.begin();j!=i->checks.end();++j)
+			m_checks.Add(anchor_id,j->freq,j->time_offset);
+	}
+	std::vector<FingerprintHash> hashes;
+	GenerateHashes(freqinfos,HashMaxFanout,hashes);
+	for(auto i=hashes.begin();i!=hashes.end();++i)
+		m_hashes.Add((int)i->key,i->time,song_id);
+	bool written=m_anchors.Flush();
+	written=m_checks.Flush() && written;
+	written=m_hashes.Flush() && written;
+	if(!written || SQLITE_OK!=m_db.Execute(L"commit transaction"))
+	{
+		m_db.Execute(L"rollback transaction");
+		return 0;
+	}
+
+	m_stats.songs++;
+	m_stats.rows+=1+m_anchors.Rows()+m_checks.Rows()+m_hashes.Rows()-rowsBefore;
+	m_stats.insertTicks+=GetTickCount()-start;
+	return song_id;
+}
+
+int CSongIngest::ReplaceSong(int old_id,const CAtlString &title,const std::vector<FreqInfo> &freqinfos)
+{
+	int song_id=AddSong(title,freqinfos);
+	//the old song stays if the new one could not be written
+	if(song_id && old_id)
+		DeleteSong(old_id);
+	return song_id;
+}
+
+void CSongIngest::FindSongs(const CAtlString &title,std::vector<int> &ids)
+{
+	ids.clear();
+	m_findSongs.Bind(1,title);
+	while(SQLITE_ROW==m_findSongs.Step())
+		ids.push_back(m_findSongs.GetInt(0));
+	m_findSongs.Reset();
+}
+
+bool CSongIngest::DeleteSong(int song_id)
+{
+	m_db.Execute(L"begin transaction");
+	m_insertTombstone.Bind(1,song_id);
+	bool deleted=SQLITE_DONE==m_insertTombstone.Step();
+	m_insertTombstone.Reset();
+	m_deleteSong.Bind(1,song_id);
+	deleted=SQLITE_DONE==m_deleteSong.Step() && deleted;
+	m_deleteSong.Reset();
+	m_db.Execute(deleted?L"commit transaction":L"rollback transaction");
+	return deleted;
+}
+
+void CSongIngest::Finish()
+{
+	if(!m_open)
+		return;
+	m_open=false;
+	m_insertSong.Close();
+	m_findSongs.Close();
+	m_insertTombstone.Close();
+	m_deleteSong.Close();
+	m_anchors.Close();
+	m_checks.Close();
+	m_hashes.Close();
+	DWORD start=GetTickCount();
+	for(auto i=m_deferredIndexes.begin();i!=m_deferredIndexes.end();++i)
+		m_db.Execute(*i);
+	m_db.Execute(L"delete from Deferred_index");
+	m_stats.indexTicks=GetTickCount()-start;
+	//the mode is kept in the file,so later single saves would journal
+	//through WAL too
+	if(!m_journalMode.IsEmpty())
+		m_db.Execute(L"pragma journal_mode="+m_journalMode);
+	m_db.Close();
+}
+
+bool CreateSongTables(LPCWSTR dbPath)
+{
+	static const LPCWSTR statements[]=
+	{
+		L"create table if not exists Hash_freq_index(hash INTEGER,time INTEGER,song_id INTEGER)",
+		L"create table if not exists Song_tombstone(id INTEGER PRIMARY KEY)",
+		L"create table if not exists Anchor_high_water(id INTEGER PRIMARY KEY)",
+		//indexes a bulk ingest dropped,kept until Finish builds them so an
+		//ingest that was cut off still gets them back from the next one
+		L"create table if not exists Deferred_index(sql TEXT)",
+		L"create index if not exists songlist_name on songlist(name)",
+		L"create index if not exists Hash_freq_index_hash on Hash_freq_index(hash)",
+	};
+	CSqlite db;
+	db.Open(dbPath);
+	bool created=true;
+	for(size_t i=0;i<sizeof(statements)/sizeof(statements[0]);i++)
+		created=SQLITE_OK==db.Execute(statements[i]) && created;
+	db.Close();
+	return created;
+}
+
+bool LoadSongTombstones(LPCWSTR dbPath,CSongTombstones &tombstones)
+{
+	tombstones.Clear();
+	CSqlite db;
+	db.Open(dbPath,SQLITE_OPEN_READONLY);
+	CSqliteStmt ids=db.Prepare(L"select id from Song_tombstone");
+	//false without the table,a database with no deleted songs yet
+	int res;
+	while(SQLITE_ROW==(res=ids.Step()))
+		tombstones.Add(ids.GetInt(0));
+	ids.Close();
+	db.Close();
+	return SQLITE_DONE==res;
+}
+
+bool CompactDeletedSongs(LPCWSTR dbPath,CompactStats &stats)
+{
+	memset(&stats,0,sizeof(stats));
+	DWORD start=GetTickCount();
+	CSqlite db;
+	db.Open(dbPath);
+	CSqliteStmt count=db.Prepare(L"select count(*) from Song_tombstone");
+	if(SQLITE_ROW!=count.Step())
+	{
+		count.Close();
+		db.Close();
+		return false;
+	}
+	stats.songs=count.GetInt(0);
+	count.Close();
+	//the highest anchor id is kept before any anchor goes,so the next
+	//ingest does not hand a deleted anchor's id out again
+	LPCWSTR highWater[]=
+	{
+		L"create table if not exists Anchor_high_water(id INTEGER PRIMARY KEY)",
+		L"insert or ignore into Anchor_high_water(id) select id from Anchor_freq_index order by id desc limit 1",
+		L"delete from Anchor_high_water where id<(select max(id) from Anchor_high_water)",
+	};
+	//one pass per table,checks first while their anchors are still there
+	struct
+	{
+		LPCWSTR sql;
+		size_t *rows;
+	}
+	deletes[]=
+	{
+		{L"delete from Check_freq_index where Anchor_id in "
+			L"(select id from Anchor_freq_index where song_id in (select id from Song_tombstone))",&stats.checks},
+		{L"delete from Anchor_freq_index where song_id in (select id from Song_tombstone)",&stats.anchors},
+		{L"delete from Hash_freq_index where song_id in (select id from Song_tombstone)",&stats.hashes},
+	};
+	db.Execute(L"begin transaction");
+	for(size_t i=0;i<sizeof(highWater)/sizeof(highWater[0]);i++)
+		db.Execute(highWater[i]);
+	for(size_t i=0;i<sizeof(deletes)/sizeof(deletes[0]);i++)
+	{
+		db.Execute(deletes[i].sql);
+		CSqliteStmt changes=db.Prepare(L"select changes()");
+		if(SQLITE_ROW==changes.Step())
+			*deletes[i].rows=changes.GetInt(0);
+		changes.Close();
+	}
+	db.Execute(L"commit transaction");
+	db.Close();
+	stats.ticks=GetTickCount()-start;
+	return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include "AnchorIndex.h"
+#include "HashIndex.h"
+#include "SongTombstones.h"
+
+//rows per multi-row insert; at up to 4 columns this stays under sqlite's
+//default limit of 999 bound parameters
+const int IngestRowsPerInsert=200;
+
+struct IngestStats
+{
+	size_t songs;
+	size_t rows;
+	//time in AddSong,and in Finish rebuilding the indexes deferred by a bulk run
+	DWORD insertTicks;
+	DWORD indexTicks;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CRowInserter
+// Integer rows for one table,buffered and written IngestRowsPerInsert at
+// a time through a single multi-row insert; Flush writes the rest one by one.
+// A failed insert is remembered until Flush,which reports it,so the
+// caller can roll back the transaction the rows went into.
+//////////////////////////////////////////////////////////////////////
+class CRowInserter
+{
+public:
+	CRowInserter();
+	void Prepare(CSqlite &db,LPCWSTR table,LPCWSTR columns,int columnCount);
+	void Add(int a,int b,int c,int d=0);
+	//false if an insert failed since the last Flush
+	bool Flush();
+	void Close();
+	size_t Rows() const { return m_rows; }
+private:
+	CSqliteStmt m_batch;
+	CSqliteStmt m_single;
+	int m_columns;
+	std::vector<int> m_values;
+	size_t m_rows;
+	bool m_failed;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CSongIngest
+// Writes analysed songs into the database: a songlist row,the anchors
+// with their check points and the packed hashes. Song and anchor ids are
+// handed out here from the table maximums read when opened,so no insert
+// waits on last_insert_rowid.
+// A bulk ingest switches the database to WAL with synchronous=NORMAL and
+// drops the indexes of the three point tables until Finish,which builds
+// them once over all the songs added and puts back the journal mode it
+// found,as WAL is kept in the file. They are listed in Deferred_index
+// meanwhile,so the next Finish builds them if this one never ran.
+// A deleted song only loses its songlist row and gets a Song_tombstone
+// row; its points go in CompactDeletedSongs. Song ids start past both
+// tables and anchor ids past Anchor_high_water,the highest anchor id
+// kept by each compaction,so neither a deleted song's nor a deleted
+// anchor's id is reused.
+//////////////////////////////////////////////////////////////////////
+class CSongIngest
+{
+public:
+	CSongIngest(LPCWSTR dbPath,bool bulk);
+	~CSongIngest(void);
+
+	//returns the new song id,0 if the song could not be written; nothing
+	//of it is kept then
+	int AddSong(const CAtlString &title,const std::vector<FreqInfo> &freqinfos);
+	//adds the song,then deletes old_id,the song it replaces,if not 0.
+	//Titles are not unique,so the caller names the song by an identity of
+	//its own,such as the file it was read from
+	int ReplaceSong(int old_id,const CAtlString &title,const std::vector<FreqInfo> &freqinfos);
+	void FindSongs(const CAtlString &title,std::vector<int> &ids);
+	bool DeleteSong(int song_id);
+	//restores deferred indexes and closes the database
+	void Finish();
+	const IngestStats &Stats() const { return m_stats; }
+private:
+	int MaxId(LPCWSTR table);
+
+	CSqlite m_db;
+	bool m_open;
+	CSqliteStmt m_insertSong;
+	CSqliteStmt m_findSongs;
+	CSqliteStmt m_insertTombstone;
+	CSqliteStmt m_deleteSong;
+	CRowInserter m_anchors;
+	CRowInserter m_checks;
+	CRowInserter m_hashes;
+	int m_nextSongId;
+	int m_nextAnchorId;
+	//create statements of the indexes dropped for a bulk run
+	std::vector<CAtlString> m_deferredIndexes;
+	//journal mode before a bulk run switched to WAL,empty otherwise
+	CAtlString m_journalMode;
+	IngestStats m_stats;
+};
+
+//the tables and indexes beyond songlist and the anchor tables that the
+//ingest,the tombstones and the hash queries use; run when the database
+//is opened,before any CSongIngest
+bool CreateSongTables(LPCWSTR dbPath);
+bool LoadSongTombstones(LPCWSTR dbPath,CSongTombstones &tombstones);
+
+struct CompactStats
+{
+	size_t songs;
+	size_t anchors;
+	size_t checks;
+	size_t hashes;
+	DWORD ticks;
+};
+//deletes the anchors,check points and hashes of every tombstoned song;
+//the tombstones and the anchor high water mark stay,so neither song nor
+//anchor ids are reused
+bool CompactDeletedSongs(LPCWSTR dbPath,CompactStats &stats);
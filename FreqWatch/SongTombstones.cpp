@@ -0,0 +1,47 @@
+#include "SongTombstones.h"
+#include <algorithm>
+
+void CSongTombstones::Add(int song_id)
+{
+	if(song_id<0)
+		return;
+	size_t word=(size_t)song_id>>6;
+	if(word>=m_bits.size())
+		m_bits.resize(word+1,0);
+	uint64_t bit=(uint64_t)1<<(song_id&63);
+	if(m_bits[word]&bit)
+		return;
+	m_bits[word]|=bit;
+	m_count++;
+}
+
+void CSongTombstones::Clear()
+{
+	m_bits.clear();
+	m_count=0;
+}
+
+void CSongTombstones::Ids(std::vector<int> &ids) const
+{
+	ids.clear();
+	for(size_t word=0;word<m_bits.size();word++)
+	{
+		for(uint64_t bits=m_bits[word];bits;bits&=bits-1)
+		{
+			int bit=0;
+			while(!(bits>>bit&1))
+				bit++;
+			ids.push_back((int)(word*64+bit));
+		}
+	}
+}
+
+void DropDeletedVotes(const CSongTombstones &tombstones,std::vector<MatchVote> &votes)
+{
+	if(tombstones.Empty())
+		return;
+	votes.erase(std::remove_if(votes.begin(),votes.end(),[&tombstones](const MatchVote &vote)
+	{
+		return tombstones.Contains(vote.song_id);
+	}),votes.end());
+}
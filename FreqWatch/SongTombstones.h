@@ -0,0 +1,35 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "VoteEngine.h"
+
+//////////////////////////////////////////////////////////////////////
+// CSongTombstones
+// Ids of deleted songs as a bitmap. A deleted song's points stay where
+// they are until a compaction drops them; queries drop its votes before
+// scoring. Ids are never handed out again,so a tombstone is kept for good.
+//////////////////////////////////////////////////////////////////////
+class CSongTombstones
+{
+public:
+	CSongTombstones():m_count(0){}
+
+	void Add(int song_id);
+	bool Contains(int song_id) const
+	{
+		size_t word=(size_t)(unsigned int)song_id>>6;
+		return word<m_bits.size() && (m_bits[word]>>(song_id&63)&1);
+	}
+	bool Empty() const { return !m_count; }
+	size_t Count() const { return m_count; }
+	void Clear();
+	//ascending
+	void Ids(std::vector<int> &ids) const;
+private:
+	std::vector<uint64_t> m_bits;
+	size_t m_count;
+};
+
+//removes the votes of deleted songs,the rest keep their order
+void DropDeletedVotes(const CSongTombstones &tombstones,std::vector<MatchVote> &votes);
@@ -0,0 +1,204 @@
+#include "StdAfx.h"
+#include "SqliteAnchorSource.h"
+#include "SongIngest.h"
+#include <algorithm>
+
+
+CSqliteAnchorSource::CSqliteAnchorSource(LPCWSTR dbPath,CCheckListCache *checkCache):cache(checkCache)
+{
+	db.Open(dbPath,SQLITE_OPEN_READONLY);
+	findAnchor=db.Prepare(L"select id,freq,time,song_id from Anchor_freq_index where freq=?1");
+	getCheckOfAnchor=db.Prepare(L"select freq,time_offset from Check_freq_index where Anchor_id=?1");
+}
+
+
+CSqliteAnchorSource::~CSqliteAnchorSource(void)
+{
+	findAnchor.Close();
+	getCheckOfAnchor.Close();
+	db.Close();
+}
+
+size_t CSqliteAnchorSource::FindAnchors(int freq,const AnchorRef **result)
+{
+	anchors.clear();
+	findAnchor.Bind(1,freq);
+	while(SQLITE_ROW==findAnchor.Step())
+	{
+		AnchorRef fpoint;
+		fpoint.id=findAnchor.GetInt(0);
+		fpoint.freq=findAnchor.GetInt(1);
+		fpoint.time=findAnchor.GetInt(2);
+		fpoint.song_id=findAnchor.GetInt(3);
+		anchors.push_back(fpoint);
+	}
+	findAnchor.Reset();
+	*result=anchors.empty()?nullptr:&anchors[0];
+	return anchors.size();
+}
+
+size_t CSqliteAnchorSource::GetChecks(const AnchorRef &anchor,const CheckPoint **checks)
+{
+	auto found=AnchorMap.find(anchor.id);
+	if(found==AnchorMap.end())
+	{
+		CheckListPtr ptlist;
+		if(cache)
+			ptlist=cache->Find(anchor.id);
+		if(!ptlist)
+		{
+			std::shared_ptr<std::vector<CheckPoint> > loaded(new std::vector<CheckPoint>);
+			getCheckOfAnchor.Bind(1,anchor.id);
+			while(SQLITE_ROW==getCheckOfAnchor.Step())
+			{
+				CheckPoint pt;
+				pt.freq=getCheckOfAnchor.GetInt(0);
+				pt.time_offset=getCheckOfAnchor.GetInt(1);
+				loaded->push_back(pt);
+			}
+			getCheckOfAnchor.Reset();
+			std::sort(loaded->begin(),loaded->end(),CheckPointLess);
+			ptlist=loaded;
+			if(cache)
+				cache->Insert(anchor.id,ptlist);
+		}
+		found=AnchorMap.insert(std::map<int,CheckListPtr>::value_type(anchor.id,ptlist)).first;
+	}
+	*checks=found->second->empty()?nullptr:&(*found->second)[0];
+	return found->second->size();
+}
+
+void LoadAnchorMemIndex(LPCWSTR dbPath,CAnchorMemIndex &index)
+{
+	CSqlite db;
+	db.Open(dbPath,SQLITE_OPEN_READONLY);
+	CSqliteStmt allAnchors=db.Prepare(L"select id,freq,time,song_id from Anchor_freq_index");
+	while(SQLITE_ROW==allAnchors.Step())
+		index.AddAnchor(allAnchors.GetInt(0),allAnchors.GetInt(1),allAnchors.GetInt(2),allAnchors.GetInt(3));
+	allAnchors.Close();
+	CSqliteStmt allChecks=db.Prepare(L"select Anchor_id,freq,time_offset from Check_freq_index");
+	while(SQLITE_ROW==allChecks.Step())
+		index.AddCheck(allChecks.GetInt(0),allChecks.GetInt(1),allChecks.GetInt(2));
+	allChecks.Close();
+	db.Close();
+	index.Finish();
+}
+
+size_t MatchAnchorsJoined(LPCWSTR dbPath,const std::vector<FreqInfo> &freqinfos,std::vector<MatchVote> &votes)
+{
+	votes.clear();
+	CAnchorStreamMatcher matcher;
+	matcher.SetQuery(freqinfos);
+
+	CSqlite db;
+	db.Open(dbPath,SQLITE_OPEN_READONLY);
+	//temp tables live outside the main database and are writable on a read only connection
+	db.Execute(L"create temp table if not exists query_freq(freq INTEGER PRIMARY KEY)");
+	db.Execute(L"delete from query_freq");
+	CSqliteStmt insertFreq=db.Prepare(L"insert into query_freq(freq) values(?1)");
+	const std::vector<int> &freqs=matcher.QueryFreqs();
+	for(auto i=freqs.begin();i!=freqs.end();++i)
+	{
+		insertFreq.Bind(1,*i);
+		insertFreq.Step();
+		insertFreq.Reset();
+	}
+	insertFreq.Close();
+
+	//cross join keeps this loop order,so the rows of one anchor come out together
+	CSqliteStmt joined=db.Prepare(L"select a.id,a.freq,a.time,a.song_id,c.freq,c.time_offset from query_freq q "
+		L"cross join Anchor_freq_index a on a.freq=q.freq "
+		L"cross join Check_freq_index c on c.Anchor_id=a.id");
+	AnchorRef anchor;
+	anchor.id=0;
+	std::vector<CheckPoint> checks;
+	for(;;)
+	{
+		bool row=SQLITE_ROW==joined.Step();
+		if(!row || joined.GetInt(0)!=anchor.id)
+		{
+			if(anchor.id)
+			{
+				std::sort(checks.begin(),checks.end(),CheckPointLess);
+				matcher.AddAnchor(anchor,&checks[0],checks.size(),votes);
+			}
+			if(!row)
+				break;
+			anchor.id=joined.GetInt(0);
+			anchor.freq=joined.GetInt(1);
+			anchor.time=joined.GetInt(2);
+			anchor.song_id=joined.GetInt(3);
+			checks.clear();
+		}
+		CheckPoint pt;
+		pt.freq=joined.GetInt(4);
+		pt.time_offset=joined.GetInt(5);
+		checks.push_back(pt);
+	}
+	joined.Close();
+	db.Close();
+	return matcher.AnchorsChecked();
+}
+
+bool BenchSyntheticLibrary(LPCWSTR dbPath,const SyntheticLibrary &library,size_t sqliteClips,size_t memoryClips,
+	SyntheticLibraryReport &report)
+{
+	memset(&report,0,sizeof(report));
+	DeleteFileW(dbPath);
+	//the tables CSongIngest expects,with the indexes the lookups use
+	{
+		CSqlite db;
+		db.Open(dbPath);
+		db.Execute(L"create table songlist(id INTEGER PRIMARY KEY,name TEXT)");
+		db.Execute(L"create table Anchor_freq_index(id INTEGER PRIMARY KEY,freq INTEGER,time INTEGER,song_id INTEGER)");
+		db.Execute(L"create table Check_freq_index(Anchor_id INTEGER,freq INTEGER,time_offset INTEGER)");
+		db.Execute(L"create index Anchor_freq_index_freq on Anchor_freq_index(freq)");
+		db.Execute(L"create index Check_freq_index_anchor on Check_freq_index(Anchor_id)");
+		db.Close();
+	}
+	CreateSongTables(dbPath);
+	DWORD start=GetTickCount();
+	//ids are handed out in order from 1 on a new database; the clips' owners are mapped through them all the same
+	std::vector<int> ids(library.songs+1);
+	{
+		CSongIngest ingest(dbPath,true);
+		std::vector<FreqInfo> peaks;
+		for(int s=1;s<=library.songs;s++)
+		{
+			MakeSyntheticSong((unsigned int)s,library.frames,library.peaksPerFrame,peaks);
+			CAtlString title;
+			title.Format(L"synthetic %d",s);
+			ids[s]=ingest.AddSong(title,peaks);
+			if(!ids[s])
+				return false;
+		}
+		ingest.Finish();
+	}
+	report.writeTicks=GetTickCount()-start;
+
+	std::vector<std::vector<FreqInfo> > clips;
+	std::vector<int> owners;
+	MakeSyntheticClips(library,std::max(sqliteClips,memoryClips),1,clips,owners);
+	for(auto i=owners.begin();i!=owners.end();++i)
+		*i=ids[*i];
+	std::vector<std::vector<FreqInfo> > sqliteSet(clips.begin(),clips.begin()+sqliteClips);
+	report.sqliteRight=BenchClipQueries(sqliteSet,owners,[dbPath](const std::vector<FreqInfo> &clip,std::vector<MatchVote> &votes)
+	{
+		CSqliteAnchorSource source(dbPath,nullptr);
+		MatchAnchors(clip,source,votes);
+	},report.sqlite);
+
+	start=GetTickCount();
+	CAnchorMemIndex index;
+	LoadAnchorMemIndex(dbPath,index);
+	report.loadTicks=GetTickCount()-start;
+	report.anchors=index.AnchorCount();
+	report.checks=index.CheckCount();
+	report.memoryBytes=index.MemorySize();
+	clips.resize(memoryClips);
+	report.memoryRight=BenchClipQueries(clips,owners,[&index](const std::vector<FreqInfo> &clip,std::vector<MatchVote> &votes)
+	{
+		MatchAnchors(clip,index,votes);
+	},report.memory);
+	return true;
+}
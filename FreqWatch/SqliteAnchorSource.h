@@ -0,0 +1,57 @@
+#pragma once
+#include "AnchorMemIndex.h"
+#include "CheckListCache.h"
+#include "QueryBench.h"
+
+//////////////////////////////////////////////////////////////////////
+// CSqliteAnchorSource
+// Anchors looked up in Anchor_freq_index one frequency at a time;
+// check lists are loaded on first use and kept for the source lifetime.
+// Lists loaded are also put in the cache, where later sources find them.
+//////////////////////////////////////////////////////////////////////
+class CSqliteAnchorSource:public IAnchorSource
+{
+private:
+	CSqlite db;
+	CSqliteStmt findAnchor;
+	CSqliteStmt getCheckOfAnchor;
+	std::vector<AnchorRef> anchors;
+	std::map<int,CheckListPtr> AnchorMap;
+	CCheckListCache *cache;
+public:
+	//cache may be null
+	CSqliteAnchorSource(LPCWSTR dbPath,CCheckListCache *checkCache=&SharedCheckListCache());
+	~CSqliteAnchorSource(void);
+
+	size_t FindAnchors(int freq,const AnchorRef **result);
+	size_t GetChecks(const AnchorRef &anchor,const CheckPoint **checks);
+};
+
+//reads Anchor_freq_index and Check_freq_index in two scans into index
+void LoadAnchorMemIndex(LPCWSTR dbPath,CAnchorMemIndex &index);
+
+//the anchor query as one statement: the query's freqs go into a temp table and
+//a single join streams every candidate anchor with its check points through
+//CAnchorStreamMatcher; same votes as MatchAnchors,returns the anchors checked
+size_t MatchAnchorsJoined(LPCWSTR dbPath,const std::vector<FreqInfo> &freqinfos,std::vector<MatchVote> &votes);
+
+struct SyntheticLibraryReport
+{
+	size_t anchors;
+	size_t checks;
+	//writing the library,and LoadAnchorMemIndex reading it back
+	DWORD writeTicks;
+	DWORD loadTicks;
+	size_t memoryBytes;
+	LatencyStats sqlite;
+	size_t sqliteRight;
+	LatencyStats memory;
+	size_t memoryRight;
+};
+//writes library into a new database at dbPath through a bulk CSongIngest,
+//then times sqliteClips clips the way OnFileOpen queried before the memory
+//index,a new CSqliteAnchorSource per clip with no check list cache,and
+//memoryClips clips against the database loaded by LoadAnchorMemIndex;
+//false if the database could not be written
+bool BenchSyntheticLibrary(LPCWSTR dbPath,const SyntheticLibrary &library,size_t sqliteClips,size_t memoryClips,
+	SyntheticLibraryReport &report);
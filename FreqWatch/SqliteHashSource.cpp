@@ -0,0 +1,33 @@
+#include "StdAfx.h"
+#include "SqliteHashSource.h"
+
+
+CSqliteHashSource::CSqliteHashSource(LPCWSTR dbPath)
+{
+	db.Open(dbPath,SQLITE_OPEN_READONLY);
+	findHash=db.Prepare(L"select song_id,time from Hash_freq_index where hash=?1");
+}
+
+
+CSqliteHashSource::~CSqliteHashSource(void)
+{
+	findHash.Close();
+	db.Close();
+}
+
+size_t CSqliteHashSource::FindHash(uint32_t key,const HashPosting **result)
+{
+	postings.clear();
+	//keys stay below 2^31,so they round-trip through a signed column
+	findHash.Bind(1,(int)key);
+	while(SQLITE_ROW==findHash.Step())
+	{
+		HashPosting posting;
+		posting.song_id=findHash.GetInt(0);
+		posting.time=findHash.GetInt(1);
+		postings.push_back(posting);
+	}
+	findHash.Reset();
+	*result=postings.empty()?nullptr:&postings[0];
+	return postings.size();
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "HashIndex.h"
+
+//////////////////////////////////////////////////////////////////////
+// CSqliteHashSource
+// Postings of packed anchor/target keys read from Hash_freq_index.
+//////////////////////////////////////////////////////////////////////
+class CSqliteHashSource:public IHashSource
+{
+private:
+	CSqlite db;
+	CSqliteStmt findHash;
+	std::vector<HashPosting> postings;
+public:
+	CSqliteHashSource(LPCWSTR dbPath);
+	~CSqliteHashSource(void);
+
+	size_t FindHash(uint32_t key,const HashPosting **result);
+};
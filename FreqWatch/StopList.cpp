@@ -0,0 +1,276 @@
+#include "StopList.h"
+#include <algorithm>
+#include <functional>
+#include <string.h>
+
+static const uint32_t StopListMagic=0x4c535746;	//"FWSL"
+static const uint32_t StopListVersion=1;
+
+struct StopListHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t maxPostings;
+	double maxMeanMultiple;
+	double maxSongShare;
+	uint64_t stoppedPostings;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+void CKeyFrequencyCounter::Add(uint32_t key,int song_id)
+{
+	Count &count=m_counts[key];
+	if(!count.postings || count.lastSong!=song_id)
+		count.songs++;
+	count.postings++;
+	count.lastSong=song_id;
+}
+
+void CKeyFrequencyCounter::AddHashes(int song_id,const std::vector<FingerprintHash> &hashes)
+{
+	m_songs.insert(song_id);
+	for(auto i=hashes.begin();i!=hashes.end();++i)
+		Add(i->key,song_id);
+}
+
+void CKeyFrequencyCounter::AddSegment(CHashSegment &segment,const CSongTombstones *deleted)
+{
+	for(size_t k=0;k<segment.KeyCount();k++)
+	{
+		const HashPosting *postings=nullptr;
+		size_t count=segment.KeyPostings(k,&postings);
+		for(size_t p=0;p<count;p++)
+		{
+			if(deleted && deleted->Contains(postings[p].song_id))
+				continue;
+			m_songs.insert(postings[p].song_id);
+			Add(segment.Key(k),postings[p].song_id);
+		}
+	}
+}
+
+void CKeyFrequencyCounter::AddAnchors(IAnchorSource &source)
+{
+	std::vector<int> songs;
+	for(int freq=StoreMinFreq+1;freq<StoreMaxFreq;freq++)
+	{
+		const AnchorRef *anchors=nullptr;
+		size_t count=source.FindAnchors(freq,&anchors);
+		if(!count)
+			continue;
+		songs.clear();
+		for(size_t a=0;a<count;a++)
+			songs.push_back(anchors[a].song_id);
+		std::sort(songs.begin(),songs.end());
+		for(auto i=songs.begin();i!=songs.end();++i)
+		{
+			m_songs.insert(*i);
+			Add((uint32_t)freq,*i);
+		}
+	}
+}
+
+void CKeyFrequencyCounter::Frequencies(std::vector<KeyFrequency> &keys) const
+{
+	keys.clear();
+	keys.reserve(m_counts.size());
+	for(auto i=m_counts.begin();i!=m_counts.end();++i)
+	{
+		KeyFrequency key;
+		key.key=i->first;
+		key.postings=i->second.postings;
+		key.songs=i->second.songs;
+		keys.push_back(key);
+	}
+	std::sort(keys.begin(),keys.end(),[](const KeyFrequency &a,const KeyFrequency &b)
+	{
+		return a.key<b.key;
+	});
+}
+
+void CKeyFrequencyCounter::Summarize(KeyFrequencySummary &summary) const
+{
+	memset(&summary,0,sizeof(summary));
+	summary.keys=m_counts.size();
+	summary.songs=m_songs.size();
+	if(m_counts.empty())
+		return;
+	std::vector<uint32_t> postings;
+	postings.reserve(m_counts.size());
+	for(auto i=m_counts.begin();i!=m_counts.end();++i)
+	{
+		postings.push_back(i->second.postings);
+		summary.postings+=i->second.postings;
+	}
+	std::sort(postings.begin(),postings.end(),std::greater<uint32_t>());
+	summary.maxPostings=postings[0];
+	summary.meanPostings=(double)summary.postings/summary.keys;
+	uint64_t top=0;
+	size_t topKeys=(postings.size()+99)/100;
+	for(size_t k=0;k<topKeys;k++)
+		top+=postings[k];
+	summary.topShare=(double)top/summary.postings;
+}
+
+CKeyStopList::CKeyStopList():m_stoppedPostings(0)
+{
+	memset(&m_params,0,sizeof(m_params));
+}
+
+void CKeyStopList::Build(const std::vector<KeyFrequency> &keys,size_t songs,const StopListParams &params)
+{
+	Clear();
+	m_params=params;
+	uint64_t postings=0;
+	for(auto i=keys.begin();i!=keys.end();++i)
+		postings+=i->postings;
+	double mean=keys.empty()?0:(double)postings/keys.size();
+	for(auto i=keys.begin();i!=keys.end();++i)
+	{
+		bool stop=(params.maxPostings && i->postings>params.maxPostings) ||
+			(params.maxMeanMultiple>0 && i->postings>mean*params.maxMeanMultiple) ||
+			(params.maxSongShare>0 && songs && i->songs>songs*params.maxSongShare);
+		if(!stop)
+			continue;
+		m_keys.push_back(i->key);
+		m_stoppedPostings+=i->postings;
+	}
+	std::sort(m_keys.begin(),m_keys.end());
+}
+
+void CKeyStopList::Clear()
+{
+	m_keys.clear();
+	memset(&m_params,0,sizeof(m_params));
+	m_stoppedPostings=0;
+}
+
+bool CKeyStopList::Insert(uint32_t key,uint64_t postings)
+{
+	auto pos=std::lower_bound(m_keys.begin(),m_keys.end(),key);
+	if(pos!=m_keys.end() && *pos==key)
+		return false;
+	m_keys.insert(pos,key);
+	m_stoppedPostings+=postings;
+	return true;
+}
+
+bool CKeyStopList::Contains(uint32_t key) const
+{
+	return std::binary_search(m_keys.begin(),m_keys.end(),key);
+}
+
+void CKeyStopList::Save(std::vector<uint8_t> &image) const
+{
+	StopListHeader header;
+	memset(&header,0,sizeof(header));
+	header.magic=StopListMagic;
+	header.version=StopListVersion;
+	header.maxPostings=m_params.maxPostings;
+	header.maxMeanMultiple=m_params.maxMeanMultiple;
+	header.maxSongShare=m_params.maxSongShare;
+	header.stoppedPostings=m_stoppedPostings;
+	header.count=(uint32_t)m_keys.size();
+	image.resize(sizeof(header)+m_keys.size()*sizeof(uint32_t));
+	memcpy(&image[0],&header,sizeof(header));
+	if(!m_keys.empty())
+		memcpy(&image[sizeof(header)],&m_keys[0],m_keys.size()*sizeof(uint32_t));
+}
+
+bool CKeyStopList::Load(const void *data,size_t size)
+{
+	Clear();
+	StopListHeader header;
+	if(size<sizeof(header))
+		return false;
+	memcpy(&header,data,sizeof(header));
+	if(header.magic!=StopListMagic || header.version!=StopListVersion ||
+		size!=sizeof(header)+(uint64_t)header.count*sizeof(uint32_t))
+		return false;
+	m_keys.resize(header.count);
+	if(header.count)
+		memcpy(&m_keys[0],(const uint8_t*)data+sizeof(header),header.count*sizeof(uint32_t));
+	//saved sorted,but a list out of order would make Contains miss
+	if(!std::is_sorted(m_keys.begin(),m_keys.end()))
+	{
+		m_keys.clear();
+		return false;
+	}
+	m_params.maxPostings=(size_t)header.maxPostings;
+	m_params.maxMeanMultiple=header.maxMeanMultiple;
+	m_params.maxSongShare=header.maxSongShare;
+	m_stoppedPostings=header.stoppedPostings;
+	return true;
+}
+
+size_t RemoveStoppedHashes(const CKeyStopList &stop,std::vector<FingerprintHash> &hashes)
+{
+	if(stop.Empty())
+		return 0;
+	size_t before=hashes.size();
+	hashes.erase(std::remove_if(hashes.begin(),hashes.end(),[&stop](const FingerprintHash &hash)
+	{
+		return stop.Contains(hash.key);
+	}),hashes.end());
+	return before-hashes.size();
+}
+
+size_t CStopListAnchorSource::FindAnchors(int freq,const AnchorRef **anchors)
+{
+	if(m_stop.Contains((uint32_t)freq))
+	{
+		*anchors=nullptr;
+		return 0;
+	}
+	return m_source.FindAnchors(freq,anchors);
+}
+
+void PlanHashQuery(const CCountMinSketch &sketch,uint64_t maxPostings,std::vector<FingerprintHash> &query,
+	HashQueryPlan &plan)
+{
+	memset(&plan,0,sizeof(plan));
+	//key,hashes under it and their estimated postings
+	struct KeyCost
+	{
+		uint32_t key;
+		size_t hashes;
+		uint64_t postings;
+	};
+	std::vector<uint32_t> keys;
+	keys.reserve(query.size());
+	for(auto i=query.begin();i!=query.end();++i)
+		keys.push_back(i->key);
+	std::sort(keys.begin(),keys.end());
+	std::vector<KeyCost> costs;
+	for(auto i=keys.begin();i!=keys.end();)
+	{
+		auto next=std::upper_bound(i,keys.end(),*i);
+		KeyCost cost={*i,(size_t)(next-i),(uint64_t)sketch.Estimate(*i)*(next-i)};
+		costs.push_back(cost);
+		plan.postings+=cost.postings;
+		i=next;
+	}
+	plan.keys=costs.size();
+	if(!maxPostings || plan.postings<=maxPostings)
+		return;
+	std::sort(costs.begin(),costs.end(),[](const KeyCost &a,const KeyCost &b)
+	{
+		return a.postings>b.postings;
+	});
+	std::vector<uint32_t> dropped;
+	for(auto i=costs.begin();i+1<costs.end() && plan.postings>maxPostings;++i)
+	{
+		dropped.push_back(i->key);
+		plan.postings-=i->postings;
+		plan.droppedPostings+=i->postings;
+		plan.droppedHashes+=i->hashes;
+	}
+	plan.droppedKeys=dropped.size();
+	plan.keys-=dropped.size();
+	std::sort(dropped.begin(),dropped.end());
+	query.erase(std::remove_if(query.begin(),query.end(),[&dropped](const FingerprintHash &hash)
+	{
+		return std::binary_search(dropped.begin(),dropped.end(),hash.key);
+	}),query.end());
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "AnchorIndex.h"
+#include "CountMinSketch.h"
+#include "HashIndex.h"
+#include "HashSegment.h"
+#include "SongTombstones.h"
+
+//how common a key is in an index: its postings and the songs they belong to
+struct KeyFrequency
+{
+	uint32_t key;
+	uint32_t postings;
+	uint32_t songs;
+};
+
+struct KeyFrequencySummary
+{
+	size_t keys;
+	uint64_t postings;
+	size_t songs;
+	double meanPostings;
+	uint32_t maxPostings;
+	//share of the postings held by the commonest 1% of the keys
+	double topShare;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CKeyFrequencyCounter
+// Counts postings and songs per key over hash postings or anchors. A
+// key's songs are counted as its postings come in,so the postings of one
+// song must come together: a song's hashes at once,or a segment's lists
+// in the song order they are stored in. Segments hold songs apart,so
+// several can be added.
+//////////////////////////////////////////////////////////////////////
+class CKeyFrequencyCounter
+{
+public:
+	//hashes of one song,sorted by key as GenerateHashes makes them
+	void AddHashes(int song_id,const std::vector<FingerprintHash> &hashes);
+	//every list of segment,less the postings of deleted songs
+	void AddSegment(CHashSegment &segment,const CSongTombstones *deleted=nullptr);
+	//the anchors stored at each freq of the StoreMinFreq..StoreMaxFreq band
+	void AddAnchors(IAnchorSource &source);
+
+	size_t Songs() const { return m_songs.size(); }
+	//sorted by key
+	void Frequencies(std::vector<KeyFrequency> &keys) const;
+	void Summarize(KeyFrequencySummary &summary) const;
+private:
+	struct Count
+	{
+		uint32_t postings;
+		uint32_t songs;
+		int lastSong;
+	};
+	void Add(uint32_t key,int song_id);
+
+	std::unordered_map<uint32_t,Count> m_counts;
+	std::unordered_set<int> m_songs;
+};
+
+//when a key is too common to tell songs apart; a limit of 0 is not applied
+struct StopListParams
+{
+	//postings of the key
+	size_t maxPostings;
+	//postings against the mean of all keys
+	double maxMeanMultiple;
+	//share of the songs the key is found in
+	double maxSongShare;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CKeyStopList
+// Keys left out of an index because they are found in too many songs:
+// hash keys,or anchor freqs for the anchor index. Their lists are long
+// and their votes spread over every song,so they cost most of a query's
+// time while deciding little. Build picks them from the key
+// frequencies,Insert adds one an index finds too common as it grows;
+// the list is saved as an image (magic,version,params,count,sorted keys)
+// kept next to the index it was built from.
+//////////////////////////////////////////////////////////////////////
+class CKeyStopList
+{
+public:
+	CKeyStopList();
+
+	void Build(const std::vector<KeyFrequency> &keys,size_t songs,const StopListParams &params);
+	void Clear();
+	//stops key too,counting postings towards StoppedPostings; false if
+	//it was stopped already
+	bool Insert(uint32_t key,uint64_t postings);
+	bool Empty() const { return m_keys.empty(); }
+	size_t Count() const { return m_keys.size(); }
+	const StopListParams &Params() const { return m_params; }
+	//postings the stopped keys held when the list was built
+	uint64_t StoppedPostings() const { return m_stoppedPostings; }
+	bool Contains(uint32_t key) const;
+
+	void Save(std::vector<uint8_t> &image) const;
+	//false if data is not a stop list,the list is then empty
+	bool Load(const void *data,size_t size);
+private:
+	std::vector<uint32_t> m_keys;
+	StopListParams m_params;
+	uint64_t m_stoppedPostings;
+};
+
+//drops the hashes whose key is stopped,the rest keep their order;
+//returns how many were dropped
+size_t RemoveStoppedHashes(const CKeyStopList &stop,std::vector<FingerprintHash> &hashes);
+
+//what a hash query is estimated to read,and what PlanHashQuery left out
+struct HashQueryPlan
+{
+	size_t keys;
+	uint64_t postings;
+	size_t droppedKeys;
+	size_t droppedHashes;
+	uint64_t droppedPostings;
+};
+
+//////////////////////////////////////////////////////////////////////
+// PlanHashQuery
+// Estimates the postings each key of query reads from the sketch of the
+// index,without looking anything up: the key's estimate once per query
+// hash under it. While the total is over maxPostings the dearest key's
+// hashes are dropped,the rest keep their order; the last key is kept
+// whatever it costs. A maxPostings of 0 only estimates.
+//////////////////////////////////////////////////////////////////////
+void PlanHashQuery(const CCountMinSketch &sketch,uint64_t maxPostings,std::vector<FingerprintHash> &query,
+	HashQueryPlan &plan);
+
+//////////////////////////////////////////////////////////////////////
+// CStopListAnchorSource
+// An anchor source with the anchors at stopped freqs hidden: query
+// peaks at those freqs look nothing up,but still serve as targets of
+// the peaks before them.
+//////////////////////////////////////////////////////////////////////
+class CStopListAnchorSource:public IAnchorSource
+{
+public:
+	CStopListAnchorSource(IAnchorSource &source,const CKeyStopList &stop):m_source(source),m_stop(stop){}
+
+	size_t FindAnchors(int freq,const AnchorRef **anchors);
+	size_t GetChecks(const AnchorRef &anchor,const CheckPoint **checks) { return m_source.GetChecks(anchor,checks); }
+	bool SharedReads() const { return m_source.SharedReads(); }
+private:
+	IAnchorSource &m_source;
+	const CKeyStopList &m_stop;
+};
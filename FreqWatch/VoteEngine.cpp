@@ -0,0 +1,242 @@
+#include "VoteEngine.h"
+#include <algorithm>
+
+//song_id in the high word; offset biased so the key order is the signed order
+static inline uint64_t VoteKey(int song_id,int offset)
+{
+	return ((uint64_t)(uint32_t)song_id<<32)|((uint32_t)offset^0x80000000u);
+}
+static inline int KeySong(uint64_t key)
+{
+	return (int)(uint32_t)(key>>32);
+}
+static inline int KeyOffset(uint64_t key)
+{
+	return (int)((uint32_t)key^0x80000000u);
+}
+
+//LSD radix sort on bytes,skipping the bytes every key shares
+static void RadixSort(std::vector<uint64_t> &keys,std::vector<uint64_t> &temp)
+{
+	size_t counts[8][256]={};
+	for(auto i=keys.begin();i!=keys.end();++i)
+	{
+		uint64_t key=*i;
+		for(int b=0;b<8;b++)
+			counts[b][(key>>(b*8))&0xff]++;
+	}
+	temp.resize(keys.size());
+	for(int b=0;b<8;b++)
+	{
+		size_t *count=counts[b];
+		if(count[(keys[0]>>(b*8))&0xff]==keys.size())
+			continue;
+		size_t pos=0;
+		for(int d=0;d<256;d++)
+		{
+			size_t c=count[d];
+			count[d]=pos;
+			pos+=c;
+		}
+		for(auto i=keys.begin();i!=keys.end();++i)
+			temp[count[(*i>>(b*8))&0xff]++]=*i;
+		keys.swap(temp);
+	}
+}
+
+CVoteScorer::CVoteScorer(VoteCounting method):m_method(method)
+{
+}
+
+void CVoteScorer::Score(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores)
+{
+	scores.clear();
+	if(votes.empty())
+		return;
+	if(m_method==VoteCountHash)
+		ScoreHashed(votes,scores);
+	else
+		ScoreSorted(votes,scores);
+}
+
+void CVoteScorer::ScoreSorted(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores)
+{
+	m_keys.resize(votes.size());
+	for(size_t i=0;i<votes.size();i++)
+		m_keys[i]=VoteKey(votes[i].song_id,votes[i].offset);
+	RadixSort(m_keys,m_sortTemp);
+
+	//equal keys are one run; runs of a song are in offset order
+	m_runs.clear();
+	int song_id=KeySong(m_keys[0]);
+	for(size_t i=0;i<m_keys.size();)
+	{
+		size_t end=i+1;
+		while(end<m_keys.size() && m_keys[end]==m_keys[i])
+			end++;
+		if(KeySong(m_keys[i])!=song_id)
+		{
+			ScoreSong(song_id,scores);
+			m_runs.clear();
+			song_id=KeySong(m_keys[i]);
+		}
+		OffsetRun run;
+		run.offset=KeyOffset(m_keys[i]);
+		run.count=(int)(end-i);
+		m_runs.push_back(run);
+		i=end;
+	}
+	ScoreSong(song_id,scores);
+}
+
+void CVoteScorer::ScoreSong(int song_id,std::vector<SongScore> &scores)
+{
+	size_t best=0;
+	int total=0;
+	for(size_t i=0;i<m_runs.size();i++)
+	{
+		total+=m_runs[i].count;
+		if(m_runs[i].count>m_runs[best].count)
+			best=i;
+	}
+	int maxpos=m_runs[best].offset;
+	int window=m_runs[best].count;
+	for(size_t i=best;i>0 && m_runs[i-1].offset>=maxpos-VoteWindow;i--)
+		window+=m_runs[i-1].count;
+	for(size_t i=best+1;i<m_runs.size() && m_runs[i].offset<=maxpos+VoteWindow;i++)
+		window+=m_runs[i].count;
+
+	SongScore score;
+	score.song_id=song_id;
+	score.count=total;
+	score.starttimeMaxCount=window;
+	score.offset=maxpos;
+	scores.push_back(score);
+}
+
+CVoteScorer::CountSlot *CVoteScorer::FindSlot(std::vector<CountSlot> &slots,uint64_t key)
+{
+	//song ids are >0,so no key is 0 and 0 marks a free slot
+	size_t mask=slots.size()-1;
+	size_t pos=(size_t)((key*0x9E3779B97F4A7C15ull)>>32)&mask;
+	while(slots[pos].key && slots[pos].key!=key)
+		pos=(pos+1)&mask;
+	return &slots[pos];
+}
+
+static size_t TableSize(size_t entries)
+{
+	size_t capacity=16;
+	while(capacity<entries*2)
+		capacity<<=1;
+	return capacity;
+}
+
+void CVoteScorer::ScoreHashed(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores)
+{
+	CountSlot empty={0,0};
+	m_slots.assign(TableSize(votes.size()),empty);
+	for(auto i=votes.begin();i!=votes.end();++i)
+	{
+		uint64_t key=VoteKey(i->song_id,i->offset);
+		CountSlot *slot=FindSlot(m_slots,key);
+		slot->key=key;
+		slot->count++;
+	}
+
+	//per song total and top offset; the song table maps song_id to its place in scores
+	m_songSlots.assign(TableSize(votes.size()),empty);
+	for(auto i=m_slots.begin();i!=m_slots.end();++i)
+	{
+		if(!i->key)
+			continue;
+		int song_id=KeySong(i->key);
+		int offset=KeyOffset(i->key);
+		CountSlot *song=FindSlot(m_songSlots,(uint64_t)(uint32_t)song_id);
+		if(!song->key)
+		{
+			song->key=(uint32_t)song_id;
+			song->count=(int)scores.size();
+			SongScore score;
+			score.song_id=song_id;
+			score.count=0;
+			score.starttimeMaxCount=0;
+			score.offset=offset;
+			scores.push_back(score);
+		}
+		SongScore &score=scores[song->count];
+		score.count+=i->count;
+		if(i->count>score.starttimeMaxCount || (i->count==score.starttimeMaxCount && offset<score.offset))
+		{
+			score.starttimeMaxCount=i->count;
+			score.offset=offset;
+		}
+	}
+	for(auto s=scores.begin();s!=scores.end();++s)
+	{
+		int window=0;
+		for(int fr=s->offset-VoteWindow;fr<=s->offset+VoteWindow;fr++)
+			window+=FindSlot(m_slots,VoteKey(s->song_id,fr))->count;
+		s->starttimeMaxCount=window;
+	}
+	std::sort(scores.begin(),scores.end(),[](const SongScore &a,const SongScore &b)
+	{
+		return a.song_id<b.song_id;
+	});
+}
+
+CVoteLeader::CVoteLeader()
+{
+	Reset();
+}
+
+void CVoteLeader::Reset()
+{
+	m_counts.clear();
+	m_songBest.clear();
+	m_leader=0;
+	m_leaderScore=0;
+	m_runnerScore=0;
+}
+
+void CVoteLeader::Add(const MatchVote &vote)
+{
+	m_counts[VoteKey(vote.song_id,vote.offset)]++;
+	//the vote is in the window of every centre within VoteWindow of it,
+	//voted at or not,so all of them are summed again: counts[i] holds
+	//offset-2*VoteWindow+i,and centre c sums counts[c..c+2*VoteWindow]
+	int counts[4*VoteWindow+1];
+	for(int i=0;i<4*VoteWindow+1;i++)
+	{
+		auto found=m_counts.find(VoteKey(vote.song_id,vote.offset-2*VoteWindow+i));
+		counts[i]=found==m_counts.end()?0:found->second;
+	}
+	int window=0;
+	for(int c=0;c<=2*VoteWindow;c++)
+	{
+		int sum=0;
+		for(int i=c;i<=c+2*VoteWindow;i++)
+			sum+=counts[i];
+		window=std::max(window,sum);
+	}
+	int &best=m_songBest[vote.song_id];
+	if(window<=best)
+		return;
+	best=window;
+	if(vote.song_id==m_leader)
+		m_leaderScore=window;
+	else if(window>m_leaderScore)
+	{
+		m_runnerScore=m_leaderScore;
+		m_leader=vote.song_id;
+		m_leaderScore=window;
+	}
+	else if(window>m_runnerScore)
+		m_runnerScore=window;
+}
+
+void ScoreVotes(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores)
+{
+	CVoteScorer scorer;
+	scorer.Score(votes,scores);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+//one stored point agreeing with the query: the song and where in it the query starts
+struct MatchVote
+{
+	int song_id;
+	int offset;
+};
+
+struct SongScore
+{
+	int song_id;
+	//all votes for the song
+	int count;
+	//votes within +-VoteWindow frames of the most voted offset
+	int starttimeMaxCount;
+	int offset;
+};
+
+const int VoteWindow=3;
+
+enum VoteCounting
+{
+	//radix sort of (song_id,offset) keys,then one run-length pass per song
+	VoteCountSort,
+	//open addressing table of (song_id,offset) counts
+	VoteCountHash
+};
+
+//////////////////////////////////////////////////////////////////////
+// CVoteScorer
+// Turns query votes into per song scores. Both methods work on flat
+// 64-bit (song_id,offset) keys and give the same result; the buffers are
+// kept between calls so a scorer reused across queries does not allocate.
+//////////////////////////////////////////////////////////////////////
+class CVoteScorer
+{
+public:
+	CVoteScorer(VoteCounting method=VoteCountSort);
+
+	//per song totals and aligned score,ordered by song_id; when several
+	//offsets share the top count the smallest is taken
+	void Score(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores);
+private:
+	struct OffsetRun
+	{
+		int offset;
+		int count;
+	};
+	struct CountSlot
+	{
+		uint64_t key;
+		int count;
+	};
+	void ScoreSorted(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores);
+	void ScoreHashed(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores);
+	void ScoreSong(int song_id,std::vector<SongScore> &scores);
+	static CountSlot *FindSlot(std::vector<CountSlot> &slots,uint64_t key);
+
+	VoteCounting m_method;
+	std::vector<uint64_t> m_keys;
+	std::vector<uint64_t> m_sortTemp;
+	std::vector<OffsetRun> m_runs;
+	std::vector<CountSlot> m_slots;
+	std::vector<CountSlot> m_songSlots;
+};
+
+//////////////////////////////////////////////////////////////////////
+// CVoteLeader
+// Running top two songs while votes arrive. A song's score is its best
+// +-VoteWindow sum around any offset,one it has no vote at included;
+// each vote sums again every window it falls in. Scores only grow,so
+// the leader and the best of the others are kept up to date per vote.
+//////////////////////////////////////////////////////////////////////
+class CVoteLeader
+{
+public:
+	CVoteLeader();
+
+	void Reset();
+	void Add(const MatchVote &vote);
+
+	int Leader() const { return m_leader; }
+	int LeaderScore() const { return m_leaderScore; }
+	//best score of any song but the leader
+	int RunnerScore() const { return m_runnerScore; }
+private:
+	//(song_id,offset) -> votes
+	std::unordered_map<uint64_t,int> m_counts;
+	std::unordered_map<int,int> m_songBest;
+	int m_leader;
+	int m_leaderScore;
+	int m_runnerScore;
+};
+
+//CVoteScorer with VoteCountSort
+void ScoreVotes(const std::vector<MatchVote> &votes,std::vector<SongScore> &scores);
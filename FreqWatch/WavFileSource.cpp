@@ -0,0 +1,169 @@
+#include "WavFileSource.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <strings.h>
+#endif
+
+static uint32_t ReadLE32(const unsigned char *p)
+{
+	return p[0]|(p[1]<<8)|(p[2]<<16)|((uint32_t)p[3]<<24);
+}
+
+static uint16_t ReadLE16(const unsigned char *p)
+{
+	return (uint16_t)(p[0]|(p[1]<<8));
+}
+
+bool ReadWavFile(const char *path,WavData &wav)
+{
+	wav.sampleRate=0;
+	wav.channels=0;
+	wav.samples.clear();
+	FILE *fp=fopen(path,"rb");
+	if(fp==NULL)
+		return false;
+	unsigned char head[12];
+	bool ok=fread(head,1,12,fp)==12 && memcmp(head,"RIFF",4)==0 && memcmp(head+8,"WAVE",4)==0;
+	unsigned int bits=0;
+	bool gotFormat=false;
+	while(ok)
+	{
+		unsigned char chunk[8];
+		if(fread(chunk,1,8,fp)!=8)
+		{
+			ok=false;
+			break;
+		}
+		uint32_t size=ReadLE32(chunk+4);
+		if(memcmp(chunk,"fmt ",4)==0)
+		{
+			unsigned char fmt[16];
+			if(size<16 || fread(fmt,1,16,fp)!=16)
+			{
+				ok=false;
+				break;
+			}
+			wav.channels=ReadLE16(fmt+2);
+			wav.sampleRate=ReadLE32(fmt+4);
+			bits=ReadLE16(fmt+14);
+			gotFormat=ReadLE16(fmt)==1 && bits==16 && wav.channels>0;
+			fseek(fp,(size-16)+(size&1),SEEK_CUR);
+		}
+		else if(memcmp(chunk,"data",4)==0)
+		{
+			if(!gotFormat)
+			{
+				ok=false;
+				break;
+			}
+			std::vector<short> raw(size/sizeof(short));
+			size_t got=raw.empty()?0:fread(&raw[0],sizeof(short),raw.size(),fp);
+			size_t frames=got/wav.channels;
+			wav.samples.resize(frames);
+			for(size_t i=0;i<frames;i++)
+			{
+				int sum=0;
+				for(unsigned int c=0;c<wav.channels;c++)
+					sum+=raw[i*wav.channels+c];
+				wav.samples[i]=(short)(sum/(int)wav.channels);
+			}
+			break;
+		}
+		else
+		{
+			fseek(fp,size+(size&1),SEEK_CUR);
+		}
+	}
+	fclose(fp);
+	return ok && gotFormat;
+}
+
+bool ListWavFiles(const char *folder,std::vector<std::string> &files)
+{
+	files.clear();
+	std::string dir(folder);
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE find=FindFirstFileA((dir+"\\*.wav").c_str(),&found);
+	if(find==INVALID_HANDLE_VALUE)
+		return GetLastError()==ERROR_FILE_NOT_FOUND;
+	do
+	{
+		if(!(found.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY))
+			files.push_back(dir+"\\"+found.cFileName);
+	}
+	while(FindNextFileA(find,&found));
+	FindClose(find);
+#else
+	DIR *list=opendir(folder);
+	if(list==NULL)
+		return false;
+	while(dirent *entry=readdir(list))
+	{
+		size_t length=strlen(entry->d_name);
+		//matched without case,as FindFirstFile does
+		if(length>4 && strcasecmp(entry->d_name+length-4,".wav")==0)
+			files.push_back(dir+"/"+entry->d_name);
+	}
+	closedir(list);
+#endif
+	std::sort(files.begin(),files.end());
+	return true;
+}
+
+CWavFileCapture::CWavFileCapture(const WavData &wav,size_t bufferSamples,double speed)
+	:m_wav(wav),m_bufferSamples(bufferSamples),m_speed(speed),m_stop(false),m_delivered(0)
+{
+}
+
+CWavFileCapture::~CWavFileCapture()
+{
+	Stop();
+}
+
+void CWavFileCapture::Start(const Callback &callback)
+{
+	m_stop=false;
+	m_delivered=0;
+	m_thread=std::thread(&CWavFileCapture::Run,this,callback);
+}
+
+void CWavFileCapture::Join()
+{
+	if(m_thread.joinable())
+		m_thread.join();
+}
+
+void CWavFileCapture::Stop()
+{
+	Cancel();
+	Join();
+}
+
+void CWavFileCapture::Run(Callback callback)
+{
+	auto start=std::chrono::steady_clock::now();
+	size_t pos=0;
+	while(pos<m_wav.samples.size() && !m_stop.load())
+	{
+		size_t count=m_bufferSamples;
+		if(count>m_wav.samples.size()-pos)
+			count=m_wav.samples.size()-pos;
+		if(m_speed>0 && m_wav.sampleRate)
+		{
+			//a device hands a buffer over only once it has been filled
+			double due=(double)(pos+count)/m_wav.sampleRate/m_speed;
+			std::this_thread::sleep_until(start+std::chrono::microseconds((long long)(due*1e6)));
+		}
+		callback(&m_wav.samples[pos],count);
+		pos+=count;
+		m_delivered=pos;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <string>
+
+struct WavData
+{
+	unsigned int sampleRate;
+	unsigned int channels;
+	//16 bit samples mixed down to mono
+	std::vector<short> samples;
+};
+
+//reads a 16 bit PCM RIFF/WAVE file
+bool ReadWavFile(const char *path,WavData &wav);
+//the paths of the .wav files right in folder,not its subfolders,sorted;
+//false if folder can not be listed
+bool ListWavFiles(const char *folder,std::vector<std::string> &files);
+
+//////////////////////////////////////////////////////////////////////
+// CWavFileCapture
+// Stand-in for the waveIn driver: a thread hands the samples of a wav
+// file to a callback in fixed size buffers, paced like a live device.
+// Lets the capture path run without a sound card.
+//////////////////////////////////////////////////////////////////////
+class CWavFileCapture
+{
+public:
+	typedef std::function<void(const short *pcm,size_t count)> Callback;
+
+	//speed 1 delivers in real time,2 twice as fast,0 as fast as possible
+	CWavFileCapture(const WavData &wav,size_t bufferSamples,double speed);
+	~CWavFileCapture();
+
+	void Start(const Callback &callback);
+	//blocks until the whole file was delivered or Stop was called
+	void Join();
+	void Stop();
+	//ends the delivery after the current buffer without waiting,so it may
+	//be called from the callback
+	void Cancel() { m_stop=true; }
+	size_t Delivered() const { return m_delivered.load(); }
+private:
+	void Run(Callback callback);
+
+	const WavData &m_wav;
+	size_t m_bufferSamples;
+	double m_speed;
+	std::thread m_thread;
+	std::atomic<bool> m_stop;
+	std::atomic<size_t> m_delivered;
+};
@@ -0,0 +1,107 @@
+#include "WorkStealingPool.h"
+
+CWorkStealingPool::CWorkStealingPool(size_t threads):m_queued(0),m_pending(0),m_runs(0),m_steals(0),m_sleeping(0),m_stop(false)
+{
+	if(!threads)
+		threads=std::thread::hardware_concurrency();
+	if(!threads)
+		threads=1;
+	for(size_t i=0;i<threads;i++)
+		m_queues.push_back(std::unique_ptr<Queue>(new Queue));
+	for(size_t i=0;i<threads;i++)
+		m_threads.push_back(std::thread(&CWorkStealingPool::WorkerLoop,this,i));
+}
+
+CWorkStealingPool::~CWorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop=true;
+	}
+	m_wake.notify_all();
+	for(auto i=m_threads.begin();i!=m_threads.end();++i)
+		i->join();
+}
+
+void CWorkStealingPool::Push(size_t slot,const Task &task)
+{
+	m_pending++;
+	//counted first,so a thread that takes it never sees the count below it
+	m_queued++;
+	{
+		Queue &queue=*m_queues[slot%m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.lock);
+		queue.tasks.push_back(task);
+	}
+	//a thread going to sleep counts itself and looks at m_queued under the
+	//lock,so it either sees this task or is woken
+	std::lock_guard<std::mutex> lock(m_lock);
+	if(m_sleeping)
+		m_wake.notify_one();
+}
+
+void CWorkStealingPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_idle.wait(lock,[this]()
+	{
+		return !m_pending.load();
+	});
+}
+
+bool CWorkStealingPool::Take(size_t slot,Task &task)
+{
+	{
+		Queue &own=*m_queues[slot];
+		std::lock_guard<std::mutex> lock(own.lock);
+		if(!own.tasks.empty())
+		{
+			task.swap(own.tasks.back());
+			own.tasks.pop_back();
+			m_queued--;
+			return true;
+		}
+	}
+	for(size_t n=1;n<m_queues.size();n++)
+	{
+		Queue &victim=*m_queues[(slot+n)%m_queues.size()];
+		std::lock_guard<std::mutex> lock(victim.lock);
+		if(victim.tasks.empty())
+			continue;
+		task.swap(victim.tasks.front());
+		victim.tasks.pop_front();
+		m_queued--;
+		m_steals++;
+		return true;
+	}
+	return false;
+}
+
+void CWorkStealingPool::WorkerLoop(size_t slot)
+{
+	Task task;
+	for(;;)
+	{
+		if(Take(slot,task))
+		{
+			task(slot);
+			task=nullptr;
+			m_runs++;
+			if(!--m_pending)
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				m_idle.notify_all();
+			}
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_sleeping++;
+		m_wake.wait(lock,[this]()
+		{
+			return m_stop || m_queued.load();
+		});
+		m_sleeping--;
+		if(m_stop)
+			return;
+	}
+}
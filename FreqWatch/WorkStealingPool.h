@@ -0,0 +1,62 @@
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////
+// CWorkStealingPool
+// Threads with a task deque each. A thread runs the newest task of its
+// own deque first,so a task that pushes its follow-up keeps working on
+// the same data; one whose deque is empty takes the oldest task of
+// another's. Tasks of very different lengths still balance,without all
+// threads taking turns on one shared counter as CWorkerPool does.
+// Push is called by a task for its own slot,or from any thread for any
+// slot; Wait returns once every pushed task has run.
+//////////////////////////////////////////////////////////////////////
+class CWorkStealingPool
+{
+public:
+	typedef std::function<void(size_t slot)> Task;
+
+	//0 uses every core
+	explicit CWorkStealingPool(size_t threads=0);
+	~CWorkStealingPool();
+
+	size_t Threads() const { return m_threads.size(); }
+	void Push(size_t slot,const Task &task);
+	void Wait();
+	//tasks run and tasks taken from another thread's deque,since the start
+	size_t Runs() const { return m_runs.load(); }
+	size_t Steals() const { return m_steals.load(); }
+private:
+	CWorkStealingPool(const CWorkStealingPool&);
+	CWorkStealingPool &operator=(const CWorkStealingPool&);
+
+	void WorkerLoop(size_t slot);
+	bool Take(size_t slot,Task &task);
+
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+	std::vector<std::unique_ptr<Queue> > m_queues;
+	std::vector<std::thread> m_threads;
+	//tasks in the deques,and pushed but not run to the end
+	std::atomic<size_t> m_queued;
+	std::atomic<size_t> m_pending;
+	std::atomic<size_t> m_runs;
+	std::atomic<size_t> m_steals;
+	//threads sleep here when no deque holds anything
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	size_t m_sleeping;
+	bool m_stop;
+};
@@ -0,0 +1,76 @@
+#include "WorkerPool.h"
+
+CWorkerPool::CWorkerPool(size_t threads):m_task(nullptr),m_count(0),m_next(0),m_generation(0),m_busy(0),m_stop(false)
+{
+	if(!threads)
+		threads=std::thread::hardware_concurrency();
+	for(size_t i=1;i<threads;i++)
+		m_threads.push_back(std::thread(&CWorkerPool::WorkerLoop,this,i));
+}
+
+CWorkerPool::~CWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop=true;
+	}
+	m_wake.notify_all();
+	for(auto i=m_threads.begin();i!=m_threads.end();++i)
+		i->join();
+}
+
+void CWorkerPool::Run(size_t count,const Task &task)
+{
+	if(!count)
+		return;
+	if(m_threads.empty() || count==1)
+	{
+		for(size_t i=0;i<count;i++)
+			task(0,i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_task=&task;
+		m_count=count;
+		m_next.store(0);
+		m_busy=m_threads.size();
+		m_generation++;
+	}
+	m_wake.notify_all();
+	Drain(0);
+	std::unique_lock<std::mutex> lock(m_lock);
+	while(m_busy)
+		m_idle.wait(lock);
+	m_task=nullptr;
+}
+
+void CWorkerPool::WorkerLoop(size_t slot)
+{
+	unsigned int seen=0;
+	std::unique_lock<std::mutex> lock(m_lock);
+	for(;;)
+	{
+		while(!m_stop && m_generation==seen)
+			m_wake.wait(lock);
+		if(m_stop)
+			return;
+		seen=m_generation;
+		lock.unlock();
+		Drain(slot);
+		lock.lock();
+		if(!--m_busy)
+			m_idle.notify_one();
+	}
+}
+
+void CWorkerPool::Drain(size_t slot)
+{
+	for(;;)
+	{
+		size_t i=m_next.fetch_add(1);
+		if(i>=m_count)
+			break;
+		(*m_task)(slot,i);
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////
+// CWorkerPool
+// Fixed set of threads running numbered tasks. The calling thread works
+// as slot 0, the pool threads as slots 1..Threads()-1; task indexes are
+// handed out one at a time so uneven tasks still balance.
+//////////////////////////////////////////////////////////////////////
+class CWorkerPool
+{
+public:
+	typedef std::function<void(size_t slot,size_t task)> Task;
+
+	//threads counts the calling thread; 0 uses every core
+	explicit CWorkerPool(size_t threads=0);
+	~CWorkerPool();
+
+	size_t Threads() const { return m_threads.size()+1; }
+	//task(slot,i) for every i below count,returns when all are done;
+	//not to be called from two threads at once
+	void Run(size_t count,const Task &task);
+private:
+	void WorkerLoop(size_t slot);
+	void Drain(size_t slot);
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	const Task *m_task;
+	size_t m_count;
+	std::atomic<size_t> m_next;
+	unsigned int m_generation;
+	size_t m_busy;
+	bool m_stop;
+};
@@ -11,13 +11,26 @@
 #define ID_FILE_RECORD                  32778
 #define ID_FILE_32779                   32779
 #define ID_FILE_RUN_FOLDER              32780
+#define ID_FILE_LIVE_RECOGNIZE          32781
+#define ID_FILE_OPEN_HASH               32782
+#define ID_FILE_QUERY_BENCH             32783
+#define ID_FILE_BATCH_QUERY             32784
+#define ID_FILE_PACK_CHECKS             32785
+#define ID_FILE_BUILD_HASH_SEGMENT      32786
+#define ID_FILE_STRESS_INDEX            32787
+#define ID_FILE_DELETE_SONG             32788
+#define ID_FILE_COMPACT_DELETED         32789
+#define ID_FILE_INGEST_BENCH            32790
+#define ID_FILE_BUILD_STOP_LISTS        32791
+#define ID_FILE_STOP_LIST_BENCH         32792
+#define ID_FILE_SYNTHETIC_BENCH         32793
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        201
-#define _APS_NEXT_COMMAND_VALUE         32781
+#define _APS_NEXT_COMMAND_VALUE         32794
 #define _APS_NEXT_CONTROL_VALUE         1001
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
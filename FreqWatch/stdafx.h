@@ -17,6 +17,7 @@
 #include <atlapp.h>
 #include <vector>
 #include <map>
+#include <memory>
 #include <atlmisc.h>
 #include <atlimage.h>
 #include <atlscrl.h>
@@ -97,9 +98,4 @@ struct GZipOutput:public OutputInterface
 		((GZipOutput*)This)->zipcap.Write(&c,1);
 	}
 };
-struct FreqInfo
-{
-	int freq;
-	int time;
-	double strong;
-};
\ No newline at end of file
+#include "FreqPeaks.h"
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "StftEngine.h"
+#include "Fourier.h"
+#include <math.h>
+
+CStftEngine::CStftEngine(size_t frameSize,size_t hopSize,SpectrumLines *store)
+	:m_frameSize(frameSize),m_hopSize(hopSize?hopSize:frameSize),m_store(store),m_readPos(0),
+	m_outR(frameSize),m_outI(frameSize)
+{
+	m_pending.reserve(frameSize*2);
+}
+
+void CStftEngine::Push(const short *pcm,size_t count)
+{
+	m_pending.insert(m_pending.end(),pcm,pcm+count);
+	EmitFrames();
+}
+
+void CStftEngine::Push(const double *pcm,size_t count)
+{
+	m_pending.insert(m_pending.end(),pcm,pcm+count);
+	EmitFrames();
+}
+
+void CStftEngine::Reset()
+{
+	m_pending.clear();
+	m_readPos=0;
+}
+
+void CStftEngine::EmitFrames()
+{
+	while(m_readPos+m_frameSize<=m_pending.size())
+	{
+		fft_double((unsigned int)m_frameSize,false,&m_pending[m_readPos],nullptr,&m_outR[0],&m_outI[0]);
+		std::vector<double> freqRes(m_frameSize/2);
+		for(size_t i=0;i<m_frameSize/2;i++)
+		{
+			freqRes[i]=sqrt(m_outR[i]*m_outR[i]+m_outI[i]*m_outI[i]);
+		}
+		if(m_store)
+			m_store->push_back(std::move(freqRes));
+		m_readPos+=m_hopSize;
+	}
+	//a hop longer than the frame may skip past what has arrived so far
+	if(m_readPos>=m_pending.size())
+	{
+		m_readPos-=m_pending.size();
+		m_pending.clear();
+	}
+	else if(m_readPos>m_frameSize)
+	{
+		m_pending.erase(m_pending.begin(),m_pending.begin()+m_readPos);
+		m_readPos=0;
+	}
+}
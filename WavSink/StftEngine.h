@@ -0,0 +1,39 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+typedef std::vector<std::vector<double>> SpectrumLines;
+
+//////////////////////////////////////////////////////////////////////
+// CStftEngine
+// Turns a PCM stream pushed in blocks of any length into magnitude
+// spectra of frameSize/2 bins, one every hopSize samples, appended to
+// the store given at construction. Samples that do not fill a frame yet
+// are kept until the next push.
+//////////////////////////////////////////////////////////////////////
+class CStftEngine
+{
+public:
+	CStftEngine(size_t frameSize,size_t hopSize,SpectrumLines *store);
+
+	void Push(const short *pcm,size_t count);
+	void Push(const double *pcm,size_t count);
+	//drop pending samples,the store is left alone
+	void Reset();
+
+	size_t FrameSize() const { return m_frameSize; }
+	size_t HopSize() const { return m_hopSize; }
+	size_t PendingSamples() const { return m_readPos<m_pending.size()?m_pending.size()-m_readPos:0; }
+	SpectrumLines *Store() const { return m_store; }
+	void SetStore(SpectrumLines *store) { m_store=store; }
+private:
+	void EmitFrames();
+
+	size_t m_frameSize;
+	size_t m_hopSize;
+	SpectrumLines *m_store;
+	std::vector<double> m_pending;
+	size_t m_readPos;
+	std::vector<double> m_outR;
+	std::vector<double> m_outI;
+};
@@ -27,6 +27,7 @@
 #include <Gdiplusimaging.h>
 
 #include "CreateWavSink.h"
+#include "StftEngine.h"
 
 template <class T> void SafeRelease(T **ppT)
 {
@@ -84,6 +85,10 @@ class CWavRecord:public CComObjectRootEx<CComSingleThreadModel>,public IWaveData
 	std::vector<std::vector<double>> m_FreqSamples;
 	std::vector<double> m_FreqSave;
 	static const size_t SampleCount=8192;
+	CStftEngine m_stft;
+	CWavRecord():m_stft(SampleCount,SampleCount,&m_FreqSamples)
+	{
+	}
 	STDMETHODIMP WaveStart(WAVEFORMATEX *waveFormat);
 	STDMETHODIMP WaveData(void* data,DWORD datalen);
 	STDMETHODIMP WaveProcess();
@@ -2365,30 +2365,15 @@ STDMETHODIMP CWavRecord::WaveData(void* data,DWORD datalen)
 }
 STDMETHODIMP CWavRecord::WaveProcess()
 {
-	while(m_FreqSave.size()>=SampleCount)
+	if(!m_FreqSave.empty())
 	{
-		std::vector<double> tempfreq(m_FreqSave.begin(),m_FreqSave.begin()+SampleCount);
-		std::vector<double> outR(SampleCount),outI(SampleCount);
-		fft_double(SampleCount,false,&tempfreq[0],nullptr,&outR[0],&outI[0]);
-		std::vector<double> freqRes(SampleCount/2);
-		for(int i=0;i<SampleCount/2;i++)
-		{
-			freqRes[i]=sqrt(outR[i]*outR[i]+outI[i]*outI[i]);
-		}
-		m_FreqSave.erase(m_FreqSave.begin(),m_FreqSave.begin()+SampleCount);
-		m_FreqSamples.push_back(std::move(freqRes));
+		m_stft.Push(&m_FreqSave[0],m_FreqSave.size());
+		m_FreqSave.clear();
 	}
 	return S_OK;
 }
 STDMETHODIMP CWavRecord::WaveEnd()
 {
-	/*FILE* fp=NULL;
-	fopen_s(&fp,"d:\\wavedata.data","wb");
-	for(auto i=m_FreqSamples.begin();i!=m_FreqSamples.end();i++)
-	{
-		fwrite(&i->at(0),sizeof(double),SampleCount/2,fp);
-	}
-	fclose(fp);*/
 	return S_OK;
 }
 STDMETHODIMP CWavRecord::PullOutData(std::vector<std::vector<double>> *reciver)